@@ -4,6 +4,7 @@
  * Features:
  *   - QRH-256 hash algorithm implementation
  *   - HMAC variant for keyed hashing
+ *   - Streaming with progress reports and cooperative cancellation
  *   - Stores 32 integers in little-endian format
  */
 
@@ -11,38 +12,46 @@
 #include <stddef.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
 
 #include "qrh_256.h"
+#include "qrh_256_internal.h"
 
 #define QRH_HASH_SIZE      32
 #define QRH_BLOCK_SIZE     64
 #define QRH_WORDS_SIZE     16
 #define QRH_CONSTANTS_SIZE 16
 
-#ifndef QRH_HALF_ROUNDS
-#define QRH_HALF_ROUNDS   4
-#endif
-
-#ifndef QRH_DIFFUSIONS
-#define QRH_DIFFUSIONS    4
-#endif
-
-#ifndef QRH_MATRIX_ROUNDS 
-#define QRH_MATRIX_ROUNDS 2 /* these rounds are very heavy -20 MB/sec per additional round */
-#endif
-
 #define ROTL32(v, n) ((v << n) | (v >> (32 - n)))
 
 /* Exported functions */
 void qrh_256(const uint8_t *input, const size_t input_len, uint8_t *out);
 uint8_t *qrh_256_hmac(const uint8_t *key, const size_t key_len, const uint8_t *bytes, const size_t bytes_len);
 uint8_t *qrh_alloc_256(const uint8_t *input, const size_t input_len);
+void qrh_hmac_key_init(qrh_hmac_key *key, const uint8_t *key_bytes, const size_t key_len);
+void qrh_256_hmac_with_key(const qrh_hmac_key *key, const uint8_t *bytes, const size_t bytes_len, uint8_t *out);
+void qrh_wipe(void *p, const size_t len);
+int qrh_init(qrh_ctx *ctx, const size_t total_len);
+int qrh_update(qrh_ctx *ctx, const uint8_t *input, size_t input_len);
+int qrh_final(qrh_ctx *ctx, uint8_t *out);
+uint64_t qrh_64(const void *input, const size_t input_len, const uint64_t seed);
+uint64_t qrh_64_u64(const uint64_t value, const uint64_t seed);
+void qrh_ctx_mix_block(qrh_ctx *ctx, const uint8_t *block, const size_t block_size);
+void qrh_ctx_finish(qrh_ctx *ctx, uint8_t *out);
 
 /* Static functions */
 static void qrh_run_state(uint32_t state[QRH_WORDS_SIZE]);
 static void qrh_finalize(uint32_t words[QRH_WORDS_SIZE], uint8_t out[QRH_HASH_SIZE]);
 static void qrh_length_inject(uint32_t words[QRH_WORDS_SIZE], const size_t input_len, const size_t block_index, uint32_t *schema);
 static inline void qrh_diffuse_words(uint32_t words[QRH_WORDS_SIZE]);
+static void qrh_mix_block(uint32_t state[QRH_WORDS_SIZE], uint32_t blocks[QRH_WORDS_SIZE], const uint8_t *block, const size_t block_size, const size_t input_len, const size_t offset, uint32_t *schema);
+static void qrh_absorb_block(uint32_t state[QRH_WORDS_SIZE], uint32_t blocks[QRH_WORDS_SIZE], const uint8_t *block, const size_t block_size, const size_t input_len, const size_t offset, uint32_t *schema);
+static void qrh_finish(uint32_t state[QRH_WORDS_SIZE], const size_t input_len, uint8_t out[QRH_HASH_SIZE]);
+
+/* Round helpers */
+void add3(uint32_t *a, uint32_t *b, uint32_t *c);
 
 
 /* random constants (does not mean safe in active networks) */
@@ -62,6 +71,16 @@ uint32_t read_u32_le(const uint8_t *buf, size_t *offset) {
     return val;
 }
 
+uint32_t read_u32_le_dynamic(const uint8_t *buf, size_t *offset, size_t len) {
+    uint32_t val = 0;
+
+    for(size_t i = 0; i < len; i++)
+        val |= (uint32_t)buf[*offset + i] << (i * 8);
+
+    *offset += len;
+    return val;
+}
+
 void wrno_u32_le(uint8_t *buf, uint32_t val) {
     buf[0] = val & 0xFF;
     buf[1] = val >> 8;
@@ -143,29 +162,250 @@ void qrh_256(const uint8_t *input, const size_t input_len, uint8_t *out) {
     while(offset < input_len) {
         size_t block_size = (input_len - offset) < QRH_BLOCK_SIZE ? (input_len - offset) : QRH_BLOCK_SIZE;
 
-        size_t buffer_offset  = offset;
-        size_t full_words     = block_size / 4;
-        size_t partial_block  = block_size % 4;
+        qrh_absorb_block(state, blocks, input + offset, block_size, input_len, offset, &schema);
+        offset += block_size;
+    }
+
+    qrh_finish(state, input_len, out);
+}
+
+/* streaming context, the total length has to be known before the first byte */
+int qrh_init(qrh_ctx *ctx, const size_t total_len) {
+    memset(ctx, 0, sizeof(*ctx));
+    memcpy(ctx->state, constants, QRH_WORDS_SIZE * sizeof(uint32_t));
+
+    ctx->schema    = constants[(total_len << 8) % QRH_CONSTANTS_SIZE];
+    ctx->total_len = total_len;
+
+    return 0;
+}
+
+static uint64_t qrh_control_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
 
-        for(size_t i = 0; i < full_words; i++)
-            blocks[i] = read_u32_le(input, &buffer_offset);
-        
-        if(partial_block)
-            blocks[full_words] = (uint32_t)read_u32_le_dynamic(input, &buffer_offset, partial_block);
+void qrh_set_control(qrh_ctx *ctx, const qrh_control *control) {
+    ctx->control       = control;
+    ctx->report_offset = ctx->offset;
+    ctx->report_at     = ctx->offset + (control && control->progress_bytes ? control->progress_bytes : 16u << 20);
+    ctx->report_ns     = control && control->progress ? qrh_control_now_ns() : 0;
+}
+
+void qrh_cancel(qrh_control *control) {
+    __atomic_store_n(&control->cancelled, 1, __ATOMIC_RELAXED);
+}
 
-        for(int i = 0; i < QRH_WORDS_SIZE; i++)
-            state[i] ^= blocks[i] + ROTL32(blocks[(i + 1) % 16], i);
+int qrh_cancelled(const qrh_control *control) {
+    return control && __atomic_load_n(&control->cancelled, __ATOMIC_RELAXED);
+}
 
-        qrh_length_inject(state, input_len, offset, &schema);
-        qrh_run_state(state);
+/* between block batches: -1 once cancelled, reports progress when due */
+static int qrh_control_check(qrh_ctx *ctx) {
+    const qrh_control *control = ctx->control;
 
-        offset = buffer_offset;
+    if(ctx->cancelled || qrh_cancelled(control)) {
+        ctx->cancelled = 1;
+        errno = ECANCELED;
+        return -1;
     }
 
-    for(int i = 0; i < QRH_WORDS_SIZE; i += 4)
-        state[i] ^= ROTL32(input_len << (((i * 5 + 7) % 16) + 10), 6);
+    if(control->progress && ctx->offset >= ctx->report_at) {
+        uint64_t now   = qrh_control_now_ns();
+        uint64_t bytes = ctx->offset - ctx->report_offset;
+        double seconds = (double)(now - ctx->report_ns) / 1e9;
 
-    qrh_finalize(state, out);
+        control->progress(control->user, ctx->offset, ctx->total_len, seconds > 0 ? (double)bytes / seconds / 1e6 : 0.0);
+
+        ctx->report_offset = ctx->offset;
+        ctx->report_at     = ctx->offset + (control->progress_bytes ? control->progress_bytes : 16u << 20);
+        ctx->report_ns     = now;
+    }
+
+    return 0;
+}
+
+int qrh_update(qrh_ctx *ctx, const uint8_t *input, size_t input_len) {
+    if(input_len > ctx->total_len - ctx->offset - ctx->buffered)
+        return -1;
+
+    if(ctx->control && qrh_control_check(ctx) < 0)
+        return -1;
+
+    if(ctx->buffered) {
+        size_t take = QRH_BLOCK_SIZE - ctx->buffered;
+
+        if(take > input_len)
+            take = input_len;
+
+        memcpy(ctx->buffer + ctx->buffered, input, take);
+        ctx->buffered += take;
+        input         += take;
+        input_len     -= take;
+
+        if(ctx->buffered < QRH_BLOCK_SIZE)
+            return 0;
+
+        qrh_absorb_block(ctx->state, ctx->blocks, ctx->buffer, QRH_BLOCK_SIZE, ctx->total_len, ctx->offset, &ctx->schema);
+        ctx->offset  += QRH_BLOCK_SIZE;
+        ctx->buffered = 0;
+    }
+
+    while(input_len >= QRH_BLOCK_SIZE) {
+        size_t batch = input_len / QRH_BLOCK_SIZE;
+
+        if(ctx->control && batch > QRH_CONTROL_BLOCKS)
+            batch = QRH_CONTROL_BLOCKS;
+
+        for(size_t i = 0; i < batch; i++) {
+            qrh_absorb_block(ctx->state, ctx->blocks, input, QRH_BLOCK_SIZE, ctx->total_len, ctx->offset, &ctx->schema);
+            ctx->offset += QRH_BLOCK_SIZE;
+            input       += QRH_BLOCK_SIZE;
+        }
+
+        input_len -= batch * QRH_BLOCK_SIZE;
+
+        if(ctx->control && qrh_control_check(ctx) < 0)
+            return -1;
+    }
+
+    if(input_len)
+        memcpy(ctx->buffer, input, input_len);
+
+    ctx->buffered = input_len;
+
+    return 0;
+}
+
+int qrh_final(qrh_ctx *ctx, uint8_t *out) {
+    if(ctx->cancelled) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    if(ctx->offset + ctx->buffered != ctx->total_len)
+        return -1;
+
+    if(ctx->buffered)
+        qrh_absorb_block(ctx->state, ctx->blocks, ctx->buffer, ctx->buffered, ctx->total_len, ctx->offset, &ctx->schema);
+
+    qrh_finish(ctx->state, ctx->total_len, out);
+    memset(ctx, 0, sizeof(*ctx));
+
+    return 0;
+}
+
+int qrh_256_control(const uint8_t *input, const size_t input_len, uint8_t *out, const qrh_control *control) {
+    qrh_ctx ctx;
+
+    qrh_init(&ctx, input_len);
+    qrh_set_control(&ctx, control);
+
+    if(qrh_update(&ctx, input, input_len) < 0 || qrh_final(&ctx, out) < 0) {
+        int saved = errno;
+
+        memset(&ctx, 0, sizeof(ctx));
+        errno = saved;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * short-input fast path for hash tables: 4-word state, 16-byte lanes and
+ * only the invertible add3 mixer. Not a replacement for the 256-bit digest.
+ */
+#define QRH_ADD3(a, b, c) do {                                  \
+        (a) += (c) + (b); (b) += (a) + (c); (c) += (a) + (b);   \
+        (a) += ROTL32((c), 19);                                 \
+        (b) += ROTL32((a), 13);                                 \
+        (c) += ROTL32((b), 8);                                  \
+    } while(0)
+
+static inline void qrh_64_mix(uint32_t s[4]) {
+    QRH_ADD3(s[0], s[1], s[2]);
+    QRH_ADD3(s[1], s[2], s[3]);
+    QRH_ADD3(s[2], s[3], s[0]);
+}
+
+static inline uint32_t qrh_64_load(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t qrh_64_finish(uint32_t s[4]) {
+    qrh_64_mix(s);
+    s[0] ^= constants[8];
+    s[3] ^= constants[9];
+    qrh_64_mix(s);
+
+    return ((uint64_t)(s[0] ^ s[2]) << 32) | (s[1] ^ s[3]);
+}
+
+static inline void qrh_64_seed(uint32_t s[4], const uint64_t input_len, const uint64_t seed) {
+    s[0] = constants[0] ^ (uint32_t)seed;
+    s[1] = constants[1] ^ (uint32_t)(seed >> 32);
+    s[2] = constants[2] ^ (uint32_t)input_len;
+    s[3] = constants[3] ^ (uint32_t)(input_len >> 32);
+}
+
+uint64_t qrh_64(const void *input, const size_t input_len, const uint64_t seed) {
+    const uint8_t *bytes = input;
+    size_t remaining     = input_len;
+    uint32_t s[4];
+
+    qrh_64_seed(s, input_len, seed);
+
+    while(remaining > 16) {
+        for(int i = 0; i < 4; i++)
+            s[i] ^= qrh_64_load(bytes + i * 4);
+
+        qrh_64_mix(s);
+        bytes     += 16;
+        remaining -= 16;
+    }
+
+    /* last 1-16 bytes, zero padded; the length in the seed keeps padding unambiguous */
+    uint32_t tail[4] = {0};
+    size_t i         = 0;
+
+    for(; i + 4 <= remaining; i += 4)
+        tail[i / 4] = qrh_64_load(bytes + i);
+
+    if(i < remaining) {
+        size_t offset = i;
+
+        tail[i / 4] = read_u32_le_dynamic(bytes, &offset, remaining - i);
+    }
+
+    /* constant indices keep the state in registers */
+    for(int w = 0; w < 4; w++)
+        s[w] ^= tail[w];
+
+    return qrh_64_finish(s);
+}
+
+/* same value as qrh_64() over the 8 little-endian bytes of `value` */
+uint64_t qrh_64_u64(const uint64_t value, const uint64_t seed) {
+    uint32_t s[4];
+
+    qrh_64_seed(s, 8, seed);
+    s[0] ^= (uint32_t)value;
+    s[1] ^= (uint32_t)(value >> 32);
+
+    return qrh_64_finish(s);
+}
+
+/* multi-buffer hooks, the lane engine runs the permutation itself */
+void qrh_ctx_mix_block(qrh_ctx *ctx, const uint8_t *block, const size_t block_size) {
+    qrh_mix_block(ctx->state, ctx->blocks, block, block_size, ctx->total_len, ctx->offset, &ctx->schema);
+    ctx->offset += block_size;
+}
+
+void qrh_ctx_finish(qrh_ctx *ctx, uint8_t *out) {
+    qrh_finish(ctx->state, ctx->total_len, out);
 }
 
 uint8_t *qrh_alloc_256(const uint8_t *input, const size_t input_len) {
@@ -175,44 +415,94 @@ uint8_t *qrh_alloc_256(const uint8_t *input, const size_t input_len) {
     return hash;
 }
 
-uint8_t *qrh_256_hmac(const uint8_t *key, const size_t key_len, const uint8_t *bytes, const size_t bytes_len) {
-    uint8_t key_block[QRH_BLOCK_SIZE]   = {0};
-    uint8_t in_padding[QRH_BLOCK_SIZE]  = {0};
-    uint8_t out_padding[QRH_BLOCK_SIZE] = {0};
+void qrh_hmac_key_init(qrh_hmac_key *key, const uint8_t *key_bytes, const size_t key_len) {
+    uint8_t key_block[QRH_BLOCK_SIZE] = {0};
 
     if(key_len > QRH_BLOCK_SIZE) {
-        uint8_t *key_hash = qrh_alloc_256(key, key_len);
-
-        memcpy(key_block, key_hash, QRH_HASH_SIZE);
-        free(key_hash);
-    } else {
-        memcpy(key_block, key, key_len);
+        qrh_256(key_bytes, key_len, key_block);
+    } else if(key_len) {
+        memcpy(key_block, key_bytes, key_len);
     }
 
     for(int i = 0; i < QRH_BLOCK_SIZE; i++) {
-        out_padding[i] = key_block[i] ^ 0x5c;
-        in_padding[i]  = key_block[i] ^ 0x36;
+        key->out_padding[i] = key_block[i] ^ 0x5c;
+        key->in_padding[i]  = key_block[i] ^ 0x36;
     }
 
-    uint8_t *inner_data = calloc(1, QRH_BLOCK_SIZE + bytes_len);
-    memcpy(inner_data, in_padding, QRH_BLOCK_SIZE);
-    memcpy(inner_data + QRH_BLOCK_SIZE, bytes, bytes_len);
+    qrh_wipe(key_block, sizeof(key_block));
+}
 
-    uint8_t *inner_hash = qrh_alloc_256(inner_data, QRH_BLOCK_SIZE + bytes_len);
-    
-    uint8_t *outer_data = calloc(1, QRH_BLOCK_SIZE + QRH_HASH_SIZE);
-    memcpy(outer_data, out_padding, QRH_BLOCK_SIZE);
-    memcpy(outer_data + QRH_BLOCK_SIZE, inner_hash, QRH_HASH_SIZE);
+void qrh_wipe(void *p, const size_t len) {
+    volatile uint8_t *bytes = p;
+
+    for(size_t i = 0; i < len; i++)
+        bytes[i] = 0;
+}
+
+/* streams ipad || message, so the message is never copied */
+void qrh_256_hmac_with_key(const qrh_hmac_key *key, const uint8_t *bytes, const size_t bytes_len, uint8_t *out) {
+    uint8_t outer_data[QRH_BLOCK_SIZE + QRH_HASH_SIZE];
+    qrh_ctx ctx;
+
+    qrh_init(&ctx, QRH_BLOCK_SIZE + bytes_len);
+    qrh_update(&ctx, key->in_padding, QRH_BLOCK_SIZE);
+    qrh_update(&ctx, bytes, bytes_len);
+    qrh_final(&ctx, outer_data + QRH_BLOCK_SIZE);
+
+    memcpy(outer_data, key->out_padding, QRH_BLOCK_SIZE);
+    qrh_init(&ctx, sizeof(outer_data));
+    qrh_update(&ctx, outer_data, sizeof(outer_data));
+    qrh_final(&ctx, out);
+
+    /* both hold state derived from the key pads */
+    qrh_wipe(&ctx, sizeof(ctx));
+    qrh_wipe(outer_data, sizeof(outer_data));
+}
+
+uint8_t *qrh_256_hmac(const uint8_t *key, const size_t key_len, const uint8_t *bytes, const size_t bytes_len) {
+    uint8_t *hmac_hash = calloc(1, QRH_HASH_SIZE);
+    qrh_hmac_key hmac_key;
 
-    uint8_t *hmac_hash = qrh_alloc_256(outer_data, QRH_BLOCK_SIZE + QRH_HASH_SIZE);
+    if(!hmac_hash)
+        return NULL;
 
-    free(inner_hash);
-    free(inner_data);
-    free(outer_data);
+    qrh_hmac_key_init(&hmac_key, key, key_len);
+    qrh_256_hmac_with_key(&hmac_key, bytes, bytes_len, hmac_hash);
 
+    qrh_wipe(&hmac_key, sizeof(hmac_key));
     return hmac_hash;
 }
 
+/* `blocks` carries over between calls: a short final block keeps the previous block's tail words */
+static void qrh_mix_block(uint32_t state[QRH_WORDS_SIZE], uint32_t blocks[QRH_WORDS_SIZE], const uint8_t *block, const size_t block_size, const size_t input_len, const size_t offset, uint32_t *schema) {
+    size_t buffer_offset = 0;
+    size_t full_words    = block_size / 4;
+    size_t partial_block = block_size % 4;
+
+    for(size_t i = 0; i < full_words; i++)
+        blocks[i] = read_u32_le(block, &buffer_offset);
+
+    if(partial_block)
+        blocks[full_words] = (uint32_t)read_u32_le_dynamic(block, &buffer_offset, partial_block);
+
+    for(int i = 0; i < QRH_WORDS_SIZE; i++)
+        state[i] ^= blocks[i] + ROTL32(blocks[(i + 1) % 16], i);
+
+    qrh_length_inject(state, input_len, offset, schema);
+}
+
+static void qrh_absorb_block(uint32_t state[QRH_WORDS_SIZE], uint32_t blocks[QRH_WORDS_SIZE], const uint8_t *block, const size_t block_size, const size_t input_len, const size_t offset, uint32_t *schema) {
+    qrh_mix_block(state, blocks, block, block_size, input_len, offset, schema);
+    qrh_run_state(state);
+}
+
+static void qrh_finish(uint32_t state[QRH_WORDS_SIZE], const size_t input_len, uint8_t out[QRH_HASH_SIZE]) {
+    for(int i = 0; i < QRH_WORDS_SIZE; i += 4)
+        state[i] ^= ROTL32(input_len << (((i * 5 + 7) % 16) + 10), 6);
+
+    qrh_finalize(state, out);
+}
+
 static void qrh_length_inject(uint32_t words[QRH_WORDS_SIZE], const size_t input_len, const size_t block_index, uint32_t *schema) {
     uint64_t bit_len = (uint64_t)input_len * 8;
 
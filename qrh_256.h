@@ -4,9 +4,75 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#define QRH_CONTROL_BLOCKS 256 /* 16 KiB between cancellation checks */
+
+/* progress of one hash: bytes absorbed so far, of `total`, and the rate since the last report */
+typedef void (*qrh_progress_fn)(void *user, uint64_t done, uint64_t total, double mb_per_s);
+
+/*
+ * Progress reports and cooperative cancellation for long hashes. One control
+ * may be shared by many hashes and threads; qrh_cancel() is async-signal-safe.
+ */
+typedef struct qrh_control {
+    int cancelled;             /* through qrh_cancel() / qrh_cancelled() only */
+    qrh_progress_fn progress;  /* NULL: no reports */
+    void *user;
+    uint64_t progress_bytes;   /* between reports, 0: 16 MiB */
+} qrh_control;
+
+/* streaming state, equivalent to qrh_256() once `total_len` bytes were fed */
+typedef struct qrh_ctx {
+    uint32_t state[16];
+    uint32_t blocks[16];
+    uint32_t schema;
+    size_t total_len;
+    size_t offset;
+    size_t buffered;
+    uint8_t buffer[64];
+
+    /* qrh_set_control() */
+    const qrh_control *control;
+    size_t report_at;
+    size_t report_offset;
+    uint64_t report_ns;
+    int cancelled;
+} qrh_ctx;
+
+/* HMAC pads derived once per key, reusable across messages and threads */
+typedef struct qrh_hmac_key {
+    uint8_t in_padding[64];
+    uint8_t out_padding[64];
+} qrh_hmac_key;
+
 void qrh_256(const uint8_t *input, const size_t input_len, uint8_t *out);
 uint8_t *qrh_256_hmac(const uint8_t *key, const size_t key_len, const uint8_t *bytes, const size_t bytes_len);
 
 uint8_t *qrh_alloc_256(const uint8_t *input, const size_t input_len);
 
+void qrh_hmac_key_init(qrh_hmac_key *key, const uint8_t *key_bytes, const size_t key_len);
+void qrh_256_hmac_with_key(const qrh_hmac_key *key, const uint8_t *bytes, const size_t bytes_len, uint8_t *out);
+
+/* zeroes key material; unlike memset() the stores cannot be optimized away */
+void qrh_wipe(void *p, const size_t len);
+
+/* 64-bit short-input hash for hash tables and sharding, not a digest */
+uint64_t qrh_64(const void *input, const size_t input_len, const uint64_t seed);
+uint64_t qrh_64_u64(const uint64_t value, const uint64_t seed);
+
+int qrh_init(qrh_ctx *ctx, const size_t total_len);
+int qrh_update(qrh_ctx *ctx, const uint8_t *input, size_t input_len);
+int qrh_final(qrh_ctx *ctx, uint8_t *out);
+
+/*
+ * Cancellation is checked every QRH_CONTROL_BLOCKS blocks inside qrh_update(),
+ * which then fails with errno ECANCELED, and so does qrh_final(). Progress is
+ * reported from the same checks. Call after qrh_init().
+ */
+void qrh_set_control(qrh_ctx *ctx, const qrh_control *control);
+void qrh_cancel(qrh_control *control);
+int qrh_cancelled(const qrh_control *control);
+
+/* qrh_256() with a control; 0, or -1 with errno ECANCELED */
+int qrh_256_control(const uint8_t *input, const size_t input_len, uint8_t *out, const qrh_control *control);
+
 #endif
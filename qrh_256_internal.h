@@ -0,0 +1,28 @@
+#ifndef QRH_256_INTERNAL_H
+#define QRH_256_INTERNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+
+/* shared by the scalar and multi-buffer paths so both always agree on the profile */
+#ifndef QRH_HALF_ROUNDS
+#define QRH_HALF_ROUNDS   4
+#endif
+
+#ifndef QRH_DIFFUSIONS
+#define QRH_DIFFUSIONS    4
+#endif
+
+#ifndef QRH_MATRIX_ROUNDS 
+#define QRH_MATRIX_ROUNDS 2 /* these rounds are very heavy -20 MB/sec per additional round */
+#endif
+
+/* block input and length injection without the permutation, advances ctx->offset */
+void qrh_ctx_mix_block(qrh_ctx *ctx, const uint8_t *block, const size_t block_size);
+
+/* length folding and output once every block went through the permutation */
+void qrh_ctx_finish(qrh_ctx *ctx, uint8_t *out);
+
+#endif
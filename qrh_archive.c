@@ -0,0 +1,590 @@
+/**
+ * qrh_archive.c
+ *
+ * Features:
+ *   - Compressed and decompressed digests of gzip and zstd files in a single
+ *     pass over the compressed bytes
+ *   - Unit index from headers alone: BGZF block sizes and gzip trailers,
+ *     zstd frame headers and the seekable-format seek table
+ *   - Units decompress in parallel on a qrh_pool, one window at a time,
+ *     while the previous window streams through both qrh_ctx
+ *   - Memory bounded by `buffer_limit`: two windows of half that size; a
+ *     unit too large for a window is decompressed piece by piece while it
+ *     is hashed
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+#include "qrh_archive.h"
+
+#define ARCHIVE_BUFFER_LIMIT (64u << 20)
+#define ARCHIVE_STREAM_PIECE (1u << 20)
+#define ARCHIVE_GZIP_MIN     18           /* header and trailer of an empty member */
+#define ARCHIVE_ZSTD_MAGIC   0xFD2FB528u
+#define ARCHIVE_SKIP_MAGIC   0x184D2A50u  /* skippable frames: low four bits free */
+#define ARCHIVE_SKIP_MASK    0xFFFFFFF0u
+#define ARCHIVE_SEEK_MAGIC   0x8F92EAB1u  /* seekable format footer */
+#define ARCHIVE_SEEK_FOOTER  9
+
+enum archive_format {
+    ARCHIVE_GZIP,
+    ARCHIVE_ZSTD
+};
+
+struct archive_unit {
+    size_t in_off;
+    size_t in_len;
+    uint64_t out_off;
+    uint64_t out_len;
+    int data;                  /* 0 for skippable zstd frames */
+};
+
+struct archive_index {
+    struct archive_unit *units;
+    size_t count;
+    size_t cap;
+    uint64_t out_len;
+};
+
+/* units[first, first + n), decompressed into buf; `stream` units are not buffered */
+struct archive_window {
+    size_t first;
+    size_t n;
+    int stream;
+    uint8_t *buf;
+};
+
+struct archive_job {
+    const uint8_t *data;
+    enum archive_format format;
+    const struct archive_unit *units;
+    qrh_ctx plain;
+    qrh_ctx packed;
+    struct archive_window fill;       /* being decompressed */
+    struct archive_window drain;      /* being hashed */
+    int fill_error;                   /* errno of the first failure, per stage */
+    int plain_error;
+    int packed_error;
+};
+
+static uint32_t archive_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static int archive_push(struct archive_index *ix, size_t in_off, size_t in_len, uint64_t out_len, int data) {
+    if(ix->count == ix->cap) {
+        size_t cap = ix->cap ? ix->cap * 2 : 256;
+        struct archive_unit *units = realloc(ix->units, cap * sizeof(*units));
+
+        if(!units) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        ix->units = units;
+        ix->cap   = cap;
+    }
+
+    ix->units[ix->count++] = (struct archive_unit){ in_off, in_len, ix->out_len, out_len, data };
+    ix->out_len += out_len;
+
+    return 0;
+}
+
+/* BSIZE + 1 from a BGZF "BC" extra subfield, 0 if the member has none */
+static size_t archive_bgzf_size(const uint8_t *m, size_t rest) {
+    size_t xlen, end;
+
+    if(!(m[3] & 4) || rest < 12)
+        return 0;
+
+    xlen = (size_t)m[10] | (size_t)m[11] << 8;
+    end  = 12 + xlen;
+
+    if(end > rest)
+        return 0;
+
+    for(size_t x = 12; x + 4 <= end; ) {
+        size_t slen = (size_t)m[x + 2] | (size_t)m[x + 3] << 8;
+
+        if(m[x] == 'B' && m[x + 1] == 'C' && slen == 2 && x + 6 <= end)
+            return ((size_t)m[x + 4] | (size_t)m[x + 5] << 8) + 1;
+
+        x += 4 + slen;
+    }
+
+    return 0;
+}
+
+static int archive_index_gzip(const uint8_t *data, size_t len, struct archive_index *ix) {
+    size_t off = 0;
+
+    while(off < len) {
+        const uint8_t *m = data + off;
+        size_t rest = len - off;
+        size_t size;
+
+        if(rest < ARCHIVE_GZIP_MIN || m[0] != 0x1f || m[1] != 0x8b || m[2] != 8) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /* without a block size the member can only run to the end of the file */
+        size = archive_bgzf_size(m, rest);
+
+        if(size == 0)
+            size = rest;
+
+        if(size < ARCHIVE_GZIP_MIN || size > rest) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        /* ISIZE is the length modulo 2^32; a longer member fails while decompressing */
+        if(archive_push(ix, off, size, archive_le32(m + size - 4), 1) < 0)
+            return -1;
+
+        off += size;
+    }
+
+    return 0;
+}
+
+/* the seek table's entries, if the file ends in one */
+static const uint8_t *archive_seek_table(const uint8_t *data, size_t len, size_t *frames, size_t *entry_size) {
+    size_t table;
+
+    if(len < ARCHIVE_SEEK_FOOTER + 8 || archive_le32(data + len - 4) != ARCHIVE_SEEK_MAGIC)
+        return NULL;
+
+    *frames     = archive_le32(data + len - ARCHIVE_SEEK_FOOTER);
+    *entry_size = data[len - 5] & 0x80 ? 12 : 8;
+    table       = *frames * *entry_size;
+
+    if(table > len - ARCHIVE_SEEK_FOOTER - 8)
+        return NULL;
+
+    return data + len - ARCHIVE_SEEK_FOOTER - table;
+}
+
+static int archive_index_zstd(const uint8_t *data, size_t len, struct archive_index *ix) {
+    size_t seek_frames = 0, seek_entry = 0, frame = 0, off = 0;
+    const uint8_t *seek = archive_seek_table(data, len, &seek_frames, &seek_entry);
+
+    while(off < len) {
+        const uint8_t *m = data + off;
+        size_t rest = len - off;
+        uint32_t magic = rest >= 8 ? archive_le32(m) : 0;
+
+        if((magic & ARCHIVE_SKIP_MASK) == ARCHIVE_SKIP_MAGIC) {
+            size_t size = 8 + (size_t)archive_le32(m + 4);
+
+            if(size > rest) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            if(archive_push(ix, off, size, 0, 0) < 0)
+                return -1;
+
+            off += size;
+        } else if(magic == ARCHIVE_ZSTD_MAGIC) {
+            size_t size = ZSTD_findFrameCompressedSize(m, rest);
+            unsigned long long content = ZSTD_getFrameContentSize(m, rest);
+
+            if(ZSTD_isError(size) || content == ZSTD_CONTENTSIZE_ERROR) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            if(content == ZSTD_CONTENTSIZE_UNKNOWN) {
+                if(!seek || frame >= seek_frames) {
+                    errno = ENOTSUP;
+                    return -1;
+                }
+
+                content = archive_le32(seek + frame * seek_entry + 4);
+            }
+
+            if(archive_push(ix, off, size, content, 1) < 0)
+                return -1;
+
+            off += size;
+            frame++;
+        } else {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* one buffered unit, decompressed to exactly its indexed length */
+static int archive_unpack(const struct archive_job *job, const struct archive_unit *u, uint8_t *out) {
+    const uint8_t *in = job->data + u->in_off;
+
+    if(!u->data)
+        return 0;
+
+    if(job->format == ARCHIVE_ZSTD) {
+        size_t n = ZSTD_decompress(out, u->out_len, in, u->in_len);
+
+        if(ZSTD_isError(n) || n != u->out_len) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        return 0;
+    }
+
+    z_stream z;
+    int r;
+
+    memset(&z, 0, sizeof(z));
+
+    if(inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    z.next_in   = (Bytef *)in;
+    z.avail_in  = (uInt)u->in_len;
+    z.next_out  = out;
+    z.avail_out = (uInt)u->out_len;
+
+    r = inflate(&z, Z_FINISH);
+    inflateEnd(&z);
+
+    if(r == Z_STREAM_END && z.avail_in) {
+        errno = ENOTSUP;   /* more members follow one without a block size */
+        return -1;
+    }
+
+    if(r != Z_STREAM_END || z.total_out != u->out_len) {
+        errno = r == Z_MEM_ERROR ? ENOMEM : EINVAL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* hashes decompressed bytes, refusing more than the index promised */
+static int archive_feed(struct archive_job *job, const uint8_t *p, size_t n, uint64_t *done, uint64_t planned) {
+    if(n > planned - *done) {
+        errno = ENOTSUP;   /* a gzip member of 4 GiB or more: ISIZE wrapped */
+        return -1;
+    }
+
+    *done += n;
+
+    return qrh_update(&job->plain, p, n);
+}
+
+static int archive_stream_gzip(struct archive_job *job, const struct archive_unit *u, uint8_t *buf) {
+    const uint8_t *in = job->data + u->in_off;
+    size_t rest = u->in_len;
+    uint64_t done = 0;
+    int r = Z_OK, ret = 0;
+    z_stream z;
+
+    memset(&z, 0, sizeof(z));
+
+    if(inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while(r != Z_STREAM_END) {
+        if(z.avail_in == 0 && rest) {
+            size_t n = rest > UINT_MAX ? UINT_MAX : rest;
+
+            z.next_in  = (Bytef *)in;
+            z.avail_in = (uInt)n;
+            in   += n;
+            rest -= n;
+        }
+
+        z.next_out  = buf;
+        z.avail_out = ARCHIVE_STREAM_PIECE;
+
+        r = inflate(&z, Z_NO_FLUSH);
+
+        if(r != Z_OK && r != Z_STREAM_END) {
+            errno = r == Z_MEM_ERROR ? ENOMEM : EINVAL;
+            ret = -1;
+            break;
+        }
+
+        if(archive_feed(job, buf, ARCHIVE_STREAM_PIECE - z.avail_out, &done, u->out_len) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    inflateEnd(&z);
+
+    if(ret == 0 && (z.avail_in || rest)) {
+        errno = ENOTSUP;
+        ret = -1;
+    } else if(ret == 0 && done != u->out_len) {
+        errno = EINVAL;
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int archive_stream_zstd(struct archive_job *job, const struct archive_unit *u, uint8_t *buf) {
+    ZSTD_DCtx *dctx = ZSTD_createDCtx();
+    ZSTD_inBuffer in = { job->data + u->in_off, u->in_len, 0 };
+    uint64_t done = 0;
+    size_t r = 1;
+    int ret = 0;
+
+    if(!dctx) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    while(r != 0) {
+        ZSTD_outBuffer out = { buf, ARCHIVE_STREAM_PIECE, 0 };
+
+        r = ZSTD_decompressStream(dctx, &out, &in);
+
+        /* an error, or input used up without output: truncated frame */
+        if(ZSTD_isError(r) || (r != 0 && out.pos == 0 && in.pos == in.size)) {
+            errno = EINVAL;
+            ret = -1;
+            break;
+        }
+
+        if(archive_feed(job, buf, out.pos, &done, u->out_len) < 0) {
+            ret = -1;
+            break;
+        }
+    }
+
+    ZSTD_freeDCtx(dctx);
+
+    if(ret == 0 && (in.pos != in.size || done != u->out_len)) {
+        errno = EINVAL;
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* the drain window's decompressed bytes into the plain context */
+static int archive_drain_plain(struct archive_job *job) {
+    const struct archive_window *w = &job->drain;
+    const struct archive_unit *first = &job->units[w->first];
+    const struct archive_unit *last  = &job->units[w->first + w->n - 1];
+    uint8_t *buf;
+    int ret;
+
+    if(!w->stream)
+        return qrh_update(&job->plain, w->buf, (size_t)(last->out_off + last->out_len - first->out_off));
+
+    if(!first->data)
+        return 0;
+
+    buf = malloc(ARCHIVE_STREAM_PIECE);
+
+    if(!buf) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    ret = job->format == ARCHIVE_ZSTD ? archive_stream_zstd(job, first, buf) : archive_stream_gzip(job, first, buf);
+    free(buf);
+
+    return ret;
+}
+
+/*
+ * Index 0 hashes the drain window's decompressed bytes, index 1 its
+ * compressed bytes, and index 2 + k decompresses unit k of the fill window.
+ */
+static void archive_stage(void *arg, size_t index) {
+    struct archive_job *job = arg;
+
+    if(index == 0) {
+        if(job->drain.n && archive_drain_plain(job) < 0)
+            job->plain_error = errno;
+    } else if(index == 1) {
+        if(job->drain.n) {
+            const struct archive_unit *first = &job->units[job->drain.first];
+            const struct archive_unit *last  = &job->units[job->drain.first + job->drain.n - 1];
+
+            if(qrh_update(&job->packed, job->data + first->in_off, last->in_off + last->in_len - first->in_off) < 0)
+                job->packed_error = errno;
+        }
+    } else {
+        const struct archive_unit *u = &job->units[job->fill.first + index - 2];
+        uint8_t *out = job->fill.buf + (u->out_off - job->units[job->fill.first].out_off);
+
+        if(archive_unpack(job, u, out) < 0) {
+            int expected = 0;
+
+            __atomic_compare_exchange_n(&job->fill_error, &expected, errno, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* units from `next` that fit in half the buffer limit, or one that does not */
+static struct archive_window archive_next_window(const struct archive_index *ix, size_t next, uint64_t half) {
+    struct archive_window w = { next, 0, 0, NULL };
+    uint64_t bytes = 0;
+
+    if(next < ix->count && (ix->units[next].out_len > half || ix->units[next].in_len > UINT_MAX)) {
+        w.n      = 1;
+        w.stream = 1;
+        return w;
+    }
+
+    while(next + w.n < ix->count && ix->units[next + w.n].out_len <= half - bytes &&
+          ix->units[next + w.n].in_len <= UINT_MAX) {
+        bytes += ix->units[next + w.n].out_len;
+        w.n++;
+    }
+
+    return w;
+}
+
+int qrh_archive_hash(const uint8_t *data, size_t len, const struct qrh_archive_config *cfg,
+                     struct qrh_archive_digests *out) {
+    struct qrh_pool *pool = cfg && cfg->pool ? cfg->pool : qrh_pool_default();
+    size_t limit = cfg && cfg->buffer_limit ? cfg->buffer_limit : ARCHIVE_BUFFER_LIMIT;
+    uint64_t half = limit / 2 < UINT_MAX ? limit / 2 : UINT_MAX;   /* one inflate() call per buffered unit */
+    struct archive_index ix = { NULL, 0, 0, 0 };
+    struct archive_job job;
+    uint8_t *bufs[2] = { NULL, NULL };
+    size_t next = 0;
+    int ret = 0, round = 0;
+
+    memset(&job, 0, sizeof(job));
+    memset(out, 0, sizeof(*out));
+
+    if(len >= 4 && data[0] == 0x1f && data[1] == 0x8b) {
+        job.format = ARCHIVE_GZIP;
+        ret = archive_index_gzip(data, len, &ix);
+    } else if(len >= 4 && (archive_le32(data) == ARCHIVE_ZSTD_MAGIC ||
+                           (archive_le32(data) & ARCHIVE_SKIP_MASK) == ARCHIVE_SKIP_MAGIC)) {
+        job.format = ARCHIVE_ZSTD;
+        ret = archive_index_zstd(data, len, &ix);
+    } else {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    if(ret < 0) {
+        free(ix.units);
+        return -1;
+    }
+
+    job.data  = data;
+    job.units = ix.units;
+
+    qrh_init(&job.plain, ix.out_len);
+    qrh_init(&job.packed, len);
+    qrh_set_control(&job.plain, cfg ? cfg->control : NULL);
+
+    /* the window decompressing now is hashed on the next round, while its successor decompresses */
+    while(next < ix.count || job.drain.n) {
+        job.fill = archive_next_window(&ix, next, half);
+
+        if(job.fill.n && !job.fill.stream) {
+            const struct archive_unit *last = &ix.units[next + job.fill.n - 1];
+            size_t bytes = (size_t)(last->out_off + last->out_len - ix.units[next].out_off);
+            uint8_t *buf = realloc(bufs[round & 1], bytes ? bytes : 1);
+
+            if(!buf) {
+                errno = ENOMEM;
+                ret = -1;
+                break;
+            }
+
+            bufs[round & 1] = buf;
+            job.fill.buf    = buf;
+        }
+
+        qrh_pool_parallel(pool, 2 + (job.fill.stream ? 0 : job.fill.n), archive_stage, &job);
+
+        if(job.plain_error || job.packed_error || job.fill_error) {
+            errno = job.plain_error ? job.plain_error : job.packed_error ? job.packed_error : job.fill_error;
+            ret = -1;
+            break;
+        }
+
+        job.drain = job.fill;
+        next += job.fill.n;
+        round++;
+    }
+
+    if(ret == 0 && (qrh_final(&job.plain, out->decompressed) < 0 || qrh_final(&job.packed, out->compressed) < 0))
+        ret = -1;
+
+    if(ret == 0) {
+        out->compressed_len   = len;
+        out->decompressed_len = ix.out_len;
+        out->units            = ix.count;
+    }
+
+    free(bufs[0]);
+    free(bufs[1]);
+    free(ix.units);
+
+    return ret;
+}
+
+int qrh_archive_hash_file(const char *path, const struct qrh_archive_config *cfg,
+                          struct qrh_archive_digests *out) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    int ret, saved;
+
+    if(fd < 0)
+        return -1;
+
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if(st.st_size == 0) {
+        close(fd);
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED)
+        return -1;
+
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    ret   = qrh_archive_hash(map, (size_t)st.st_size, cfg, out);
+    saved = errno;
+
+    munmap(map, (size_t)st.st_size);
+    errno = saved;
+
+    return ret;
+}
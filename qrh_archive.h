@@ -0,0 +1,51 @@
+#ifndef QRH_ARCHIVE_H
+#define QRH_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+
+/*
+ * Digests of a compressed file and of its decompressed contents in one pass
+ * over the compressed bytes. The input is split into independently
+ * decompressible units that are inflated in parallel on a qrh_pool while the
+ * previous batch streams through the two qrh_ctx:
+ *   - gzip: members carrying the BGZF "BC" block size (bgzip and friends), or
+ *     a single member of any size
+ *   - zstd: frames whose header records the content size, or any frames
+ *     covered by a seekable-format seek table; skippable frames are hashed
+ *     as compressed bytes only
+ * Both formats need the decompressed length before hashing starts, because
+ * QRH-256 mixes the total length into every block.
+ */
+
+struct qrh_archive_config {
+    struct qrh_pool *pool;          /* NULL: qrh_pool_default() */
+    size_t buffer_limit;            /* decompressed bytes held at once, default 64 MiB */
+    const qrh_control *control;     /* progress over decompressed bytes, cancellation */
+};
+
+struct qrh_archive_digests {
+    uint8_t compressed[32];
+    uint8_t decompressed[32];
+    uint64_t compressed_len;
+    uint64_t decompressed_len;
+    size_t units;                   /* members or frames */
+};
+
+/*
+ * Hashes `data` (gzip or zstd, detected from the magic) into `out`. `cfg` may
+ * be NULL for defaults. 0 or -1 with errno: ENOTSUP for other formats or a
+ * gzip file with several members and no block sizes, EINVAL for a corrupt
+ * stream, ENOMEM, ECANCELED.
+ */
+int qrh_archive_hash(const uint8_t *data, size_t len, const struct qrh_archive_config *cfg,
+                     struct qrh_archive_digests *out);
+
+/* the same for a file, which is mmap'd */
+int qrh_archive_hash_file(const char *path, const struct qrh_archive_config *cfg,
+                          struct qrh_archive_digests *out);
+
+#endif
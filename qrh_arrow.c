@@ -0,0 +1,193 @@
+/**
+ * qrh_arrow.c
+ *
+ * Features:
+ *   - Row pointers and lengths read straight from the offsets buffer into
+ *     qrh_256_multi(), ARROW_BATCH rows per call, nothing copied
+ *   - Null rows are skipped, and batches without nulls hash in place
+ *   - Output buffers, array and schema bookkeeping in two allocations
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "qrh_multi.h"
+#include "qrh_arrow.h"
+
+#define ARROW_DIGEST_SIZE 32
+#define ARROW_BATCH       256
+#define ARROW_ALIGN       64                     /* buffer alignment the format recommends */
+#define ARROW_FORMAT      "w:32"
+
+/* private_data of the output array, followed by the bitmap and the digests */
+struct arrow_out {
+    const void *buffers[2];
+};
+
+/* private_data of the output schema */
+struct arrow_out_schema {
+    char format[sizeof(ARROW_FORMAT)];
+    char name[];
+};
+
+static void arrow_release_array(struct ArrowArray *array) {
+    free(array->private_data);
+    array->release = NULL;
+}
+
+static void arrow_release_schema(struct ArrowSchema *schema) {
+    free(schema->private_data);
+    schema->release = NULL;
+}
+
+static inline int64_t arrow_offset(const void *offsets, int wide, int64_t i) {
+    return wide ? ((const int64_t *)offsets)[i] : ((const int32_t *)offsets)[i];
+}
+
+static inline size_t arrow_round(size_t n) {
+    return (n + ARROW_ALIGN - 1) / ARROW_ALIGN * ARROW_ALIGN;
+}
+
+static int arrow_out_schema(const struct ArrowSchema *schema, struct ArrowSchema *out) {
+    const char *name = schema->name ? schema->name : "";
+    struct arrow_out_schema *priv = malloc(sizeof(*priv) + strlen(name) + 1);
+
+    if(!priv)
+        return -1;
+
+    memcpy(priv->format, ARROW_FORMAT, sizeof(ARROW_FORMAT));
+    strcpy(priv->name, name);
+
+    memset(out, 0, sizeof(*out));
+    out->format       = priv->format;
+    out->name         = priv->name;
+    out->flags        = schema->flags & ARROW_FLAG_NULLABLE;
+    out->release      = arrow_release_schema;
+    out->private_data = priv;
+
+    return 0;
+}
+
+int qrh_arrow_hash_column(const struct ArrowSchema *schema, const struct ArrowArray *array,
+                          struct ArrowSchema *out_schema, struct ArrowArray *out_array) {
+    const uint8_t *inputs[ARROW_BATCH];
+    size_t lens[ARROW_BATCH];
+    int64_t slots[ARROW_BATCH];
+    uint8_t digests[ARROW_BATCH * ARROW_DIGEST_SIZE];
+    const uint8_t *validity, *data;
+    const void *offsets;
+    uint8_t *bitmap, *out;
+    struct arrow_out *priv;
+    size_t bitmap_size, header_size;
+    int64_t n, nulls = 0;
+    int wide;
+
+    if(!schema || !array || !schema->release || !array->release || !schema->format) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(strcmp(schema->format, "u") == 0 || strcmp(schema->format, "z") == 0) {
+        wide = 0;
+    } else if(strcmp(schema->format, "U") == 0 || strcmp(schema->format, "Z") == 0) {
+        wide = 1;
+    } else {
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    n = array->length;
+
+    if(n < 0 || array->offset < 0 || array->n_buffers != 3 || (n > 0 && !array->buffers[1])) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    /* a null count of 0 lets producers leave stale bitmaps behind */
+    validity = array->null_count != 0 ? array->buffers[0] : NULL;
+    offsets  = array->buffers[1];
+    data     = array->buffers[2];
+
+    header_size = arrow_round(sizeof(*priv));
+    bitmap_size = validity ? arrow_round(((size_t)n + 7) / 8) : 0;
+
+    if((size_t)n > (SIZE_MAX - header_size - bitmap_size) / ARROW_DIGEST_SIZE) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    if(posix_memalign((void **)&priv, ARROW_ALIGN, header_size + bitmap_size + (size_t)n * ARROW_DIGEST_SIZE) != 0) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    bitmap = validity ? (uint8_t *)priv + header_size : NULL;
+    out    = (uint8_t *)priv + header_size + bitmap_size;
+
+    if(bitmap)
+        memset(bitmap, 0, bitmap_size);
+
+    for(int64_t first = 0; first < n; first += ARROW_BATCH) {
+        int64_t rows = n - first < ARROW_BATCH ? n - first : ARROW_BATCH;
+        size_t count = 0;
+
+        for(int64_t r = first; r < first + rows; r++) {
+            int64_t row = array->offset + r;
+            int64_t start, end;
+
+            if(validity && !(validity[row >> 3] >> (row & 7) & 1)) {
+                memset(out + r * ARROW_DIGEST_SIZE, 0, ARROW_DIGEST_SIZE);
+                nulls++;
+                continue;
+            }
+
+            if(bitmap)
+                bitmap[r >> 3] |= (uint8_t)(1u << (r & 7));
+
+            start = arrow_offset(offsets, wide, row);
+            end   = arrow_offset(offsets, wide, row + 1);
+
+            if(start < 0 || end < start || (end > start && !data)) {
+                free(priv);
+                errno = EINVAL;
+                return -1;
+            }
+
+            inputs[count] = end > start ? data + start : (const uint8_t *)"";
+            lens[count]   = (size_t)(end - start);
+            slots[count]  = r;
+            count++;
+        }
+
+        /* no nulls in this batch: digests land in their rows directly */
+        if(count == (size_t)rows) {
+            qrh_256_multi(inputs, lens, count, out + first * ARROW_DIGEST_SIZE);
+            continue;
+        }
+
+        qrh_256_multi(inputs, lens, count, digests);
+
+        for(size_t i = 0; i < count; i++)
+            memcpy(out + slots[i] * ARROW_DIGEST_SIZE, digests + i * ARROW_DIGEST_SIZE, ARROW_DIGEST_SIZE);
+    }
+
+    if(arrow_out_schema(schema, out_schema) != 0) {
+        free(priv);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    priv->buffers[0] = nulls ? bitmap : NULL;
+    priv->buffers[1] = out;
+
+    memset(out_array, 0, sizeof(*out_array));
+    out_array->length       = n;
+    out_array->null_count   = nulls;
+    out_array->n_buffers    = 2;
+    out_array->buffers      = priv->buffers;
+    out_array->release      = arrow_release_array;
+    out_array->private_data = priv;
+
+    return 0;
+}
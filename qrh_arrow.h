@@ -0,0 +1,61 @@
+#ifndef QRH_ARROW_H
+#define QRH_ARROW_H
+
+#include <stdint.h>
+
+/*
+ * QRH-256 of every value in an Arrow string or binary column, through the
+ * Arrow C Data Interface and without depending on Arrow itself.
+ */
+
+/* struct definitions from the Arrow C Data Interface specification */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    const char *format;
+    const char *name;
+    const char *metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema **children;
+    struct ArrowSchema *dictionary;
+
+    void (*release)(struct ArrowSchema *);
+    void *private_data;
+};
+
+struct ArrowArray {
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void **buffers;
+    struct ArrowArray **children;
+    struct ArrowArray *dictionary;
+
+    void (*release)(struct ArrowArray *);
+    void *private_data;
+};
+
+#endif
+
+/*
+ * Hashes each value of `array` ("u", "z", "U" or "Z": utf8 or binary with
+ * 32- or 64-bit offsets) into a new "w:32" fixed-size binary column with
+ * the same length and nulls. Null slots hold 32 zero bytes. The output is
+ * owned by the caller and freed through its release callbacks. The input
+ * is only read.
+ *
+ * 0, or -1 with errno EINVAL (released or malformed input), ENOTSUP (other
+ * formats) or ENOMEM.
+ */
+int qrh_arrow_hash_column(const struct ArrowSchema *schema, const struct ArrowArray *array,
+                          struct ArrowSchema *out_schema, struct ArrowArray *out_array);
+
+#endif
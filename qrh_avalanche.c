@@ -0,0 +1,524 @@
+/**
+ * qrh_avalanche.c
+ *
+ * Features:
+ *   - Statistical test harness for QRH-256 kernels and round profiles
+ *   - Strict avalanche (per input/output bit), bit independence (per output
+ *     bit pair) and chi-square on output bytes
+ *   - Inputs are hashed by the multi-buffer engine on every core, through a
+ *     qrh_pool sized by -j
+ *   - 64 samples are bit-sliced into one word per output bit, so every
+ *     statistic is an AND plus popcount (AVX2 when available)
+ *
+ * Build once per round profile, e.g.
+ *   cc -O2 -mavx2 -pthread -DQRH_MATRIX_ROUNDS=1 qrh_avalanche.c qrh_pool.c qrh_multi.c qrh_256.c -lm
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_256.h"
+#include "qrh_256_internal.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+
+#define AVAL_HASH_SIZE   32
+#define AVAL_OUT_BITS    256
+#define AVAL_SLICE       64     /* samples per bit-sliced word */
+#define AVAL_MAX_LEN     1024
+#define AVAL_MAX_THREADS 256
+#define AVAL_ALPHA       0.001  /* family-wise failure threshold per test */
+
+struct aval_config {
+    size_t len;
+    uint64_t batches;  /* each batch: AVAL_SLICE random inputs, every input bit flipped */
+    uint64_t seed;
+    unsigned nthreads;
+    int scalar;
+};
+
+/* per-thread accumulators, summed once at the end */
+struct aval_stats {
+    uint64_t *sac;                           /* [input bit][output bit] flips */
+    uint64_t bic[AVAL_OUT_BITS][AVAL_OUT_BITS]; /* upper triangle: both bits flipped */
+    uint64_t bytes[AVAL_HASH_SIZE][256];     /* output byte values per position */
+    uint64_t distance[AVAL_OUT_BITS + 1];    /* Hamming distance histogram */
+    uint64_t mismatches;                     /* multi-buffer vs scalar digests */
+};
+
+struct aval_worker {
+    const struct aval_config *cfg;
+    struct aval_stats *stats;
+    uint64_t *next_batch;
+    pthread_mutex_t *lock;
+};
+
+static uint64_t aval_splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+static void aval_hash(const struct aval_config *cfg, const uint8_t *const inputs[], const size_t lens[], uint8_t *outs) {
+    if(cfg->scalar) {
+        for(size_t i = 0; i < AVAL_SLICE; i++)
+            qrh_256(inputs[i], lens[i], outs + i * AVAL_HASH_SIZE);
+    } else {
+        qrh_256_multi(inputs, lens, AVAL_SLICE, outs);
+    }
+}
+
+/* cols[b][s] = byte b of sample s  ->  slices[j] bit s = output bit j of sample s */
+static void aval_transpose(const uint8_t cols[AVAL_HASH_SIZE][AVAL_SLICE], uint64_t slices[AVAL_OUT_BITS]) {
+#if defined(__AVX2__)
+    for(int b = 0; b < AVAL_HASH_SIZE; b++) {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)&cols[b][0]);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)&cols[b][32]);
+
+        for(int t = 7; t >= 0; t--) {
+            slices[b * 8 + t] = (uint32_t)_mm256_movemask_epi8(lo) | ((uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32);
+            lo = _mm256_add_epi8(lo, lo);
+            hi = _mm256_add_epi8(hi, hi);
+        }
+    }
+#else
+    memset(slices, 0, AVAL_OUT_BITS * sizeof(uint64_t));
+
+    for(int b = 0; b < AVAL_HASH_SIZE; b++) {
+        for(int s = 0; s < AVAL_SLICE; s++) {
+            for(int t = 0; t < 8; t++)
+                slices[b * 8 + t] |= (uint64_t)((cols[b][s] >> t) & 1) << s;
+        }
+    }
+#endif
+}
+
+#if defined(__AVX2__)
+/* popcount of each 64-bit lane: nibble lookup, then byte sums */
+static inline __m256i aval_popcount_epi64(__m256i v) {
+    const __m256i lut  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+#endif
+
+/* co-flip counts for every output bit pair j <= k, 64 samples at a time */
+static void aval_bic_accumulate(uint64_t bic[AVAL_OUT_BITS][AVAL_OUT_BITS], const uint64_t slices[AVAL_OUT_BITS]) {
+    for(int j = 0; j < AVAL_OUT_BITS; j++) {
+        int k = j & ~3;
+
+#if defined(__AVX2__)
+        const __m256i row = _mm256_set1_epi64x((long long)slices[j]);
+
+        for(; k < AVAL_OUT_BITS; k += 4) {
+            __m256i both = _mm256_and_si256(row, _mm256_loadu_si256((const __m256i *)&slices[k]));
+            __m256i acc  = _mm256_loadu_si256((const __m256i *)&bic[j][k]);
+
+            _mm256_storeu_si256((__m256i *)&bic[j][k], _mm256_add_epi64(acc, aval_popcount_epi64(both)));
+        }
+#else
+        for(; k < AVAL_OUT_BITS; k++)
+            bic[j][k] += (uint64_t)__builtin_popcountll(slices[j] & slices[k]);
+#endif
+    }
+}
+
+static void aval_run_batch(const struct aval_config *cfg, struct aval_stats *st, uint64_t batch,
+                           uint8_t *inputs, uint8_t *base, uint8_t *flipped) {
+    const uint8_t *ptrs[AVAL_SLICE];
+    size_t lens[AVAL_SLICE];
+    uint8_t cols[AVAL_HASH_SIZE][AVAL_SLICE];
+    uint64_t slices[AVAL_OUT_BITS];
+    uint64_t rng = cfg->seed ^ (batch * 0xD1B54A32D192ED03ull);
+
+    /* inputs depend on (seed, batch) only, so results do not depend on -j */
+    for(size_t s = 0; s < AVAL_SLICE; s++) {
+        uint8_t *in = inputs + s * cfg->len;
+
+        for(size_t i = 0; i < cfg->len; i += 8) {
+            uint64_t r = aval_splitmix64(&rng);
+            memcpy(in + i, &r, cfg->len - i < 8 ? cfg->len - i : 8);
+        }
+
+        ptrs[s] = in;
+        lens[s] = cfg->len;
+    }
+
+    aval_hash(cfg, ptrs, lens, base);
+
+    if(batch == 0) {
+        uint8_t check[AVAL_HASH_SIZE];
+
+        for(size_t s = 0; s < AVAL_SLICE; s++) {
+            qrh_256(ptrs[s], lens[s], check);
+            st->mismatches += memcmp(check, base + s * AVAL_HASH_SIZE, AVAL_HASH_SIZE) != 0;
+        }
+    }
+
+    for(size_t bit = 0; bit < cfg->len * 8; bit++) {
+        for(size_t s = 0; s < AVAL_SLICE; s++)
+            inputs[s * cfg->len + bit / 8] ^= (uint8_t)(1u << (bit % 8));
+
+        aval_hash(cfg, ptrs, lens, flipped);
+
+        for(size_t s = 0; s < AVAL_SLICE; s++) {
+            inputs[s * cfg->len + bit / 8] ^= (uint8_t)(1u << (bit % 8));
+
+            const uint8_t *f = flipped + s * AVAL_HASH_SIZE;
+            const uint8_t *b = base + s * AVAL_HASH_SIZE;
+            unsigned distance = 0;
+
+            for(int i = 0; i < AVAL_HASH_SIZE; i++) {
+                cols[i][s] = f[i] ^ b[i];
+                st->bytes[i][f[i]]++;
+                distance += (unsigned)__builtin_popcount(cols[i][s]);
+            }
+
+            st->distance[distance]++;
+        }
+
+        aval_transpose(cols, slices);
+        aval_bic_accumulate(st->bic, slices);
+
+        uint64_t *row = st->sac + bit * AVAL_OUT_BITS;
+
+        for(int j = 0; j < AVAL_OUT_BITS; j++)
+            row[j] += (uint64_t)__builtin_popcountll(slices[j]);
+    }
+}
+
+static void aval_worker_task(void *arg, size_t index) {
+    struct aval_worker *w = (struct aval_worker *)arg + index;
+    uint8_t *inputs  = malloc(AVAL_SLICE * w->cfg->len);
+    uint8_t *base    = malloc(AVAL_SLICE * AVAL_HASH_SIZE);
+    uint8_t *flipped = malloc(AVAL_SLICE * AVAL_HASH_SIZE);
+
+    if(!inputs || !base || !flipped) {
+        fprintf(stderr, "qrh_avalanche: out of memory\n");
+        exit(2);
+    }
+
+    for(;;) {
+        pthread_mutex_lock(w->lock);
+        uint64_t batch = (*w->next_batch)++;
+        pthread_mutex_unlock(w->lock);
+
+        if(batch >= w->cfg->batches)
+            break;
+
+        aval_run_batch(w->cfg, w->stats, batch, inputs, base, flipped);
+    }
+
+    free(inputs);
+    free(base);
+    free(flipped);
+}
+
+static struct aval_stats *aval_stats_new(size_t len) {
+    struct aval_stats *st = calloc(1, sizeof(*st));
+
+    if(st)
+        st->sac = calloc(len * 8 * AVAL_OUT_BITS, sizeof(uint64_t));
+
+    if(st && !st->sac) {
+        free(st);
+        st = NULL;
+    }
+
+    return st;
+}
+
+static void aval_stats_free(struct aval_stats *st) {
+    if(st) {
+        free(st->sac);
+        free(st);
+    }
+}
+
+static void aval_stats_merge(struct aval_stats *into, const struct aval_stats *from, size_t len) {
+    for(size_t i = 0; i < len * 8 * AVAL_OUT_BITS; i++)
+        into->sac[i] += from->sac[i];
+
+    for(int j = 0; j < AVAL_OUT_BITS; j++)
+        for(int k = 0; k < AVAL_OUT_BITS; k++)
+            into->bic[j][k] += from->bic[j][k];
+
+    for(int i = 0; i < AVAL_HASH_SIZE; i++)
+        for(int v = 0; v < 256; v++)
+            into->bytes[i][v] += from->bytes[i][v];
+
+    for(int d = 0; d <= AVAL_OUT_BITS; d++)
+        into->distance[d] += from->distance[d];
+
+    into->mismatches += from->mismatches;
+}
+
+/* two-sided normal tail, Bonferroni-corrected over `tests` */
+static double aval_p_bonferroni(double z, double tests) {
+    double p = erfc(fabs(z) / sqrt(2.0)) * tests;
+
+    return p < 1.0 ? p : 1.0;
+}
+
+/* upper chi-square tail via the Wilson-Hilferty cube-root approximation */
+static double aval_chi2_p(double chi2, double df) {
+    double v = 2.0 / (9.0 * df);
+    double z = (cbrt(chi2 / df) - (1.0 - v)) / sqrt(v);
+
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+static const char *aval_verdict(int pass, int *failures) {
+    if(!pass)
+        (*failures)++;
+
+    return pass ? "PASS" : "FAIL";
+}
+
+static int aval_report(const struct aval_config *cfg, const struct aval_stats *st, double seconds) {
+    const double per_bit = (double)cfg->batches * AVAL_SLICE;      /* samples per input bit */
+    const double samples = per_bit * (double)(cfg->len * 8);       /* flipped pairs */
+    const double hashes  = samples + per_bit;
+    int failures = 0;
+
+    printf("QRH-256 Statistical Test Harness\n");
+    printf("================================\n");
+    printf("Config:\n");
+    printf("    Kernel: %s\n", cfg->scalar ? "scalar qrh_256()" : "multi-buffer qrh_256_multi()");
+    printf("    Round profile: half rounds %d, diffusions %d, matrix rounds %d\n",
+           QRH_HALF_ROUNDS, QRH_DIFFUSIONS, QRH_MATRIX_ROUNDS);
+    printf("    Input length: %zu bytes (%zu input bits)\n", cfg->len, cfg->len * 8);
+    printf("    Samples: %.0f flipped pairs (%.0f per input bit)\n", samples, per_bit);
+    printf("    Threads: %u, seed: 0x%016llx\n\n", cfg->nthreads, (unsigned long long)cfg->seed);
+
+    /* kernel cross-check */
+    printf("Kernel agreement with qrh_256():\n");
+    printf("    %llu mismatching digests  %s\n\n", (unsigned long long)st->mismatches,
+           aval_verdict(st->mismatches == 0, &failures));
+
+    /* Hamming distance of each flipped pair, Binomial(256, 1/2) expected */
+    double sum = 0, sum_sq = 0;
+    int min_d = -1, max_d = 0;
+
+    for(int d = 0; d <= AVAL_OUT_BITS; d++) {
+        if(!st->distance[d])
+            continue;
+
+        sum    += (double)d * (double)st->distance[d];
+        sum_sq += (double)d * d * (double)st->distance[d];
+
+        if(min_d < 0)
+            min_d = d;
+
+        max_d = d;
+    }
+
+    double mean = sum / samples;
+    double sd   = sqrt(sum_sq / samples - mean * mean);
+    double z    = (mean - AVAL_OUT_BITS / 2.0) / (sqrt(AVAL_OUT_BITS / 4.0) / sqrt(samples));
+
+    printf("Avalanche (output bits flipped per input bit flip):\n");
+    printf("    Mean: %.4f/256 (%.4f%%), std %.4f (ideal 128, 8), range %d..%d\n",
+           mean, mean * 100.0 / AVAL_OUT_BITS, sd, min_d, max_d);
+    printf("    Mean z %.2f  %s\n\n", z, aval_verdict(aval_p_bonferroni(z, 1) >= AVAL_ALPHA, &failures));
+
+    /* strict avalanche: P(out j flips | in i flipped) = 1/2 for every cell */
+    const size_t cells = cfg->len * 8 * AVAL_OUT_BITS;
+    double worst_z = 0;
+    size_t worst   = 0;
+
+    for(size_t c = 0; c < cells; c++) {
+        double cz = ((double)st->sac[c] - per_bit / 2) / sqrt(per_bit / 4);
+
+        if(fabs(cz) > fabs(worst_z)) {
+            worst_z = cz;
+            worst   = c;
+        }
+    }
+
+    double p = aval_p_bonferroni(worst_z, (double)cells);
+
+    printf("Strict avalanche (per input/output bit):\n");
+    printf("    %zu cells, worst input bit %zu -> output bit %zu: %.5f (z %.2f, p %.3g)  %s\n\n",
+           cells, worst / AVAL_OUT_BITS, worst % AVAL_OUT_BITS, (double)st->sac[worst] / per_bit,
+           worst_z, p, aval_verdict(p >= AVAL_ALPHA, &failures));
+
+    /* bit independence: flips of output bits j and k uncorrelated */
+    double worst_r = 0;
+    int worst_j = 0, worst_k = 1;
+
+    for(int j = 0; j < AVAL_OUT_BITS; j++) {
+        double a = (double)st->bic[j][j];
+
+        for(int k = j + 1; k < AVAL_OUT_BITS; k++) {
+            double b  = (double)st->bic[k][k];
+            double ab = (double)st->bic[j][k];
+            double r  = (samples * ab - a * b) / sqrt(a * (samples - a) * b * (samples - b));
+
+            if(fabs(r) > fabs(worst_r)) {
+                worst_r = r;
+                worst_j = j;
+                worst_k = k;
+            }
+        }
+    }
+
+    z = worst_r * sqrt(samples);
+    p = aval_p_bonferroni(z, AVAL_OUT_BITS * (AVAL_OUT_BITS - 1) / 2.0);
+
+    printf("Bit independence (output bit pairs):\n");
+    printf("    %d pairs, worst %d/%d: correlation %.6f (z %.2f, p %.3g)  %s\n\n",
+           AVAL_OUT_BITS * (AVAL_OUT_BITS - 1) / 2, worst_j, worst_k, worst_r, z, p,
+           aval_verdict(p >= AVAL_ALPHA, &failures));
+
+    /* output byte uniformity, 255 degrees of freedom per position */
+    double worst_chi2 = 0, total_chi2 = 0;
+    int worst_pos = 0;
+
+    for(int i = 0; i < AVAL_HASH_SIZE; i++) {
+        double chi2     = 0;
+        double expected = samples / 256;
+
+        for(int v = 0; v < 256; v++) {
+            double d = (double)st->bytes[i][v] - expected;
+            chi2 += d * d / expected;
+        }
+
+        total_chi2 += chi2;
+
+        if(chi2 > worst_chi2) {
+            worst_chi2 = chi2;
+            worst_pos  = i;
+        }
+    }
+
+    double p_worst = aval_chi2_p(worst_chi2, 255) * AVAL_HASH_SIZE;
+    double p_total = aval_chi2_p(total_chi2, 255.0 * AVAL_HASH_SIZE);
+
+    p_worst = p_worst < 1.0 ? p_worst : 1.0;
+
+    printf("Output byte chi-square (df 255 per position):\n");
+    printf("    worst position %d: %.1f (p %.3g), all positions: %.1f/%d (p %.3g)  %s\n\n",
+           worst_pos, worst_chi2, p_worst, total_chi2, 255 * AVAL_HASH_SIZE, p_total,
+           aval_verdict(p_worst >= AVAL_ALPHA && p_total >= AVAL_ALPHA, &failures));
+
+    printf("Throughput: %.2f Mhash/s (%.1f s)\n", hashes / seconds / 1e6, seconds);
+    printf("Result: %s\n", failures ? "FAIL" : "PASS");
+
+    return failures ? 1 : 0;
+}
+
+static void aval_usage(FILE *stream) {
+    fprintf(stream,
+            "Usage: qrh_avalanche [-n SAMPLES] [-l BYTES] [-j THREADS] [-s SEED] [--scalar]\n"
+            "\n"
+            "  -n SAMPLES   flipped input pairs to test (default 10000000)\n"
+            "  -l BYTES     input length, 1..%d (default 64)\n"
+            "  -j THREADS   worker threads (default: online CPUs)\n"
+            "  -s SEED      input generator seed (default 0)\n"
+            "  --scalar     hash with qrh_256() instead of the multi-buffer engine\n",
+            AVAL_MAX_LEN);
+}
+
+int main(int argc, char **argv) {
+    struct aval_config cfg = { .len = 64, .seed = 0, .scalar = 0 };
+    unsigned long long samples = 10000000ull;
+
+    cfg.nthreads = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            samples = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            cfg.len = (size_t)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            cfg.nthreads = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            cfg.seed = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "--scalar") == 0) {
+            cfg.scalar = 1;
+        } else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            aval_usage(stdout);
+            return 0;
+        } else {
+            aval_usage(stderr);
+            return 2;
+        }
+    }
+
+    if(cfg.len == 0 || cfg.len > AVAL_MAX_LEN || samples == 0) {
+        aval_usage(stderr);
+        return 2;
+    }
+
+    if(cfg.nthreads == 0)
+        cfg.nthreads = 1;
+
+    if(cfg.nthreads > AVAL_MAX_THREADS)
+        cfg.nthreads = AVAL_MAX_THREADS;
+
+    /* every batch flips each of the len * 8 input bits in AVAL_SLICE inputs */
+    uint64_t per_batch = (uint64_t)AVAL_SLICE * cfg.len * 8;
+    cfg.batches = (samples + per_batch - 1) / per_batch;
+
+    struct aval_stats *total = aval_stats_new(cfg.len);
+    struct aval_stats *stats[AVAL_MAX_THREADS];
+    struct aval_worker workers[AVAL_MAX_THREADS];
+    struct qrh_pool_config pool_cfg = { .threads = cfg.nthreads };
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    uint64_t next_batch  = 0;
+    struct timespec t0, t1;
+
+    if(!total) {
+        fprintf(stderr, "qrh_avalanche: out of memory\n");
+        return 2;
+    }
+
+    for(unsigned t = 0; t < cfg.nthreads; t++) {
+        stats[t] = aval_stats_new(cfg.len);
+
+        if(!stats[t]) {
+            fprintf(stderr, "qrh_avalanche: out of memory\n");
+            return 2;
+        }
+
+        workers[t] = (struct aval_worker){ &cfg, stats[t], &next_batch, &lock };
+    }
+
+    struct qrh_pool *pool = qrh_pool_create(&pool_cfg);
+
+    if(!pool) {
+        fprintf(stderr, "qrh_avalanche: unable to start workers\n");
+        return 2;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    qrh_pool_parallel(pool, cfg.nthreads, aval_worker_task, workers);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    qrh_pool_destroy(pool);
+
+    for(unsigned t = 0; t < cfg.nthreads; t++) {
+        aval_stats_merge(total, stats[t], cfg.len);
+        aval_stats_free(stats[t]);
+    }
+    int status = aval_report(&cfg, total, (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) / 1e9);
+
+    aval_stats_free(total);
+    return status;
+}
@@ -0,0 +1,324 @@
+/**
+ * qrh_bench_compare.c
+ *
+ * Features:
+ *   - Throughput of SHA-256, BLAKE2s, BLAKE2b and BLAKE3 (vendor/) next to
+ *     the QRH-256 single-stream and multi-buffer kernels
+ *   - Identical message-size sweep and thread counts for every algorithm, on a
+ *     qrh_pool with one worker per measured thread
+ *   - Rendered table on stdout, optional JSON for tracking over time
+ *
+ *   cc -O2 -mavx2 -pthread qrh_bench_compare.c qrh_pool.c qrh_multi.c qrh_256.c \
+ *      vendor/sha256.c vendor/blake2s.c vendor/blake2b.c vendor/blake3.c -o qrh_bench_compare
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "qrh_256.h"
+#include "qrh_256_internal.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+#include "vendor/sha256.h"
+#include "vendor/blake2.h"
+#include "vendor/blake3.h"
+
+#define COMPARE_MAX_THREADS 256
+#define COMPARE_MAX_SIZES   32
+#define COMPARE_BURST_BYTES (64u << 10) /* between clock reads */
+
+/* hashes `count` messages of `len` bytes each, laid out back to back */
+typedef void (*compare_fn)(const uint8_t *msgs, size_t len, size_t count, uint8_t *out);
+
+struct compare_algo {
+    const char *name;
+    size_t batch;  /* messages per call, > 1 for multi-buffer kernels */
+    compare_fn fn;
+};
+
+static void compare_sha256(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    for(size_t i = 0; i < count; i++)
+        sha256(msgs + i * len, len, out);
+}
+
+static void compare_blake2s(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    for(size_t i = 0; i < count; i++)
+        blake2s(out, BLAKE2S_OUTBYTES, msgs + i * len, len);
+}
+
+static void compare_blake2b(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    for(size_t i = 0; i < count; i++)
+        blake2b(out, BLAKE2B_OUTBYTES, msgs + i * len, len);
+}
+
+static void compare_blake3(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    blake3_hasher hasher;
+
+    for(size_t i = 0; i < count; i++) {
+        blake3_hasher_init(&hasher);
+        blake3_hasher_update(&hasher, msgs + i * len, len);
+        blake3_hasher_finalize(&hasher, out, BLAKE3_OUT_LEN);
+    }
+}
+
+static void compare_qrh_256(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    for(size_t i = 0; i < count; i++)
+        qrh_256(msgs + i * len, len, out);
+}
+
+static void compare_qrh_multi(const uint8_t *msgs, size_t len, size_t count, uint8_t *out) {
+    const uint8_t *inputs[QRH_MULTI_LANES];
+    size_t lens[QRH_MULTI_LANES];
+
+    for(size_t i = 0; i < count; i++) {
+        inputs[i] = msgs + i * len;
+        lens[i]   = len;
+    }
+
+    qrh_256_multi(inputs, lens, count, out);
+}
+
+/* QRH-256 has no tree mode, so its kernels are single-stream and multi-buffer */
+static const struct compare_algo compare_algos[] = {
+    { "sha256",    1,               compare_sha256 },
+    { "blake2s",   1,               compare_blake2s },
+    { "blake2b",   1,               compare_blake2b },
+    { "blake3",    1,               compare_blake3 },
+    { "qrh_256",   1,               compare_qrh_256 },
+    { "qrh_multi", QRH_MULTI_LANES, compare_qrh_multi },
+};
+
+#define COMPARE_NALGOS (sizeof(compare_algos) / sizeof(compare_algos[0]))
+
+struct compare_run {
+    const struct compare_algo *algo;
+    size_t size;
+    double seconds;
+    pthread_barrier_t *start;
+    uint64_t bytes;
+    double elapsed;
+};
+
+static double compare_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static void compare_task(void *arg, size_t index) {
+    struct compare_run *run = (struct compare_run *)arg + index;
+    const size_t batch = run->algo->batch;
+    uint8_t *msgs      = malloc(run->size * batch + 1);
+    uint8_t out[QRH_MULTI_LANES * 64];
+    size_t burst = COMPARE_BURST_BYTES / (run->size * batch + 1) + 1;
+
+    if(!msgs) {
+        fprintf(stderr, "qrh_bench_compare: out of memory\n");
+        exit(2);
+    }
+
+    for(size_t i = 0; i < run->size * batch; i++)
+        msgs[i] = (uint8_t)(i * 131 + 7);
+
+    pthread_barrier_wait(run->start);
+
+    double t0  = compare_now();
+    double end = t0 + run->seconds;
+
+    run->bytes = 0;
+
+    do {
+        for(size_t i = 0; i < burst; i++)
+            run->algo->fn(msgs, run->size, batch, out);
+
+        run->bytes += (uint64_t)burst * batch * run->size;
+    } while(compare_now() < end);
+
+    run->elapsed = compare_now() - t0;
+    free(msgs);
+}
+
+/*
+ * aggregate MB/s of `threads` tasks hashing independent messages; the pool has
+ * at least threads - 1 workers, so every task is running before the barrier opens
+ */
+static double compare_measure(struct qrh_pool *pool, const struct compare_algo *algo, size_t size,
+                              unsigned threads, double seconds) {
+    struct compare_run runs[COMPARE_MAX_THREADS];
+    pthread_barrier_t start;
+    uint64_t bytes = 0;
+    double elapsed = 0;
+
+    pthread_barrier_init(&start, NULL, threads);
+
+    for(unsigned t = 0; t < threads; t++)
+        runs[t] = (struct compare_run){ algo, size, seconds, &start, 0, 0 };
+
+    qrh_pool_parallel(pool, threads, compare_task, runs);
+
+    for(unsigned t = 0; t < threads; t++) {
+        bytes += runs[t].bytes;
+
+        if(runs[t].elapsed > elapsed)
+            elapsed = runs[t].elapsed;
+    }
+
+    pthread_barrier_destroy(&start);
+    return (double)bytes / elapsed / 1e6;
+}
+
+static size_t compare_parse_list(const char *arg, unsigned long *out, size_t max) {
+    size_t n = 0;
+    char *end;
+
+    while(*arg && n < max) {
+        out[n++] = strtoul(arg, &end, 0);
+
+        if(*end != ',' && *end != '\0')
+            return 0;
+
+        arg = *end ? end + 1 : end;
+    }
+
+    return n;
+}
+
+static void compare_usage(FILE *stream) {
+    fprintf(stream,
+            "Usage: qrh_bench_compare [-s SIZES] [-t THREADS] [-T SECONDS] [--json FILE]\n"
+            "\n"
+            "  -s SIZES     comma-separated message sizes in bytes\n"
+            "               (default 16,64,256,1024,4096,16384,65536,1048576)\n"
+            "  -t THREADS   comma-separated thread counts (default 1 and online CPUs)\n"
+            "  -T SECONDS   measuring time per cell (default 0.3)\n"
+            "  --json FILE  also write every cell as JSON (- for stdout)\n");
+}
+
+int main(int argc, char **argv) {
+    unsigned long sizes[COMPARE_MAX_SIZES] = { 16, 64, 256, 1024, 4096, 16384, 65536, 1048576 };
+    unsigned long threads[COMPARE_MAX_SIZES];
+    size_t nsizes   = 8;
+    size_t nthreads = 0;
+    double seconds  = 0.3;
+    const char *json_path = NULL;
+    unsigned long cpus = (unsigned long)sysconf(_SC_NPROCESSORS_ONLN);
+
+    threads[nthreads++] = 1;
+
+    if(cpus > 1)
+        threads[nthreads++] = cpus;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            nsizes = compare_parse_list(argv[++i], sizes, COMPARE_MAX_SIZES);
+        } else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            nthreads = compare_parse_list(argv[++i], threads, COMPARE_MAX_SIZES);
+        } else if(strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+            seconds = strtod(argv[++i], NULL);
+        } else if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            compare_usage(stdout);
+            return 0;
+        } else {
+            compare_usage(stderr);
+            return 2;
+        }
+    }
+
+    if(nsizes == 0 || nthreads == 0 || seconds <= 0) {
+        compare_usage(stderr);
+        return 2;
+    }
+
+    for(size_t t = 0; t < nthreads; t++) {
+        if(threads[t] == 0 || threads[t] > COMPARE_MAX_THREADS) {
+            compare_usage(stderr);
+            return 2;
+        }
+    }
+
+    double *results = calloc(nthreads * nsizes * COMPARE_NALGOS, sizeof(double));
+
+    if(!results)
+        return 2;
+
+    /* with JSON on stdout the table goes to stderr */
+    FILE *table = json_path && strcmp(json_path, "-") == 0 ? stderr : stdout;
+
+    fprintf(table, "Hash Comparison Benchmark (MB/s, higher is better)\n");
+    fprintf(table, "==================================================\n");
+    fprintf(table, "QRH round profile: half rounds %d, diffusions %d, matrix rounds %d\n",
+            QRH_HALF_ROUNDS, QRH_DIFFUSIONS, QRH_MATRIX_ROUNDS);
+
+    for(size_t t = 0; t < nthreads; t++) {
+        struct qrh_pool_config pool_cfg = { .threads = (unsigned)threads[t] };
+        struct qrh_pool *pool = qrh_pool_create(&pool_cfg);
+
+        if(!pool) {
+            fprintf(stderr, "qrh_bench_compare: unable to start threads\n");
+            exit(2);
+        }
+
+        fprintf(table, "\nThreads: %lu\n    %10s", threads[t], "size");
+
+        for(size_t a = 0; a < COMPARE_NALGOS; a++)
+            fprintf(table, " %10s", compare_algos[a].name);
+
+        fprintf(table, "\n");
+
+        for(size_t s = 0; s < nsizes; s++) {
+            fprintf(table, "    %10lu", sizes[s]);
+
+            for(size_t a = 0; a < COMPARE_NALGOS; a++) {
+                double mbs = compare_measure(pool, &compare_algos[a], sizes[s], (unsigned)threads[t], seconds);
+
+                results[(t * nsizes + s) * COMPARE_NALGOS + a] = mbs;
+                fprintf(table, " %10.1f", mbs);
+                fflush(table);
+            }
+
+            fprintf(table, "\n");
+        }
+
+        qrh_pool_destroy(pool);
+    }
+
+    if(json_path) {
+        FILE *json = strcmp(json_path, "-") == 0 ? stdout : fopen(json_path, "w");
+
+        if(!json) {
+            perror(json_path);
+            free(results);
+            return 2;
+        }
+
+        fprintf(json, "{\n  \"benchmark\": \"qrh_bench_compare\",\n");
+        fprintf(json, "  \"qrh_profile\": { \"half_rounds\": %d, \"diffusions\": %d, \"matrix_rounds\": %d },\n",
+                QRH_HALF_ROUNDS, QRH_DIFFUSIONS, QRH_MATRIX_ROUNDS);
+        fprintf(json, "  \"seconds_per_cell\": %g,\n  \"results\": [", seconds);
+
+        for(size_t t = 0, first = 1; t < nthreads; t++) {
+            for(size_t s = 0; s < nsizes; s++) {
+                for(size_t a = 0; a < COMPARE_NALGOS; a++, first = 0) {
+                    fprintf(json, "%s\n    { \"algorithm\": \"%s\", \"size\": %lu, \"threads\": %lu, \"mb_per_s\": %.2f }",
+                            first ? "" : ",", compare_algos[a].name, sizes[s], threads[t],
+                            results[(t * nsizes + s) * COMPARE_NALGOS + a]);
+                }
+            }
+        }
+
+        fprintf(json, "\n  ]\n}\n");
+
+        if(json != stdout)
+            fclose(json);
+    }
+
+    free(results);
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * qrh_bench_hasher.cpp
+ *
+ * Features:
+ *   - std::unordered_map insert/find throughput, std::hash vs qrh::hasher
+ *   - String keys (heterogeneous find through std::string_view) and 64-bit keys
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "qrh_hasher.hpp"
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct result {
+    double insert_ns;
+    double find_ns;
+    std::size_t hits;
+};
+
+template<class Map, class Keys, class Probe>
+result run(const Keys &keys, Probe probe) {
+    Map map;
+    map.reserve(keys.size());
+
+    auto t0 = bench_clock::now();
+
+    for(std::size_t i = 0; i < keys.size(); i++)
+        map.emplace(keys[i], i);
+
+    auto t1 = bench_clock::now();
+    std::size_t hits = 0;
+
+    for(std::size_t i = 0; i < keys.size(); i++)
+        hits += map.find(probe(keys[i])) != map.end();
+
+    auto t2 = bench_clock::now();
+    double n = static_cast<double>(keys.size());
+
+    return {
+        std::chrono::duration<double, std::nano>(t1 - t0).count() / n,
+        std::chrono::duration<double, std::nano>(t2 - t1).count() / n,
+        hits
+    };
+}
+
+void report(const char *name, const result &r) {
+    std::printf("    %-28s insert %7.1f ns/op   find %7.1f ns/op   (%zu hits)\n", name, r.insert_ns, r.find_ns, r.hits);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+    std::vector<std::string> strings;
+    std::vector<std::uint64_t> integers;
+
+    strings.reserve(count);
+    integers.reserve(count);
+
+    for(std::size_t i = 0; i < count; i++) {
+        strings.push_back("tenant/" + std::to_string(i * 2654435761u % 1000003) + "/object-" + std::to_string(i));
+        integers.push_back(static_cast<std::uint64_t>(i) * 0x9E3779B97F4A7C15ull);
+    }
+
+    auto same = [](const auto &k) -> const auto & { return k; };
+    auto view = [](const std::string &k) { return std::string_view(k); };
+
+    std::printf("Hash map benchmark (%zu keys)\n", count);
+    std::printf("==================================================\n");
+
+    std::printf("  string keys:\n");
+    report("std::hash", run<std::unordered_map<std::string, std::size_t>>(strings, same));
+    report("qrh::hasher", run<std::unordered_map<std::string, std::size_t, qrh::hasher<std::string>>>(strings, same));
+
+#if __cplusplus >= 202002L
+    report("qrh::hasher (string_view)",
+           run<std::unordered_map<std::string, std::size_t, qrh::string_hasher, qrh::equal_to>>(strings, view));
+#else
+    (void)view;
+#endif
+
+    std::printf("  uint64_t keys:\n");
+    report("std::hash", run<std::unordered_map<std::uint64_t, std::size_t>>(integers, same));
+    report("qrh::hasher", run<std::unordered_map<std::uint64_t, std::size_t, qrh::hasher<std::uint64_t>>>(integers, same));
+
+    return 0;
+}
@@ -0,0 +1,233 @@
+/**
+ * qrh_chunkmac.c
+ *
+ * Features:
+ *   - Every chunk gets its own keyed HMAC, then a tag chained to the previous tag
+ *   - Incremental tagging and verification, one chunk at a time
+ *   - Whole-buffer signing and verification with the per-chunk HMACs computed
+ *     on a qrh_pool, a window of chunks at a time so memory stays bounded
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "qrh_chunkmac.h"
+
+#define CHUNKMAC_HASH_SIZE   32
+#define CHUNKMAC_BLOCK_SIZE  64
+#define CHUNKMAC_HEADER_SIZE (8 + 8)
+#define CHUNKMAC_MSG_SIZE    (1 + CHUNKMAC_HASH_SIZE + QRH_CHUNKMAC_TAG_SIZE)
+#define CHUNKMAC_WINDOW      256 /* chunks hashed per parallel pass */
+
+struct chunkmac_window {
+    const qrh_hmac_key *key;
+    const uint8_t *data;
+    size_t len;
+    size_t chunk_size;
+    size_t first;       /* chunk index of digests[0] */
+    uint8_t *digests;   /* inner HMACs, keyed material */
+};
+
+static void chunkmac_le64(uint8_t *out, uint64_t v) {
+    for(int i = 0; i < 8; i++)
+        out[i] = (uint8_t)(v >> (8 * i));
+}
+
+/*
+ * inner_i = HMAC(K, le64(i) || le64(len_i) || chunk_i), streamed through the
+ * inner pad so the chunk is never copied. The chunk bytes themselves are
+ * keyed: a chunk digest under an unkeyed qrh_256() could be swapped for a
+ * second preimage without knowing K.
+ */
+static void chunkmac_inner(const qrh_hmac_key *key, uint64_t index, const uint8_t *chunk, size_t len,
+                           uint8_t out[CHUNKMAC_HASH_SIZE]) {
+    uint8_t header[CHUNKMAC_HEADER_SIZE];
+    uint8_t outer[CHUNKMAC_BLOCK_SIZE + CHUNKMAC_HASH_SIZE];
+    qrh_ctx ctx;
+
+    chunkmac_le64(header, index);
+    chunkmac_le64(header + 8, (uint64_t)len);
+
+    qrh_init(&ctx, CHUNKMAC_BLOCK_SIZE + sizeof(header) + len);
+    qrh_update(&ctx, key->in_padding, CHUNKMAC_BLOCK_SIZE);
+    qrh_update(&ctx, header, sizeof(header));
+
+    if(len)
+        qrh_update(&ctx, chunk, len);
+
+    qrh_final(&ctx, outer + CHUNKMAC_BLOCK_SIZE);
+
+    memcpy(outer, key->out_padding, CHUNKMAC_BLOCK_SIZE);
+    qrh_256(outer, sizeof(outer), out);
+
+    qrh_wipe(&ctx, sizeof(ctx));
+    qrh_wipe(outer, sizeof(outer));
+}
+
+/* tag_i = HMAC(K, final || inner_i || tag_{i-1}), advances the chain */
+static void chunkmac_link(qrh_chunkmac *mac, const uint8_t inner[CHUNKMAC_HASH_SIZE], int final,
+                          uint8_t tag[QRH_CHUNKMAC_TAG_SIZE]) {
+    uint8_t msg[CHUNKMAC_MSG_SIZE];
+
+    msg[0] = final ? 1 : 0;
+    memcpy(msg + 1, inner, CHUNKMAC_HASH_SIZE);
+    memcpy(msg + 1 + CHUNKMAC_HASH_SIZE, mac->prev, QRH_CHUNKMAC_TAG_SIZE);
+
+    qrh_256_hmac_with_key(&mac->key, msg, sizeof(msg), tag);
+    qrh_wipe(msg, sizeof(msg));
+
+    memcpy(mac->prev, tag, QRH_CHUNKMAC_TAG_SIZE);
+    mac->index++;
+
+    if(final)
+        mac->state = 1;
+}
+
+/* no early exit, the position of the first differing byte stays hidden */
+static int chunkmac_equal(const uint8_t *a, const uint8_t *b) {
+    uint8_t diff = 0;
+
+    for(int i = 0; i < QRH_CHUNKMAC_TAG_SIZE; i++)
+        diff |= a[i] ^ b[i];
+
+    return diff == 0;
+}
+
+void qrh_chunkmac_init(qrh_chunkmac *mac, const qrh_hmac_key *key) {
+    memset(mac, 0, sizeof(*mac));
+    mac->key = *key;
+}
+
+void qrh_chunkmac_wipe(qrh_chunkmac *mac) {
+    qrh_wipe(mac, sizeof(*mac));
+}
+
+int qrh_chunkmac_tag(qrh_chunkmac *mac, const uint8_t *chunk, size_t len, int final, uint8_t tag[QRH_CHUNKMAC_TAG_SIZE]) {
+    uint8_t inner[CHUNKMAC_HASH_SIZE];
+
+    if(mac->state != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    chunkmac_inner(&mac->key, mac->index, chunk, len, inner);
+    chunkmac_link(mac, inner, final, tag);
+    qrh_wipe(inner, sizeof(inner));
+
+    return 0;
+}
+
+int qrh_chunkmac_verify(qrh_chunkmac *mac, const uint8_t *chunk, size_t len, int final,
+                        const uint8_t tag[QRH_CHUNKMAC_TAG_SIZE]) {
+    uint8_t inner[CHUNKMAC_HASH_SIZE];
+    uint8_t expected[QRH_CHUNKMAC_TAG_SIZE];
+
+    if(mac->state != 0) {
+        errno = mac->state < 0 ? EBADMSG : EINVAL;
+        return -1;
+    }
+
+    chunkmac_inner(&mac->key, mac->index, chunk, len, inner);
+    chunkmac_link(mac, inner, final, expected);
+    qrh_wipe(inner, sizeof(inner));
+
+    if(!chunkmac_equal(expected, tag)) {
+        mac->state = -1;
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+int qrh_chunkmac_finish(const qrh_chunkmac *mac) {
+    if(mac->state != 1) {
+        errno = EBADMSG;
+        return -1;
+    }
+
+    return 0;
+}
+
+size_t qrh_chunkmac_count(size_t len, size_t chunk_size) {
+    if(chunk_size == 0)
+        return 0;
+
+    return len ? (len - 1) / chunk_size + 1 : 1;
+}
+
+static void chunkmac_digest_task(void *arg, size_t i) {
+    struct chunkmac_window *w = arg;
+    size_t offset = (w->first + i) * w->chunk_size;
+    size_t len    = w->len - offset < w->chunk_size ? w->len - offset : w->chunk_size;
+
+    chunkmac_inner(w->key, w->first + i, w->data + offset, len, w->digests + i * CHUNKMAC_HASH_SIZE);
+}
+
+/* signs, or with `check` verifies against `tags`, one window at a time */
+static int chunkmac_run(const qrh_hmac_key *key, const uint8_t *data, size_t len, size_t chunk_size,
+                        struct qrh_pool *pool, uint8_t *tags, const uint8_t *check, size_t *bad) {
+    size_t count = qrh_chunkmac_count(len, chunk_size);
+    size_t window = count < CHUNKMAC_WINDOW ? count : CHUNKMAC_WINDOW;
+    struct chunkmac_window w = { key, data, len, chunk_size, 0, NULL };
+    qrh_chunkmac mac;
+    int ret = 0;
+
+    if(count == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    w.digests = malloc(window * CHUNKMAC_HASH_SIZE);
+
+    if(!w.digests) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    qrh_chunkmac_init(&mac, key);
+
+    for(w.first = 0; w.first < count && ret == 0; w.first += window) {
+        size_t n = count - w.first < window ? count - w.first : window;
+
+        qrh_pool_parallel(pool, n, chunkmac_digest_task, &w);
+
+        for(size_t i = 0; i < n; i++) {
+            size_t c = w.first + i;
+            uint8_t tag[QRH_CHUNKMAC_TAG_SIZE];
+
+            chunkmac_link(&mac, w.digests + i * CHUNKMAC_HASH_SIZE, c + 1 == count, tag);
+
+            if(tags)
+                memcpy(tags + c * QRH_CHUNKMAC_TAG_SIZE, tag, QRH_CHUNKMAC_TAG_SIZE);
+
+            if(check && !chunkmac_equal(tag, check + c * QRH_CHUNKMAC_TAG_SIZE)) {
+                if(bad)
+                    *bad = c;
+
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    qrh_chunkmac_wipe(&mac);
+    qrh_wipe(w.digests, window * CHUNKMAC_HASH_SIZE);
+    free(w.digests);
+
+    if(ret < 0)
+        errno = EBADMSG;
+
+    return ret;
+}
+
+int qrh_chunkmac_sign(const qrh_hmac_key *key, const uint8_t *data, size_t len, size_t chunk_size,
+                      struct qrh_pool *pool, uint8_t *tags) {
+    return chunkmac_run(key, data, len, chunk_size, pool, tags, NULL, NULL);
+}
+
+int qrh_chunkmac_verify_all(const qrh_hmac_key *key, const uint8_t *data, size_t len, size_t chunk_size,
+                            struct qrh_pool *pool, const uint8_t *tags, size_t *bad) {
+    return chunkmac_run(key, data, len, chunk_size, pool, NULL, tags, bad);
+}
@@ -0,0 +1,67 @@
+#ifndef QRH_CHUNKMAC_H
+#define QRH_CHUNKMAC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+
+/*
+ * Chunked MAC: the body is cut into fixed-size chunks (the last one may be
+ * shorter or empty) and chunk i gets the tag
+ *
+ *   inner_i = HMAC-QRH-256(K, le64(i) || le64(len_i) || chunk_i)
+ *   tag_i   = HMAC-QRH-256(K, final || inner_i || tag_{i-1})
+ *
+ * with `final` one byte, 1 on the last chunk and 0 otherwise, and 32 zero
+ * bytes in place of tag_{-1}. Each tag covers everything before it, so a
+ * receiver can release chunk i as soon as tag_i checks out. The final flag
+ * lets qrh_chunkmac_finish() reject a truncated stream.
+ */
+
+#define QRH_CHUNKMAC_TAG_SIZE 32
+
+/* chaining state of one stream, for the sender and the receiver alike */
+typedef struct qrh_chunkmac {
+    qrh_hmac_key key;
+    uint64_t index;                         /* next chunk */
+    uint8_t prev[QRH_CHUNKMAC_TAG_SIZE];
+    int state;                              /* 0 open, 1 final chunk seen, -1 rejected */
+} qrh_chunkmac;
+
+void qrh_chunkmac_init(qrh_chunkmac *mac, const qrh_hmac_key *key);
+void qrh_chunkmac_wipe(qrh_chunkmac *mac);
+
+/* next chunk's tag; -1 with errno EINVAL after the final chunk */
+int qrh_chunkmac_tag(qrh_chunkmac *mac, const uint8_t *chunk, size_t len, int final, uint8_t tag[QRH_CHUNKMAC_TAG_SIZE]);
+
+/*
+ * Checks the next chunk. 0 means the chunk and everything before it is
+ * authentic. -1 with errno EBADMSG rejects it and every later call; EINVAL
+ * follows a final chunk.
+ */
+int qrh_chunkmac_verify(qrh_chunkmac *mac, const uint8_t *chunk, size_t len, int final,
+                        const uint8_t tag[QRH_CHUNKMAC_TAG_SIZE]);
+
+/*
+ * End of stream: 0 only if the final chunk was verified (or tagged). -1 with
+ * errno EBADMSG if the stream stopped before it or a chunk was rejected.
+ */
+int qrh_chunkmac_finish(const qrh_chunkmac *mac);
+
+/* tags for a body of `len` bytes, at least 1 */
+size_t qrh_chunkmac_count(size_t len, size_t chunk_size);
+
+/*
+ * Whole-buffer forms. The inner HMACs are computed in parallel on `pool` (NULL:
+ * the default pool), then chained in order. `tags` holds
+ * qrh_chunkmac_count() * QRH_CHUNKMAC_TAG_SIZE bytes. -1 with errno EINVAL
+ * or ENOMEM; verification fails with EBADMSG and the first bad chunk in `bad`.
+ */
+int qrh_chunkmac_sign(const qrh_hmac_key *key, const uint8_t *data, size_t len, size_t chunk_size,
+                      struct qrh_pool *pool, uint8_t *tags);
+int qrh_chunkmac_verify_all(const qrh_hmac_key *key, const uint8_t *data, size_t len, size_t chunk_size,
+                            struct qrh_pool *pool, const uint8_t *tags, size_t *bad);
+
+#endif
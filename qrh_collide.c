@@ -0,0 +1,938 @@
+/**
+ * qrh_collide.c
+ *
+ * Features:
+ *   - Birthday search for collisions on QRH-256 digests truncated to 16..64 bits
+ *   - Multi-buffer hashing on every core, (truncated digest, input index)
+ *     records spilled to radix-sorted runs on disk
+ *   - Parallel external merge, one key range per worker, with a fan-in bounded
+ *     by the open-file limit and -m; a range over more runs than that is
+ *     merged in cascaded passes through intermediate files
+ *   - Resumable: finished runs and merge partitions are kept, a rerun with the
+ *     same work directory continues where it stopped
+ *
+ * Input i is le64(i) || le64(seed) padded with zeros to the input length, so
+ * every reported collision can be reproduced from its two indices.
+ *
+ *   cc -O2 -mavx2 -pthread qrh_collide.c qrh_pool.c qrh_multi.c qrh_256.c -lm -o qrh_collide
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "qrh_256.h"
+#include "qrh_256_internal.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+
+#define COLLIDE_HASH_SIZE     32
+#define COLLIDE_MAX_LEN       256
+#define COLLIDE_MIN_LEN       16
+#define COLLIDE_HASH_BATCH    1024
+#define COLLIDE_READ_RECORDS  4096    /* per merge input and output: 64 KiB */
+#define COLLIDE_RESERVED_FDS  64      /* stdio, the pool and the state file */
+#define COLLIDE_MAX_THREADS   256
+#define COLLIDE_STATE_FILE    "collide.state"
+
+struct collide_record {
+    uint64_t key;   /* top `bits` bits of the digest, big-endian order */
+    uint64_t index;
+};
+
+/* fixed when a search starts, checked on resume */
+struct collide_params {
+    unsigned bits;
+    unsigned long long count;
+    unsigned long long seed;
+    unsigned len;
+    unsigned long long run_records;
+    unsigned partitions;  /* power of two */
+};
+
+struct collide_search {
+    struct collide_params p;
+    const char *dir;
+    struct qrh_pool *pool;
+    unsigned nthreads;
+    unsigned long long nruns;
+    unsigned fan_in;          /* merge inputs open at once per worker */
+
+    pthread_mutex_t lock;
+    unsigned long long next;  /* next run, then next partition */
+    unsigned long long done;
+    int failed;
+
+    unsigned long long pairs;
+    unsigned long long full;
+};
+
+static void collide_path(char *out, size_t size, const char *dir, const char *name, unsigned long long n, const char *ext) {
+    snprintf(out, size, "%s/%s-%08llu.%s", dir, name, n, ext);
+}
+
+static void collide_message(const struct collide_params *p, uint64_t index, uint8_t *out) {
+    memset(out, 0, p->len);
+
+    for(int i = 0; i < 8; i++) {
+        out[i]     = (uint8_t)(index >> (8 * i));
+        out[8 + i] = (uint8_t)(p->seed >> (8 * i));
+    }
+}
+
+static uint64_t collide_key(const struct collide_params *p, const uint8_t digest[COLLIDE_HASH_SIZE]) {
+    uint64_t v = 0;
+
+    for(int i = 0; i < 8; i++)
+        v = (v << 8) | digest[i];
+
+    return v >> (64 - p->bits);
+}
+
+static int collide_write_all(int fd, const void *buf, size_t len) {
+    const uint8_t *p = buf;
+
+    while(len) {
+        ssize_t n = write(fd, p, len);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n <= 0)
+            return -1;
+
+        p   += n;
+        len -= (size_t)n;
+    }
+
+    return 0;
+}
+
+/* written under a temporary name and renamed, so a present file is a complete one */
+static int collide_publish(const char *tmp, const char *final, const void *buf, size_t len) {
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if(fd < 0)
+        return -1;
+
+    if(collide_write_all(fd, buf, len) < 0 || fsync(fd) < 0) {
+        int saved = errno;
+
+        close(fd);
+        unlink(tmp);
+        errno = saved;
+        return -1;
+    }
+
+    close(fd);
+    return rename(tmp, final);
+}
+
+/* stable LSD radix sort on the key, skipping bytes every key shares */
+static void collide_sort(struct collide_record *recs, struct collide_record *tmp, size_t n, unsigned bits) {
+    struct collide_record *src = recs;
+    struct collide_record *dst = tmp;
+
+    for(unsigned shift = 0; shift < bits && n; shift += 8) {
+        size_t count[256] = {0};
+
+        for(size_t i = 0; i < n; i++)
+            count[(src[i].key >> shift) & 0xff]++;
+
+        if(count[(src[0].key >> shift) & 0xff] == n)
+            continue;
+
+        size_t sum = 0;
+
+        for(int b = 0; b < 256; b++) {
+            size_t c = count[b];
+            count[b] = sum;
+            sum     += c;
+        }
+
+        for(size_t i = 0; i < n; i++)
+            dst[count[(src[i].key >> shift) & 0xff]++] = src[i];
+
+        struct collide_record *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if(src != recs)
+        memcpy(recs, src, n * sizeof(*recs));
+}
+
+static int collide_run_done(const struct collide_search *s, unsigned long long run, size_t records) {
+    char path[4096];
+    struct stat st;
+
+    collide_path(path, sizeof(path), s->dir, "run", run, "bin");
+    return stat(path, &st) == 0 && (size_t)st.st_size == records * sizeof(struct collide_record);
+}
+
+static size_t collide_run_records(const struct collide_search *s, unsigned long long run) {
+    unsigned long long first = run * s->p.run_records;
+    unsigned long long left  = s->p.count - first;
+
+    return (size_t)(left < s->p.run_records ? left : s->p.run_records);
+}
+
+/* phase 1: hash one index range, sort it and spill it */
+static int collide_generate_run(struct collide_search *s, unsigned long long run,
+                                struct collide_record *recs, struct collide_record *tmp, uint8_t *msgs) {
+    const uint8_t *inputs[COLLIDE_HASH_BATCH];
+    size_t lens[COLLIDE_HASH_BATCH];
+    uint8_t digests[COLLIDE_HASH_BATCH * COLLIDE_HASH_SIZE];
+    size_t records = collide_run_records(s, run);
+    uint64_t first = run * s->p.run_records;
+
+    for(size_t done = 0; done < records; ) {
+        size_t batch = records - done < COLLIDE_HASH_BATCH ? records - done : COLLIDE_HASH_BATCH;
+
+        for(size_t i = 0; i < batch; i++) {
+            collide_message(&s->p, first + done + i, msgs + i * s->p.len);
+            inputs[i] = msgs + i * s->p.len;
+            lens[i]   = s->p.len;
+        }
+
+        qrh_256_multi(inputs, lens, batch, digests);
+
+        for(size_t i = 0; i < batch; i++) {
+            recs[done + i].key   = collide_key(&s->p, digests + i * COLLIDE_HASH_SIZE);
+            recs[done + i].index = first + done + i;
+        }
+
+        done += batch;
+    }
+
+    collide_sort(recs, tmp, records, s->p.bits);
+
+    char tmp_path[4096], path[4096];
+
+    collide_path(tmp_path, sizeof(tmp_path), s->dir, "run", run, "tmp");
+    collide_path(path, sizeof(path), s->dir, "run", run, "bin");
+
+    return collide_publish(tmp_path, path, recs, records * sizeof(*recs));
+}
+
+static void collide_generate_task(void *arg, size_t worker) {
+    struct collide_search *s = arg;
+    struct collide_record *recs = malloc(s->p.run_records * sizeof(*recs));
+    struct collide_record *tmp  = malloc(s->p.run_records * sizeof(*tmp));
+    uint8_t *msgs = malloc((size_t)COLLIDE_HASH_BATCH * s->p.len);
+
+    (void)worker;
+
+    if(!recs || !tmp || !msgs) {
+        pthread_mutex_lock(&s->lock);
+        s->failed = ENOMEM;
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    for(;;) {
+        pthread_mutex_lock(&s->lock);
+        unsigned long long run = s->failed ? s->nruns : s->next++;
+        pthread_mutex_unlock(&s->lock);
+
+        if(run >= s->nruns)
+            break;
+
+        if(collide_run_done(s, run, collide_run_records(s, run)))
+            continue;
+
+        int ret = collide_generate_run(s, run, recs, tmp, msgs);
+
+        pthread_mutex_lock(&s->lock);
+
+        if(ret < 0 && !s->failed)
+            s->failed = errno ? errno : EIO;
+
+        if(ret == 0)
+            fprintf(stderr, "qrh_collide: run %llu/%llu written\n", ++s->done, s->nruns);
+
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    free(recs);
+    free(tmp);
+    free(msgs);
+}
+
+/* phase 2: buffered cursor over one key range of one sorted run */
+struct collide_cursor {
+    int fd;
+    uint64_t pos;   /* record index in the run */
+    uint64_t end;
+    size_t have;
+    size_t at;
+    struct collide_record buf[COLLIDE_READ_RECORDS];
+};
+
+static int collide_read_record(int fd, uint64_t i, struct collide_record *rec) {
+    return pread(fd, rec, sizeof(*rec), (off_t)(i * sizeof(*rec))) == (ssize_t)sizeof(*rec) ? 0 : -1;
+}
+
+/* first record with key >= `key`, by binary search over the file */
+static int collide_lower_bound(int fd, uint64_t records, uint64_t key, uint64_t *out) {
+    uint64_t lo = 0, hi = records;
+    struct collide_record rec;
+
+    while(lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if(collide_read_record(fd, mid, &rec) < 0)
+            return -1;
+
+        if(rec.key < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    *out = lo;
+    return 0;
+}
+
+/* 1 when a record is available, 0 at end of range, -1 on error */
+static int collide_cursor_fill(struct collide_cursor *c) {
+    if(c->at < c->have)
+        return 1;
+
+    if(c->pos >= c->end)
+        return 0;
+
+    uint64_t want = c->end - c->pos < COLLIDE_READ_RECORDS ? c->end - c->pos : COLLIDE_READ_RECORDS;
+    ssize_t n = pread(c->fd, c->buf, (size_t)want * sizeof(c->buf[0]), (off_t)(c->pos * sizeof(c->buf[0])));
+
+    if(n <= 0 || (size_t)n % sizeof(c->buf[0]) != 0)
+        return -1;
+
+    c->have = (size_t)n / sizeof(c->buf[0]);
+    c->at   = 0;
+    c->pos += c->have;
+
+    return 1;
+}
+
+static int collide_less(const struct collide_record *a, const struct collide_record *b) {
+    return a->key < b->key || (a->key == b->key && a->index < b->index);
+}
+
+static void collide_sift_down(struct collide_cursor **heap, size_t n, size_t i) {
+    for(;;) {
+        size_t l = 2 * i + 1, r = l + 1, m = i;
+
+        if(l < n && collide_less(&heap[l]->buf[heap[l]->at], &heap[m]->buf[heap[m]->at]))
+            m = l;
+
+        if(r < n && collide_less(&heap[r]->buf[heap[r]->at], &heap[m]->buf[heap[m]->at]))
+            m = r;
+
+        if(m == i)
+            return;
+
+        struct collide_cursor *swap = heap[i];
+        heap[i] = heap[m];
+        heap[m] = swap;
+        i = m;
+    }
+}
+
+/* a member of a key group with its full digest, to tell full collisions from truncated ones */
+struct collide_member {
+    uint64_t index;
+    uint8_t digest[COLLIDE_HASH_SIZE];
+};
+
+struct collide_group {
+    uint64_t key;
+    struct collide_member *members;
+    size_t len;
+    size_t capacity;
+};
+
+/* appends input `index` to the group, recomputing its digest once for every later comparison */
+static struct collide_member *collide_group_add(const struct collide_params *p, struct collide_group *g, uint64_t index) {
+    uint8_t msg[COLLIDE_MAX_LEN];
+
+    if(g->len == g->capacity) {
+        size_t capacity = g->capacity ? g->capacity * 2 : 16;
+        struct collide_member *grown = realloc(g->members, capacity * sizeof(*grown));
+
+        if(!grown)
+            return NULL;
+
+        g->members  = grown;
+        g->capacity = capacity;
+    }
+
+    struct collide_member *m = &g->members[g->len++];
+
+    m->index = index;
+    collide_message(p, index, msg);
+    qrh_256(msg, p->len, m->digest);
+
+    return m;
+}
+
+struct collide_text {
+    char *data;
+    size_t len;
+    size_t capacity;
+};
+
+static int collide_text_printf(struct collide_text *t, const char *fmt, uint64_t key, uint64_t a, uint64_t b, const char *kind) {
+    char line[128];
+    int n = snprintf(line, sizeof(line), fmt, (unsigned long long)key, (unsigned long long)a, (unsigned long long)b, kind);
+
+    if(t->len + (size_t)n > t->capacity) {
+        size_t capacity = t->capacity ? t->capacity * 2 : 4096;
+        char *grown     = realloc(t->data, capacity);
+
+        if(!grown)
+            return -1;
+
+        t->data     = grown;
+        t->capacity = capacity;
+    }
+
+    memcpy(t->data + t->len, line, (size_t)n);
+    t->len += (size_t)n;
+
+    return 0;
+}
+
+/*
+ * Merge inputs of one partition: at level 0 the partition's key range of
+ * each run, at level L > 0 the files written by the pass before, which
+ * hold only that range.
+ */
+static void collide_merge_path(char *out, size_t size, const struct collide_search *s, unsigned part,
+                               unsigned level, unsigned long long i, const char *ext) {
+    char name[64];
+
+    if(level == 0) {
+        collide_path(out, size, s->dir, "run", i, "bin");
+        return;
+    }
+
+    snprintf(name, sizeof(name), "merge-%08u-%u", part, level);
+    collide_path(out, size, s->dir, name, i, ext);
+}
+
+static int collide_merge_open(const struct collide_search *s, unsigned part, unsigned level, unsigned long long first,
+                              size_t count, uint64_t lo, uint64_t hi, struct collide_cursor *cursors,
+                              struct collide_cursor **heap, size_t *n) {
+    *n = 0;
+
+    for(size_t i = 0; i < count; i++)
+        cursors[i].fd = -1;
+
+    for(size_t i = 0; i < count; i++) {
+        struct collide_cursor *c = &cursors[i];
+        char path[4096];
+        uint64_t records;
+        struct stat st;
+
+        collide_merge_path(path, sizeof(path), s, part, level, first + i, "bin");
+        c->fd = open(path, O_RDONLY | O_CLOEXEC);
+
+        if(c->fd < 0)
+            return -1;
+
+        if(level == 0) {
+            records = collide_run_records(s, first + i);
+
+            if(collide_lower_bound(c->fd, records, lo, &c->pos) < 0)
+                return -1;
+
+            if(hi == UINT64_MAX)
+                c->end = records;
+            else if(collide_lower_bound(c->fd, records, hi + 1, &c->end) < 0)
+                return -1;
+        } else {
+            if(fstat(c->fd, &st) < 0)
+                return -1;
+
+            c->pos = 0;
+            c->end = (uint64_t)st.st_size / sizeof(struct collide_record);
+        }
+
+        c->have = c->at = 0;
+
+        int more = collide_cursor_fill(c);
+
+        if(more < 0)
+            return -1;
+
+        if(more)
+            heap[(*n)++] = c;
+    }
+
+    for(size_t i = *n / 2; i-- > 0; )
+        collide_sift_down(heap, *n, i);
+
+    return 0;
+}
+
+/* consumed intermediate files go as soon as their pass is done */
+static void collide_merge_close(const struct collide_search *s, unsigned part, unsigned level, unsigned long long first,
+                                size_t count, struct collide_cursor *cursors, int consumed) {
+    for(size_t i = 0; i < count; i++) {
+        char path[4096];
+
+        if(cursors[i].fd >= 0)
+            close(cursors[i].fd);
+
+        if(consumed && level > 0) {
+            collide_merge_path(path, sizeof(path), s, part, level, first + i, "bin");
+            unlink(path);
+        }
+    }
+}
+
+/* 1 with the smallest record in `rec`, 0 when all inputs are done, -1 on error */
+static int collide_merge_pop(struct collide_cursor **heap, size_t *n, struct collide_record *rec) {
+    struct collide_cursor *c;
+    int more;
+
+    if(!*n)
+        return 0;
+
+    c    = heap[0];
+    *rec = c->buf[c->at++];
+    more = collide_cursor_fill(c);
+
+    if(more < 0)
+        return -1;
+
+    if(!more)
+        heap[0] = heap[--*n];
+
+    collide_sift_down(heap, *n, 0);
+    return 1;
+}
+
+/* one intermediate pass: inputs [first, first + count) of `level` into file `out` of level + 1 */
+static int collide_merge_pass(const struct collide_search *s, unsigned part, unsigned level, unsigned long long first,
+                              size_t count, unsigned long long out, uint64_t lo, uint64_t hi,
+                              struct collide_cursor *cursors, struct collide_cursor **heap,
+                              struct collide_record *wbuf) {
+    char tmp_path[4096], path[4096];
+    struct collide_record rec;
+    size_t n, have = 0;
+    int fd, got, ret = -1;
+
+    collide_merge_path(tmp_path, sizeof(tmp_path), s, part, level + 1, out, "tmp");
+    collide_merge_path(path, sizeof(path), s, part, level + 1, out, "bin");
+
+    if((fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+        return -1;
+
+    if(collide_merge_open(s, part, level, first, count, lo, hi, cursors, heap, &n) < 0)
+        goto out;
+
+    while((got = collide_merge_pop(heap, &n, &rec)) > 0) {
+        wbuf[have++] = rec;
+
+        if(have == COLLIDE_READ_RECORDS) {
+            if(collide_write_all(fd, wbuf, have * sizeof(*wbuf)) < 0)
+                goto out;
+
+            have = 0;
+        }
+    }
+
+    if(got == 0 && collide_write_all(fd, wbuf, have * sizeof(*wbuf)) == 0 && rename(tmp_path, path) == 0)
+        ret = 0;
+
+out:
+    collide_merge_close(s, part, level, first, count, cursors, ret == 0);
+    close(fd);
+
+    if(ret < 0)
+        unlink(tmp_path);
+
+    return ret;
+}
+
+static int collide_merge_partition(struct collide_search *s, unsigned part, struct collide_cursor *cursors,
+                                   struct collide_cursor **heap, struct collide_record *wbuf,
+                                   unsigned long long *pairs, unsigned long long *full) {
+    const unsigned shift = s->p.bits - (unsigned)__builtin_ctz(s->p.partitions);
+    const uint64_t lo    = (uint64_t)part << shift;
+    const uint64_t hi    = part + 1 == s->p.partitions ? UINT64_MAX : ((uint64_t)(part + 1) << shift) - 1;
+    struct collide_text text = {0};
+    struct collide_group group = {0};
+    struct collide_record rec;
+    unsigned long long inputs = s->nruns;
+    unsigned level = 0;
+    size_t n;
+    int got, ret = -1;
+
+    /* cascade until one pass can take every input */
+    while(inputs > s->fan_in) {
+        unsigned long long outputs = (inputs + s->fan_in - 1) / s->fan_in;
+
+        for(unsigned long long g = 0; g < outputs; g++) {
+            unsigned long long first = g * s->fan_in;
+            size_t count = (size_t)(inputs - first < s->fan_in ? inputs - first : s->fan_in);
+
+            if(collide_merge_pass(s, part, level, first, count, g, lo, hi, cursors, heap, wbuf) < 0)
+                return -1;
+        }
+
+        inputs = outputs;
+        level++;
+    }
+
+    if(collide_merge_open(s, part, level, 0, (size_t)inputs, lo, hi, cursors, heap, &n) < 0)
+        goto out;
+
+    /*
+     * Records come out in key order, so equal keys are adjacent. Each record
+     * is paired with every earlier member of its group, one line per pair:
+     * a group of m members prints m(m-1)/2 lines.
+     */
+    while((got = collide_merge_pop(heap, &n, &rec)) > 0) {
+        struct collide_member *m;
+
+        if(!group.len || rec.key != group.key) {
+            group.key = rec.key;
+            group.len = 0;
+        }
+
+        if(!(m = collide_group_add(&s->p, &group, rec.index))) {
+            got = -1;
+            break;
+        }
+
+        for(struct collide_member *o = group.members; o < m; o++) {
+            int same = memcmp(o->digest, m->digest, COLLIDE_HASH_SIZE) == 0;
+
+            *pairs += 1;
+            *full  += same;
+
+            if(collide_text_printf(&text, "%016llx %llu %llu %s\n", rec.key, o->index, m->index, same ? "full" : "truncated") < 0)
+                goto out;
+        }
+    }
+
+    if(got < 0)
+        goto out;
+
+    char tmp_path[4096], path[4096];
+
+    collide_path(tmp_path, sizeof(tmp_path), s->dir, "part", part, "tmp");
+    collide_path(path, sizeof(path), s->dir, "part", part, "txt");
+
+    ret = collide_publish(tmp_path, path, text.data ? text.data : "", text.len);
+
+out:
+    collide_merge_close(s, part, level, 0, (size_t)inputs, cursors, ret == 0);
+    free(group.members);
+    free(text.data);
+    return ret;
+}
+
+/* a finished partition is summed from its file, so resumed totals match */
+static int collide_count_partition(const struct collide_search *s, unsigned part,
+                                   unsigned long long *pairs, unsigned long long *full) {
+    char path[4096], kind[16];
+    unsigned long long key, a, b;
+
+    collide_path(path, sizeof(path), s->dir, "part", part, "txt");
+
+    FILE *f = fopen(path, "r");
+
+    if(!f)
+        return -1;
+
+    /* one line per pair, as written by collide_merge_partition() */
+    while(fscanf(f, "%llx %llu %llu %15s", &key, &a, &b, kind) == 4) {
+        *pairs += 1;
+        *full  += strcmp(kind, "full") == 0;
+    }
+
+    fclose(f);
+    return 0;
+}
+
+static void collide_merge_task(void *arg, size_t worker) {
+    struct collide_search *s = arg;
+    struct collide_cursor *cursors = calloc(s->fan_in, sizeof(*cursors));
+    struct collide_cursor **heap   = calloc(s->fan_in, sizeof(*heap));
+    struct collide_record *wbuf    = malloc(COLLIDE_READ_RECORDS * sizeof(*wbuf));
+
+    (void)worker;
+
+    if(!cursors || !heap || !wbuf) {
+        pthread_mutex_lock(&s->lock);
+        s->failed = ENOMEM;
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    for(;;) {
+        pthread_mutex_lock(&s->lock);
+        unsigned long long part = s->failed ? s->p.partitions : s->next++;
+        pthread_mutex_unlock(&s->lock);
+
+        if(part >= s->p.partitions)
+            break;
+
+        unsigned long long pairs = 0, full = 0;
+        int ret = collide_count_partition(s, (unsigned)part, &pairs, &full);
+
+        if(ret < 0) {
+            pairs = full = 0;
+            ret   = collide_merge_partition(s, (unsigned)part, cursors, heap, wbuf, &pairs, &full);
+        }
+
+        pthread_mutex_lock(&s->lock);
+
+        if(ret < 0 && !s->failed)
+            s->failed = errno ? errno : EIO;
+
+        s->pairs += pairs;
+        s->full  += full;
+
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    free(cursors);
+    free(heap);
+    free(wbuf);
+}
+
+/* `nthreads` copies of `fn`, each pulling runs or partitions until none are left */
+static int collide_run_phase(struct collide_search *s, qrh_pool_index_fn fn) {
+    s->next = 0;
+    s->done = 0;
+
+    qrh_pool_parallel(s->pool, s->nthreads, fn, s);
+
+    if(s->failed) {
+        errno = s->failed;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Merge inputs a worker may hold open at once: each takes a descriptor and a
+ * cursor, and the worker one more of each for its output, so the fan-in is
+ * bounded by RLIMIT_NOFILE (soft limit raised to the hard one first) and by
+ * the worker's share of -m. 0 when the descriptors allow no merge at all.
+ */
+static unsigned collide_fan_in(unsigned long long mib, unsigned nthreads) {
+    unsigned long long by_memory = (mib << 20) / nthreads / sizeof(struct collide_cursor);
+    unsigned long long fan_in    = by_memory > 2 ? by_memory - 1 : 2;
+    struct rlimit nofile;
+
+    if(getrlimit(RLIMIT_NOFILE, &nofile) == 0) {
+        if(nofile.rlim_cur < nofile.rlim_max) {
+            nofile.rlim_cur = nofile.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &nofile);
+            getrlimit(RLIMIT_NOFILE, &nofile);
+        }
+
+        if(nofile.rlim_cur != RLIM_INFINITY) {
+            unsigned long long by_fds = nofile.rlim_cur > COLLIDE_RESERVED_FDS ?
+                                        (nofile.rlim_cur - COLLIDE_RESERVED_FDS) / nthreads : 0;
+
+            if(by_fds < 3)
+                return 0;
+
+            if(by_fds - 1 < fan_in)
+                fan_in = by_fds - 1;
+        }
+    }
+
+    return fan_in > UINT_MAX ? UINT_MAX : (unsigned)fan_in;
+}
+
+/* the first start records the parameters, later starts must agree with them */
+static int collide_state(const char *dir, struct collide_params *p) {
+    char path[4096];
+    struct collide_params saved;
+    int profile[3];
+
+    snprintf(path, sizeof(path), "%s/%s", dir, COLLIDE_STATE_FILE);
+
+    FILE *f = fopen(path, "r");
+
+    if(f) {
+        int n = fscanf(f, "qrh-collide 1 bits %u count %llu seed %llu len %u run %llu partitions %u profile %d %d %d",
+                       &saved.bits, &saved.count, &saved.seed, &saved.len, &saved.run_records, &saved.partitions,
+                       &profile[0], &profile[1], &profile[2]);
+        fclose(f);
+
+        if(n != 9 || saved.bits != p->bits || saved.count != p->count || saved.seed != p->seed || saved.len != p->len ||
+           profile[0] != QRH_HALF_ROUNDS || profile[1] != QRH_DIFFUSIONS || profile[2] != QRH_MATRIX_ROUNDS) {
+            fprintf(stderr, "qrh_collide: %s belongs to a different search\n", path);
+            return -1;
+        }
+
+        /* memory and partitioning are fixed by the first start */
+        p->run_records = saved.run_records;
+        p->partitions  = saved.partitions;
+        return 0;
+    }
+
+    char text[256];
+    char tmp[4096];
+    int len = snprintf(text, sizeof(text), "qrh-collide 1 bits %u count %llu seed %llu len %u run %llu partitions %u profile %d %d %d\n",
+                       p->bits, p->count, p->seed, p->len, p->run_records, p->partitions,
+                       QRH_HALF_ROUNDS, QRH_DIFFUSIONS, QRH_MATRIX_ROUNDS);
+
+    snprintf(tmp, sizeof(tmp), "%s/%s.tmp", dir, COLLIDE_STATE_FILE);
+
+    if(collide_publish(tmp, path, text, (size_t)len) < 0) {
+        fprintf(stderr, "qrh_collide: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+static void collide_usage(FILE *stream) {
+    fprintf(stream,
+            "Usage: qrh_collide -d DIR -n COUNT -b BITS [-l BYTES] [-s SEED] [-m MIB] [-p PARTS] [-j THREADS]\n"
+            "\n"
+            "Birthday search on QRH-256 digests truncated to BITS. Rerun with the same DIR to resume.\n"
+            "\n"
+            "  -d DIR       work directory for sorted runs, partitions and state\n"
+            "  -n COUNT     inputs to hash\n"
+            "  -b BITS      digest bits compared, 16..64\n"
+            "  -l BYTES     input length, %d..%d (default %d)\n"
+            "  -s SEED      input seed (default 0)\n"
+            "  -m MIB       memory across all threads, for runs and merge buffers (default 1024)\n"
+            "  -p PARTS     merge key ranges, a power of two (default 256)\n"
+            "  -j THREADS   worker threads (default: online CPUs)\n",
+            COLLIDE_MIN_LEN, COLLIDE_MAX_LEN, COLLIDE_MIN_LEN);
+}
+
+int main(int argc, char **argv) {
+    struct collide_search s = { .p = { .len = COLLIDE_MIN_LEN, .partitions = 256 } };
+    unsigned long long mib = 1024;
+
+    s.nthreads = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    pthread_mutex_init(&s.lock, NULL);
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            s.dir = argv[++i];
+        } else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            s.p.count = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            s.p.bits = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            s.p.len = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            s.p.seed = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            mib = strtoull(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            s.p.partitions = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            s.nthreads = (unsigned)strtoul(argv[++i], NULL, 0);
+        } else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            collide_usage(stdout);
+            return 0;
+        } else {
+            collide_usage(stderr);
+            return 2;
+        }
+    }
+
+    if(s.nthreads == 0)
+        s.nthreads = 1;
+
+    if(s.nthreads > COLLIDE_MAX_THREADS)
+        s.nthreads = COLLIDE_MAX_THREADS;
+
+    if(!s.dir || s.p.count < 2 || s.p.bits < 16 || s.p.bits > 64 || mib == 0 ||
+       s.p.len < COLLIDE_MIN_LEN || s.p.len > COLLIDE_MAX_LEN ||
+       s.p.partitions == 0 || (s.p.partitions & (s.p.partitions - 1)) ||
+       (unsigned)__builtin_ctz(s.p.partitions) > s.p.bits) {
+        collide_usage(stderr);
+        return 2;
+    }
+
+    /* each generating thread holds a run and its sort buffer */
+    s.p.run_records = (mib << 20) / (2 * sizeof(struct collide_record) * s.nthreads);
+
+    if(s.p.run_records > s.p.count)
+        s.p.run_records = s.p.count;
+
+    if(s.p.run_records == 0)
+        s.p.run_records = 1;
+
+    if(mkdir(s.dir, 0755) < 0 && errno != EEXIST) {
+        fprintf(stderr, "qrh_collide: %s: %s\n", s.dir, strerror(errno));
+        return 2;
+    }
+
+    if(collide_state(s.dir, &s.p) < 0)
+        return 2;
+
+    s.nruns  = (s.p.count + s.p.run_records - 1) / s.p.run_records;
+    s.fan_in = collide_fan_in(mib, s.nthreads);
+
+    if(s.fan_in == 0) {
+        fprintf(stderr, "qrh_collide: too few file descriptors for %u merge workers, lower -j\n", s.nthreads);
+        return 2;
+    }
+
+    struct qrh_pool_config pool_cfg = { .threads = s.nthreads };
+
+    s.pool = qrh_pool_create(&pool_cfg);
+
+    if(!s.pool) {
+        fprintf(stderr, "qrh_collide: unable to start workers: %s\n", strerror(errno));
+        return 2;
+    }
+
+    if(collide_run_phase(&s, collide_generate_task) < 0) {
+        fprintf(stderr, "qrh_collide: generating runs: %s\n", strerror(errno));
+        return 2;
+    }
+
+    if(collide_run_phase(&s, collide_merge_task) < 0) {
+        fprintf(stderr, "qrh_collide: merging runs: %s\n", strerror(errno));
+        return 2;
+    }
+
+    qrh_pool_destroy(s.pool);
+
+    /* expected colliding pairs among n uniform b-bit values: n(n-1) / 2^(b+1) */
+    double n        = (double)s.p.count;
+    double expected = n * (n - 1) / ldexp(2.0, (int)s.p.bits);
+
+    printf("QRH-256 Truncated Collision Search\n");
+    printf("==================================\n");
+    printf("Config:\n");
+    printf("    Round profile: half rounds %d, diffusions %d, matrix rounds %d\n",
+           QRH_HALF_ROUNDS, QRH_DIFFUSIONS, QRH_MATRIX_ROUNDS);
+    printf("    Inputs: %llu x %u bytes, seed %llu\n", s.p.count, s.p.len, s.p.seed);
+    printf("    Truncation: %u bits\n", s.p.bits);
+    printf("    Runs: %llu x %llu records, %u merge partitions, merge fan-in %u\n\n",
+           s.nruns, s.p.run_records, s.p.partitions, s.fan_in);
+    printf("Results:\n");
+    printf("    Colliding pairs: %llu (expected %.2f, ratio %.3f)\n", s.pairs, expected, expected > 0 ? (double)s.pairs / expected : 0.0);
+    printf("    Full 256-bit collisions: %llu\n", s.full);
+    printf("    Pairs listed in %s/part-*.txt as: key index_a index_b full|truncated\n", s.dir);
+
+    return s.full ? 1 : 0;
+}
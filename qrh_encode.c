@@ -0,0 +1,268 @@
+/**
+ * qrh_encode.c
+ *
+ * Features:
+ *   - Hex, base64 and base32 text forms of 32-byte digests (RFC 4648 alphabets)
+ *   - Batch encoders writing many digests into one caller buffer
+ *   - Hex via nibble table lookups (AVX2 / SSSE3 pshufb), base64 via SSSE3
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_encode.h"
+
+#if !defined(__AVX2__) && !defined(__SSSE3__)
+static const char hex_digits[]   = "0123456789abcdef";
+#endif
+
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char base32_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567";
+
+/* hex */
+static inline void encode_hex(const uint8_t *digest, char *out) {
+#if defined(__AVX2__)
+    const __m256i lut  = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f',
+                                          '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    __m256i in = _mm256_loadu_si256((const __m256i *)digest);
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(in, 4), mask));
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(in, mask));
+
+    /* unpack works per 128-bit lane, so the halves come out as bytes 0-7|16-23 and 8-15|24-31 */
+    __m256i a = _mm256_unpacklo_epi8(hi, lo);
+    __m256i b = _mm256_unpackhi_epi8(hi, lo);
+
+    _mm256_storeu_si256((__m256i *)out,        _mm256_permute2x128_si256(a, b, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 32), _mm256_permute2x128_si256(a, b, 0x31));
+#elif defined(__SSSE3__)
+    const __m128i lut  = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i mask = _mm_set1_epi8(0x0F);
+
+    for(int half = 0; half < 2; half++) {
+        __m128i in = _mm_loadu_si128((const __m128i *)(digest + half * 16));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, mask));
+
+        _mm_storeu_si128((__m128i *)(out + half * 32),      _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i *)(out + half * 32 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+#else
+    for(int i = 0; i < QRH_DIGEST_SIZE; i++) {
+        out[i * 2]     = hex_digits[digest[i] >> 4];
+        out[i * 2 + 1] = hex_digits[digest[i] & 0x0F];
+    }
+#endif
+}
+
+/* base64 */
+#if defined(__SSSE3__)
+/* 12 input bytes -> 16 six-bit indices, one per output byte (Mula's multiply-shift trick) */
+static inline __m128i base64_split(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+
+    return _mm_or_si128(t1, t3);
+}
+
+/* index -> ASCII by adding a per-range offset */
+static inline __m128i base64_translate(__m128i idx) {
+    const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+    __m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+
+    range = _mm_sub_epi8(range, _mm_cmpgt_epi8(idx, _mm_set1_epi8(25)));
+    return _mm_add_epi8(idx, _mm_shuffle_epi8(offsets, range));
+}
+#endif
+
+static inline void encode_base64_group(const uint8_t *in, char *out) {
+    uint32_t v = ((uint32_t)in[0] << 16) | ((uint32_t)in[1] << 8) | in[2];
+
+    out[0] = base64_chars[(v >> 18) & 0x3F];
+    out[1] = base64_chars[(v >> 12) & 0x3F];
+    out[2] = base64_chars[(v >> 6) & 0x3F];
+    out[3] = base64_chars[v & 0x3F];
+}
+
+static inline void encode_base64(const uint8_t *digest, char *out) {
+    int group = 0;
+
+#if defined(__SSSE3__)
+    /* bytes 0-23 as two 12-byte steps; both 16-byte loads stay inside the digest */
+    _mm_storeu_si128((__m128i *)out,        base64_translate(base64_split(_mm_loadu_si128((const __m128i *)digest))));
+    _mm_storeu_si128((__m128i *)(out + 16), base64_translate(base64_split(_mm_loadu_si128((const __m128i *)(digest + 12)))));
+    group = 8;
+#endif
+
+    for(; group < 10; group++)
+        encode_base64_group(digest + group * 3, out + group * 4);
+
+    /* 32 = 10 * 3 + 2 */
+    uint32_t v = ((uint32_t)digest[30] << 8) | digest[31];
+
+    out[40] = base64_chars[(v >> 10) & 0x3F];
+    out[41] = base64_chars[(v >> 4) & 0x3F];
+    out[42] = base64_chars[(v << 2) & 0x3F];
+    out[43] = '=';
+}
+
+/* base32, 5 input bytes -> 8 characters */
+static void encode_base32(const uint8_t *digest, char *out) {
+    uint8_t padded[35] = {0};
+
+    memcpy(padded, digest, QRH_DIGEST_SIZE);
+
+    for(int group = 0; group < 7; group++) {
+        const uint8_t *in = padded + group * 5;
+        uint64_t v = ((uint64_t)in[0] << 32) | ((uint64_t)in[1] << 24) | ((uint64_t)in[2] << 16) |
+                     ((uint64_t)in[3] << 8) | in[4];
+
+        for(int i = 0; i < 8; i++)
+            out[group * 8 + i] = base32_chars[(v >> (35 - i * 5)) & 0x1F];
+    }
+
+    /* the last group carries 2 bytes = 16 bits -> 4 characters */
+    memset(out + 52, '=', 4);
+}
+
+void qrh_digest_to_hex(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_HEX_LEN + 1]) {
+    encode_hex(digest, out);
+    out[QRH_HEX_LEN] = '\0';
+}
+
+void qrh_digest_to_base64(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_BASE64_LEN + 1]) {
+    encode_base64(digest, out);
+    out[QRH_BASE64_LEN] = '\0';
+}
+
+void qrh_digest_to_base32(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_BASE32_LEN + 1]) {
+    encode_base32(digest, out);
+    out[QRH_BASE32_LEN] = '\0';
+}
+
+size_t qrh_digests_to_hex(const uint8_t *digests, size_t count, char *out, char sep) {
+    size_t stride = QRH_HEX_LEN + (sep != '\0');
+
+    for(size_t i = 0; i < count; i++) {
+        encode_hex(digests + i * QRH_DIGEST_SIZE, out + i * stride);
+
+        if(sep)
+            out[i * stride + QRH_HEX_LEN] = sep;
+    }
+
+    return count * stride;
+}
+
+size_t qrh_digests_to_base64(const uint8_t *digests, size_t count, char *out, char sep) {
+    size_t stride = QRH_BASE64_LEN + (sep != '\0');
+
+    for(size_t i = 0; i < count; i++) {
+        encode_base64(digests + i * QRH_DIGEST_SIZE, out + i * stride);
+
+        if(sep)
+            out[i * stride + QRH_BASE64_LEN] = sep;
+    }
+
+    return count * stride;
+}
+
+/* decoders */
+static int decode_hex_nibble(char c) {
+    if(c >= '0' && c <= '9')
+        return c - '0';
+
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+
+    return -1;
+}
+
+int qrh_digest_from_hex(const char *in, uint8_t digest[QRH_DIGEST_SIZE]) {
+    for(int i = 0; i < QRH_DIGEST_SIZE; i++) {
+        int hi = decode_hex_nibble(in[i * 2]);
+        int lo = hi < 0 ? -1 : decode_hex_nibble(in[i * 2 + 1]);
+
+        if(lo < 0)
+            return -1;
+
+        digest[i] = (uint8_t)((hi << 4) | lo);
+    }
+
+    /* a digest followed by more text is not a digest */
+    return in[QRH_HEX_LEN] == '\0' ? 0 : -1;
+}
+
+static int decode_alphabet(const char *alphabet, char c) {
+    const char *hit = c ? strchr(alphabet, c) : NULL;
+
+    return hit ? (int)(hit - alphabet) : -1;
+}
+
+int qrh_digest_from_base64(const char *in, uint8_t digest[QRH_DIGEST_SIZE]) {
+    uint32_t acc = 0;
+    int bits     = 0;
+    int out      = 0;
+
+    for(int i = 0; i < QRH_BASE64_LEN - 1; i++) {
+        int v = decode_alphabet(base64_chars, in[i]);
+
+        if(v < 0)
+            return -1;
+
+        acc   = (acc << 6) | (uint32_t)v;
+        bits += 6;
+
+        if(bits >= 8) {
+            bits -= 8;
+            digest[out++] = (uint8_t)(acc >> bits);
+        }
+    }
+
+    /* the two left-over bits must be zero for a canonical encoding */
+    if(in[QRH_BASE64_LEN - 1] != '=' || (acc & ((1u << bits) - 1)) != 0 || in[QRH_BASE64_LEN] != '\0')
+        return -1;
+
+    return 0;
+}
+
+int qrh_digest_from_base32(const char *in, uint8_t digest[QRH_DIGEST_SIZE]) {
+    uint64_t acc = 0;
+    int bits     = 0;
+    int out      = 0;
+
+    for(int i = 0; i < 52; i++) {
+        int v = decode_alphabet(base32_chars, in[i]);
+
+        if(v < 0)
+            return -1;
+
+        acc   = (acc << 5) | (uint64_t)v;
+        bits += 5;
+
+        if(bits >= 8) {
+            bits -= 8;
+            digest[out++] = (uint8_t)(acc >> bits);
+        }
+    }
+
+    /* byte by byte: a shorter string ends at its NUL, which must not be read past */
+    for(int i = 52; i < QRH_BASE32_LEN; i++) {
+        if(in[i] != '=')
+            return -1;
+    }
+
+    if((acc & ((1u << bits) - 1)) != 0 || in[QRH_BASE32_LEN] != '\0')
+        return -1;
+
+    return 0;
+}
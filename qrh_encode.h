@@ -0,0 +1,33 @@
+#ifndef QRH_ENCODE_H
+#define QRH_ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define QRH_DIGEST_SIZE     32
+#define QRH_HEX_LEN         64 /* lowercase */
+#define QRH_BASE64_LEN      44 /* RFC 4648, padded */
+#define QRH_BASE32_LEN      56 /* RFC 4648, padded */
+
+/* single digest, the text form is NUL-terminated */
+void qrh_digest_to_hex(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_HEX_LEN + 1]);
+void qrh_digest_to_base64(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_BASE64_LEN + 1]);
+void qrh_digest_to_base32(const uint8_t digest[QRH_DIGEST_SIZE], char out[QRH_BASE32_LEN + 1]);
+
+/*
+ * Parse exactly one encoded digest from a NUL-terminated string of exactly
+ * LEN characters. 0 on success, -1 on malformed input, including trailing text.
+ */
+int qrh_digest_from_hex(const char *in, uint8_t digest[QRH_DIGEST_SIZE]);
+int qrh_digest_from_base64(const char *in, uint8_t digest[QRH_DIGEST_SIZE]);
+int qrh_digest_from_base32(const char *in, uint8_t digest[QRH_DIGEST_SIZE]);
+
+/*
+ * Batch encoders for `count` packed digests. Each encoded digest is followed
+ * by `sep` unless it is '\0', so `out` needs count * (LEN + (sep != 0)) bytes.
+ * Nothing is NUL-terminated. Returns the number of bytes written.
+ */
+size_t qrh_digests_to_hex(const uint8_t *digests, size_t count, char *out, char sep);
+size_t qrh_digests_to_base64(const uint8_t *digests, size_t count, char *out, char sep);
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef QRH_HASHER_HPP
+#define QRH_HASHER_HPP
+
+/**
+ * qrh_hasher.hpp
+ *
+ * Features:
+ *   - std::hash-compatible qrh::hasher<T> on top of the qrh_64() fast path
+ *   - Strings, string views, C strings, spans, integers, enums, pairs and tuples
+ *   - Transparent (is_transparent) string hashing for heterogeneous lookup
+ *
+ * Equal values of different key types hash alike: std::string, std::string_view
+ * and const char * of the same text, and integers of equal value.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+extern "C" {
+#include "qrh_256.h"
+}
+
+namespace qrh {
+
+inline std::uint64_t hash_bytes(const void *data, std::size_t len, std::uint64_t seed = 0) noexcept {
+    return qrh_64(data, len, seed);
+}
+
+inline std::uint64_t hash_u64(std::uint64_t value, std::uint64_t seed = 0) noexcept {
+    return qrh_64_u64(value, seed);
+}
+
+template<class T, class Enable = void>
+struct hasher;
+
+/* integers and enums, sign-extended so equal values of any width agree */
+template<class T>
+struct hasher<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>> {
+    std::size_t operator()(T value) const noexcept {
+        using U = std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::common_type<T>>;
+        using V = typename U::type;
+
+        if constexpr(std::is_signed_v<V>)
+            return static_cast<std::size_t>(hash_u64(static_cast<std::uint64_t>(static_cast<std::int64_t>(value))));
+        else
+            return static_cast<std::size_t>(hash_u64(static_cast<std::uint64_t>(value)));
+    }
+};
+
+/* all narrow string forms share one transparent hasher */
+struct string_hasher {
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view s) const noexcept {
+        return static_cast<std::size_t>(hash_bytes(s.data(), s.size()));
+    }
+
+    std::size_t operator()(const std::string &s) const noexcept {
+        return (*this)(std::string_view(s));
+    }
+
+    std::size_t operator()(const char *s) const noexcept {
+        return (*this)(std::string_view(s));
+    }
+};
+
+template<class Traits, class Alloc>
+struct hasher<std::basic_string<char, Traits, Alloc>> : string_hasher {};
+
+template<class Traits>
+struct hasher<std::basic_string_view<char, Traits>> : string_hasher {};
+
+template<>
+struct hasher<const char *> : string_hasher {};
+
+template<>
+struct hasher<char *> : string_hasher {};
+
+#if __cplusplus >= 202002L
+/* contiguous ranges whose bytes are the value, e.g. std::span<const std::byte> */
+template<class T, std::size_t Extent>
+struct hasher<std::span<T, Extent>, std::enable_if_t<std::has_unique_object_representations_v<std::remove_cv_t<T>>>> {
+    std::size_t operator()(std::span<T, Extent> s) const noexcept {
+        return static_cast<std::size_t>(hash_bytes(s.data(), s.size_bytes()));
+    }
+};
+#endif
+
+namespace detail {
+
+/* element hashes are hashed again as one block, seeded with the arity */
+template<class... Ts>
+std::size_t combine(const Ts &...values) noexcept {
+    const std::uint64_t parts[] = { static_cast<std::uint64_t>(hasher<Ts>{}(values))... };
+
+    return static_cast<std::size_t>(hash_bytes(parts, sizeof(parts), sizeof...(Ts)));
+}
+
+} // namespace detail
+
+template<class... Ts>
+struct hasher<std::tuple<Ts...>> {
+    std::size_t operator()(const std::tuple<Ts...> &t) const noexcept {
+        if constexpr(sizeof...(Ts) == 0)
+            return static_cast<std::size_t>(hash_bytes(nullptr, 0));
+        else
+            return std::apply([](const Ts &...values) { return detail::combine(values...); }, t);
+    }
+};
+
+/* same value as the equivalent two-element tuple */
+template<class A, class B>
+struct hasher<std::pair<A, B>> {
+    std::size_t operator()(const std::pair<A, B> &p) const noexcept {
+        return detail::combine(p.first, p.second);
+    }
+};
+
+/* transparent equality to pair with string_hasher in heterogeneous-lookup maps */
+using equal_to = std::equal_to<>;
+
+} // namespace qrh
+
+#endif
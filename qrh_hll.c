@@ -0,0 +1,360 @@
+/**
+ * qrh_hll.c
+ *
+ * Features:
+ *   - Register index and rank from one qrh_64() per key
+ *   - Batches hashed 8 keys at a time through qrh_64_multi()
+ *   - Register merges take the byte-wise maximum 32 (AVX2) or 16 (SSE2)
+ *     registers at a time
+ *   - Ertl's improved estimator from the register histogram, no bias tables
+ *   - 6-bit packed serialization
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+#include "qrh_hll.h"
+
+#define HLL_DEFAULT_PRECISION 14
+#define HLL_BATCH             256                /* hashes computed per multi call */
+#define HLL_PART_MIN          4096               /* keys per parallel part */
+#define HLL_PARTS_MAX         64
+#define HLL_MAGIC             "QHLL"
+#define HLL_VERSION           1
+#define HLL_HEADER_SIZE       14                 /* magic, version, precision, le64 seed */
+#define HLL_REGISTER_BITS     6
+
+struct qrh_hll {
+    unsigned precision;
+    uint64_t seed;
+    size_t count;                                /* 2^precision registers */
+    uint8_t registers[];
+};
+
+struct hll_parallel {
+    const struct qrh_hll *hll;
+    const uint8_t *const *keys;
+    const size_t *lens;
+    size_t count;
+    size_t parts;
+    uint8_t *partial;                            /* parts * hll->count registers */
+};
+
+static struct qrh_hll *hll_alloc(unsigned precision, uint64_t seed) {
+    size_t count = (size_t)1 << precision;
+    struct qrh_hll *hll = calloc(1, sizeof(*hll) + count);
+
+    if(!hll)
+        return NULL;
+
+    hll->precision = precision;
+    hll->seed      = seed;
+    hll->count     = count;
+
+    return hll;
+}
+
+static inline void hll_add(uint8_t *registers, unsigned precision, uint64_t hash) {
+    size_t index = (size_t)(hash >> (64 - precision));
+    /* the guard bit caps the rank at 65 - precision, which fits in 6 bits */
+    uint64_t rest = (hash << precision) | ((uint64_t)1 << (precision - 1));
+    uint8_t rank  = (uint8_t)(__builtin_clzll(rest) + 1);
+
+    if(rank > registers[index])
+        registers[index] = rank;
+}
+
+static void hll_add_keys(uint8_t *registers, unsigned precision, uint64_t seed, const uint8_t *const keys[],
+                         const size_t lens[], size_t count) {
+    uint64_t hashes[HLL_BATCH];
+
+    for(size_t first = 0; first < count; first += HLL_BATCH) {
+        size_t n = count - first < HLL_BATCH ? count - first : HLL_BATCH;
+
+        qrh_64_multi(keys + first, lens + first, n, seed, hashes);
+
+        for(size_t i = 0; i < n; i++)
+            hll_add(registers, precision, hashes[i]);
+    }
+}
+
+/* dst[i] = max(dst[i], src[i]) */
+static void hll_max(uint8_t *dst, const uint8_t *src, size_t count) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for(; i + 32 <= count; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + i));
+
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_max_epu8(a, b));
+    }
+#elif defined(__SSE2__)
+    for(; i + 16 <= count; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(a, b));
+    }
+#endif
+
+    /* tail, or every register without SIMD */
+    for(; i < count; i++)
+        if(src[i] > dst[i])
+            dst[i] = src[i];
+}
+
+struct qrh_hll *qrh_hll_create(const struct qrh_hll_config *cfg) {
+    unsigned precision = cfg && cfg->precision ? cfg->precision : HLL_DEFAULT_PRECISION;
+    struct qrh_hll *hll;
+
+    if(precision < QRH_HLL_MIN_PRECISION || precision > QRH_HLL_MAX_PRECISION) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    hll = hll_alloc(precision, cfg ? cfg->seed : 0);
+
+    if(!hll)
+        errno = ENOMEM;
+
+    return hll;
+}
+
+void qrh_hll_destroy(struct qrh_hll *hll) {
+    free(hll);
+}
+
+void qrh_hll_clear(struct qrh_hll *hll) {
+    memset(hll->registers, 0, hll->count);
+}
+
+void qrh_hll_insert(struct qrh_hll *hll, const void *key, size_t len) {
+    hll_add(hll->registers, hll->precision, qrh_64(key, len, hll->seed));
+}
+
+void qrh_hll_insert_u64(struct qrh_hll *hll, uint64_t value) {
+    hll_add(hll->registers, hll->precision, qrh_64_u64(value, hll->seed));
+}
+
+void qrh_hll_insert_hash(struct qrh_hll *hll, uint64_t hash) {
+    hll_add(hll->registers, hll->precision, hash);
+}
+
+void qrh_hll_insert_batch(struct qrh_hll *hll, const uint8_t *const keys[], const size_t lens[], size_t count) {
+    hll_add_keys(hll->registers, hll->precision, hll->seed, keys, lens, count);
+}
+
+void qrh_hll_insert_u64_batch(struct qrh_hll *hll, const uint64_t *values, size_t count) {
+    uint64_t hashes[HLL_BATCH];
+
+    for(size_t first = 0; first < count; first += HLL_BATCH) {
+        size_t n = count - first < HLL_BATCH ? count - first : HLL_BATCH;
+
+        qrh_64_u64_multi(values + first, n, hll->seed, hashes);
+
+        for(size_t i = 0; i < n; i++)
+            hll_add(hll->registers, hll->precision, hashes[i]);
+    }
+}
+
+static void hll_part_task(void *arg, size_t part) {
+    struct hll_parallel *job = arg;
+    size_t first = job->count * part / job->parts;
+    size_t last  = job->count * (part + 1) / job->parts;
+
+    hll_add_keys(job->partial + part * job->hll->count, job->hll->precision, job->hll->seed, job->keys + first,
+                 job->lens + first, last - first);
+}
+
+int qrh_hll_insert_parallel(struct qrh_hll *hll, struct qrh_pool *pool, const uint8_t *const keys[],
+                            const size_t lens[], size_t count) {
+    size_t parts = count / HLL_PART_MIN;
+    unsigned threads = qrh_pool_threads(pool ? pool : qrh_pool_default());
+
+    if(parts > threads)
+        parts = threads;
+
+    if(parts > HLL_PARTS_MAX)
+        parts = HLL_PARTS_MAX;
+
+    if(parts < 2) {
+        qrh_hll_insert_batch(hll, keys, lens, count);
+        return 0;
+    }
+
+    struct hll_parallel job = { hll, keys, lens, count, parts, calloc(parts, hll->count) };
+
+    if(!job.partial) {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    qrh_pool_parallel(pool, parts, hll_part_task, &job);
+
+    for(size_t p = 0; p < parts; p++)
+        hll_max(hll->registers, job.partial + p * hll->count, hll->count);
+
+    free(job.partial);
+    return 0;
+}
+
+int qrh_hll_merge(struct qrh_hll *hll, const struct qrh_hll *other) {
+    if(hll->precision != other->precision || hll->seed != other->seed) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    hll_max(hll->registers, other->registers, hll->count);
+    return 0;
+}
+
+/* Ertl, "New cardinality estimation algorithms for HyperLogLog sketches", 2017 */
+static double hll_sigma(double x) {
+    double y = 1, z = x, prev;
+
+    if(x == 1)
+        return INFINITY;
+
+    do {
+        x *= x;
+        prev = z;
+        z += x * y;
+        y += y;
+    } while(z != prev);
+
+    return z;
+}
+
+static double hll_tau(double x) {
+    double y = 1, z = 1 - x, prev;
+
+    if(x == 0 || x == 1)
+        return 0;
+
+    do {
+        x = sqrt(x);
+        prev = z;
+        y *= 0.5;
+        z -= (1 - x) * (1 - x) * y;
+    } while(z != prev);
+
+    return z / 3;
+}
+
+double qrh_hll_estimate(const struct qrh_hll *hll) {
+    unsigned q = 64 - hll->precision;
+    double m   = (double)hll->count;
+    size_t histogram[66] = { 0 };
+    double z;
+
+    for(size_t i = 0; i < hll->count; i++)
+        histogram[hll->registers[i]]++;
+
+    z = m * hll_tau(1 - (double)histogram[q + 1] / m);
+
+    for(unsigned k = q; k >= 1; k--)
+        z = 0.5 * (z + (double)histogram[k]);
+
+    z += m * hll_sigma((double)histogram[0] / m);
+
+    /* alpha_inf = 1 / (2 ln 2) */
+    return m * m / (2 * log(2)) / z;
+}
+
+unsigned qrh_hll_precision(const struct qrh_hll *hll) {
+    return hll->precision;
+}
+
+size_t qrh_hll_serialized_size(const struct qrh_hll *hll) {
+    return HLL_HEADER_SIZE + hll->count * HLL_REGISTER_BITS / 8;
+}
+
+size_t qrh_hll_serialize(const struct qrh_hll *hll, uint8_t *out) {
+    size_t n = 0;
+    uint32_t bits = 0;
+    unsigned pending = 0;
+
+    memcpy(out, HLL_MAGIC, 4);
+    out[4] = HLL_VERSION;
+    out[5] = (uint8_t)hll->precision;
+    n = 6;
+
+    for(int i = 0; i < 8; i++)
+        out[n++] = (uint8_t)(hll->seed >> (8 * i));
+
+    /* 2^precision registers of 6 bits always fill whole bytes */
+    for(size_t i = 0; i < hll->count; i++) {
+        bits |= (uint32_t)hll->registers[i] << pending;
+        pending += HLL_REGISTER_BITS;
+
+        while(pending >= 8) {
+            out[n++] = (uint8_t)bits;
+            bits >>= 8;
+            pending -= 8;
+        }
+    }
+
+    return n;
+}
+
+struct qrh_hll *qrh_hll_deserialize(const uint8_t *in, size_t len) {
+    struct qrh_hll *hll;
+    unsigned precision;
+    uint64_t seed = 0;
+    uint32_t bits = 0;
+    unsigned pending = 0;
+    size_t n = 6;
+
+    if(len < HLL_HEADER_SIZE || memcmp(in, HLL_MAGIC, 4) != 0 || in[4] != HLL_VERSION) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    precision = in[5];
+
+    if(precision < QRH_HLL_MIN_PRECISION || precision > QRH_HLL_MAX_PRECISION
+       || len != HLL_HEADER_SIZE + ((size_t)1 << precision) * HLL_REGISTER_BITS / 8) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    for(int i = 0; i < 8; i++)
+        seed |= (uint64_t)in[n++] << (8 * i);
+
+    hll = hll_alloc(precision, seed);
+
+    if(!hll) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for(size_t i = 0; i < hll->count; i++) {
+        while(pending < HLL_REGISTER_BITS) {
+            bits |= (uint32_t)in[n++] << pending;
+            pending += 8;
+        }
+
+        hll->registers[i] = (uint8_t)(bits & ((1u << HLL_REGISTER_BITS) - 1));
+        bits >>= HLL_REGISTER_BITS;
+        pending -= HLL_REGISTER_BITS;
+
+        /* no key reaches a rank above 65 - precision */
+        if(hll->registers[i] > 65 - precision) {
+            free(hll);
+            errno = EINVAL;
+            return NULL;
+        }
+    }
+
+    return hll;
+}
@@ -0,0 +1,70 @@
+#ifndef QRH_HLL_H
+#define QRH_HLL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_pool.h"
+
+/*
+ * HyperLogLog distinct counter. Each key costs one qrh_64() evaluation:
+ * the top `precision` bits pick one of 2^precision registers, and the
+ * register keeps the highest rank (leading zeros + 1) seen in the other
+ * bits. Registers are bytes in memory and 6 bits when serialized. The
+ * estimate uses Ertl's improved estimator over the register histogram,
+ * which needs no bias tables and stays accurate from small to very large
+ * counts. Sketches with the same precision and seed merge by taking the
+ * per-register maximum.
+ */
+
+#define QRH_HLL_MIN_PRECISION 4
+#define QRH_HLL_MAX_PRECISION 18
+
+struct qrh_hll_config {
+    unsigned precision;        /* 4..18; 0: 14, 16 KiB and about 0.8% standard error */
+    uint64_t seed;             /* qrh_64() seed, equal on every sketch that is merged */
+};
+
+struct qrh_hll;
+
+/* `cfg` may be NULL for defaults; NULL with errno set on failure */
+struct qrh_hll *qrh_hll_create(const struct qrh_hll_config *cfg);
+void qrh_hll_destroy(struct qrh_hll *hll);
+
+/* back to the empty set */
+void qrh_hll_clear(struct qrh_hll *hll);
+
+void qrh_hll_insert(struct qrh_hll *hll, const void *key, size_t len);
+void qrh_hll_insert_u64(struct qrh_hll *hll, uint64_t value);
+
+/* a key already hashed with qrh_64() under the sketch's seed */
+void qrh_hll_insert_hash(struct qrh_hll *hll, uint64_t hash);
+
+/* the same for many keys, hashed through qrh_64_multi() */
+void qrh_hll_insert_batch(struct qrh_hll *hll, const uint8_t *const keys[], const size_t lens[], size_t count);
+void qrh_hll_insert_u64_batch(struct qrh_hll *hll, const uint64_t *values, size_t count);
+
+/* insert_batch split across `pool` (NULL: the default pool); 0, or -1 with errno set */
+int qrh_hll_insert_parallel(struct qrh_hll *hll, struct qrh_pool *pool, const uint8_t *const keys[],
+                            const size_t lens[], size_t count);
+
+/* hll = union of hll and other; -1 with errno EINVAL when precision or seed differ */
+int qrh_hll_merge(struct qrh_hll *hll, const struct qrh_hll *other);
+
+/* estimated number of distinct keys inserted */
+double qrh_hll_estimate(const struct qrh_hll *hll);
+
+unsigned qrh_hll_precision(const struct qrh_hll *hll);
+
+/*
+ * Compact form: "QHLL", version, precision, le64(seed), then the registers
+ * packed 6 bits each, least significant bits first. `out` needs
+ * qrh_hll_serialized_size() bytes; returns the number written.
+ */
+size_t qrh_hll_serialized_size(const struct qrh_hll *hll);
+size_t qrh_hll_serialize(const struct qrh_hll *hll, uint8_t *out);
+
+/* NULL with errno EINVAL on a malformed or truncated buffer */
+struct qrh_hll *qrh_hll_deserialize(const uint8_t *in, size_t len);
+
+#endif
@@ -0,0 +1,1015 @@
+/**
+ * qrh_json.c
+ *
+ * Features:
+ *   - Resumable tokenizer: strings, numbers and literals may be split
+ *     across qrh_json_update() calls
+ *   - Plain string runs and whitespace are found 32 (AVX2) or 16 (SSE2)
+ *     bytes at a time and copied or skipped as a block
+ *   - Objects are canonicalized in place in the output buffer: members
+ *     already in key order are left alone, others are merge sorted by key
+ *     and rewritten once
+ *   - Output outside any object goes to the qrh_log in runs of
+ *     QRH_MULTI_LANES chunks, so leaves hash through qrh_256_multi()
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_multi.h"
+#include "qrh_log.h"
+#include "qrh_json.h"
+
+#define JSON_DEFAULT_LIMIT  ((size_t)64 << 20)
+#define JSON_DEFAULT_DEPTH  512
+#define JSON_FLUSH          ((size_t)QRH_LOG_CHUNK * QRH_MULTI_LANES)
+#define JSON_NUMBER_MAX     1024                 /* characters in one number token */
+#define JSON_EXPONENT_MAX   1000000000           /* |exponent| accepted */
+
+enum json_expect {
+    JSON_VALUE,
+    JSON_VALUE_OR_END,                           /* just after '[' */
+    JSON_KEY,
+    JSON_KEY_OR_END,                             /* just after '{' */
+    JSON_COLON,
+    JSON_COMMA_OR_END,
+    JSON_DONE
+};
+
+enum json_token { JSON_TOKEN_NONE, JSON_TOKEN_STRING, JSON_TOKEN_NUMBER, JSON_TOKEN_LITERAL };
+
+enum json_escape {
+    JSON_ESCAPE_NONE,
+    JSON_ESCAPE_START,                           /* after '\' */
+    JSON_ESCAPE_HEX,                             /* in the 4 digits of \u */
+    JSON_ESCAPE_LOW_SLASH,                       /* high surrogate read, expecting '\' */
+    JSON_ESCAPE_LOW_U                            /* then 'u' */
+};
+
+struct json_member {
+    size_t start;                                /* opening quote of the key in `out` */
+    size_t key_len;                              /* canonical key bytes between the quotes */
+    size_t end;                                  /* one past the value */
+};
+
+struct json_frame {
+    uint8_t object;
+    uint8_t sorted;                              /* members so far are in key order */
+    size_t start;                                /* offset of '{' in `out` */
+    size_t first;                                /* first member in `members` */
+};
+
+struct qrh_json {
+    struct qrh_json_config cfg;
+    qrh_log log;
+
+    enum json_expect expect;
+    enum json_token token;
+    int error;
+
+    /* string in progress */
+    int string_key;
+    enum json_escape escape;
+    unsigned hex_count;
+    uint32_t hex;
+    uint32_t high;                               /* pending high surrogate, 0 if none */
+
+    /* number or literal in progress */
+    char number[JSON_NUMBER_MAX];
+    size_t number_len;
+    const char *literal;
+    size_t literal_pos;
+
+    struct json_frame *frames;
+    unsigned depth;
+    unsigned objects;                            /* open objects among the frames */
+
+    uint8_t *out;                                /* canonical bytes not yet in the log */
+    size_t out_len, out_cap;
+
+    struct json_member *members, *sort_tmp;
+    size_t members_len, members_cap;
+
+    uint8_t *scratch;                            /* reordered object body */
+    size_t scratch_cap;
+};
+
+/* bytes of `p` before the first '"', '\' or control character */
+static size_t json_scan_string(const uint8_t *p, size_t n) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    const __m256i quote = _mm256_set1_epi8('"'), slash = _mm256_set1_epi8('\\');
+    const __m256i high = _mm256_set1_epi8((char)0xE0), zero = _mm256_setzero_si256();
+
+    for(; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, slash)),
+                                       _mm256_cmpeq_epi8(_mm256_and_si256(v, high), zero));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(stop);
+
+        if(mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"'), slash = _mm_set1_epi8('\\');
+    const __m128i high = _mm_set1_epi8((char)0xE0), zero = _mm_setzero_si128();
+
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)),
+                                    _mm_cmpeq_epi8(_mm_and_si128(v, high), zero));
+        unsigned mask = (unsigned)_mm_movemask_epi8(stop);
+
+        if(mask)
+            return i + (size_t)__builtin_ctz(mask);
+    }
+#endif
+
+    for(; i < n; i++)
+        if(p[i] == '"' || p[i] == '\\' || p[i] < 0x20)
+            break;
+
+    return i;
+}
+
+static inline int json_is_space(uint8_t c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/* first byte of `p` that is not JSON whitespace, or `end` */
+static const uint8_t *json_skip_space(const uint8_t *p, const uint8_t *end) {
+    /* minified input: nothing to skip */
+    if(p == end || !json_is_space(*p))
+        return p;
+
+#if defined(__AVX2__)
+    const __m256i space = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    const __m256i cr = _mm256_set1_epi8('\r'), tab = _mm256_set1_epi8('\t');
+
+    for(; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, nl)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, tab)));
+        unsigned mask = ~(unsigned)_mm256_movemask_epi8(ws);
+
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i space = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    const __m128i cr = _mm_set1_epi8('\r'), tab = _mm_set1_epi8('\t');
+
+    for(; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, nl)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, tab)));
+        unsigned mask = ~(unsigned)_mm_movemask_epi8(ws) & 0xFFFF;
+
+        if(mask)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+
+    while(p < end && json_is_space(*p))
+        p++;
+
+    return p;
+}
+
+static int json_fail(struct qrh_json *j, int error) {
+    j->error = error;
+    return -1;
+}
+
+/* hands the buffered output to the log, only legal with no object open */
+static void json_flush(struct qrh_json *j) {
+    if(!j->out_len)
+        return;
+
+    if(j->cfg.sink)
+        j->cfg.sink(j->cfg.user, j->out, j->out_len);
+
+    qrh_log_append(&j->log, j->out, j->out_len);
+    j->out_len = 0;
+}
+
+/* room for `n` more output bytes; the limit only applies inside objects */
+static int json_reserve(struct qrh_json *j, size_t n) {
+    size_t need = j->out_len + n;
+    uint8_t *grown;
+    size_t cap;
+
+    if(j->objects && need > j->cfg.buffer_limit)
+        return json_fail(j, ENOBUFS);
+
+    if(need <= j->out_cap)
+        return 0;
+
+    /* outside objects nothing refers back into the buffer */
+    if(!j->objects) {
+        json_flush(j);
+
+        if(n <= j->out_cap)
+            return 0;
+
+        need = n;
+    }
+
+    cap = j->out_cap * 2 > need ? j->out_cap * 2 : need;
+    grown = realloc(j->out, cap);
+
+    if(!grown)
+        return json_fail(j, ENOMEM);
+
+    j->out     = grown;
+    j->out_cap = cap;
+    return 0;
+}
+
+static inline int json_put(struct qrh_json *j, const void *bytes, size_t n) {
+    /* long string runs outside objects skip the buffer */
+    if(!j->objects && n >= JSON_FLUSH) {
+        json_flush(j);
+
+        if(j->cfg.sink)
+            j->cfg.sink(j->cfg.user, bytes, n);
+
+        qrh_log_append(&j->log, bytes, n);
+        return 0;
+    }
+
+    if(json_reserve(j, n) != 0)
+        return -1;
+
+    memcpy(j->out + j->out_len, bytes, n);
+    j->out_len += n;
+    return 0;
+}
+
+static inline int json_putc(struct qrh_json *j, uint8_t c) {
+    return json_put(j, &c, 1);
+}
+
+static void json_value_done(struct qrh_json *j) {
+    if(j->depth == 0) {
+        j->expect = JSON_DONE;
+        return;
+    }
+
+    j->expect = JSON_COMMA_OR_END;
+}
+
+static int json_push(struct qrh_json *j, int object) {
+    struct json_frame *f;
+
+    if(j->depth == j->cfg.max_depth)
+        return json_fail(j, ENOBUFS);
+
+    if(json_putc(j, object ? '{' : '[') != 0)
+        return -1;
+
+    f = &j->frames[j->depth++];
+    f->object = (uint8_t)object;
+    f->sorted = 1;
+    f->start  = j->out_len - 1;
+    f->first  = j->members_len;
+
+    j->objects += object;
+    j->expect   = object ? JSON_KEY_OR_END : JSON_VALUE_OR_END;
+    return 0;
+}
+
+static int json_key_cmp(const uint8_t *out, const struct json_member *a, const struct json_member *b) {
+    size_t n = a->key_len < b->key_len ? a->key_len : b->key_len;
+    int c = memcmp(out + a->start + 1, out + b->start + 1, n);
+
+    if(c)
+        return c;
+
+    return a->key_len < b->key_len ? -1 : a->key_len > b->key_len;
+}
+
+static void json_sort(const uint8_t *out, struct json_member *m, struct json_member *tmp, size_t n) {
+    size_t half = n / 2, a = 0, b = half, k = 0;
+
+    if(n < 2)
+        return;
+
+    json_sort(out, m, tmp, half);
+    json_sort(out, m + half, tmp, n - half);
+
+    while(a < half && b < n)
+        tmp[k++] = json_key_cmp(out, &m[b], &m[a]) < 0 ? m[b++] : m[a++];
+
+    while(a < half)
+        tmp[k++] = m[a++];
+
+    while(b < n)
+        tmp[k++] = m[b++];
+
+    memcpy(m, tmp, n * sizeof(*m));
+}
+
+/* puts the members of the closing object in key order, then writes '}' */
+static int json_close_object(struct qrh_json *j) {
+    struct json_frame *f = &j->frames[j->depth - 1];
+    struct json_member *m = j->members + f->first;
+    size_t n = j->members_len - f->first;
+    size_t body = f->start + 1, len = j->out_len - body, k = 0;
+
+    if(!f->sorted) {
+        if(j->scratch_cap < len) {
+            uint8_t *grown = realloc(j->scratch, len);
+
+            if(!grown)
+                return json_fail(j, ENOMEM);
+
+            j->scratch     = grown;
+            j->scratch_cap = len;
+        }
+
+        json_sort(j->out, m, j->sort_tmp, n);
+
+        for(size_t i = 0; i < n; i++) {
+            if(i && json_key_cmp(j->out, &m[i - 1], &m[i]) == 0)
+                return json_fail(j, EINVAL);
+
+            if(i)
+                j->scratch[k++] = ',';
+
+            memcpy(j->scratch + k, j->out + m[i].start, m[i].end - m[i].start);
+            k += m[i].end - m[i].start;
+        }
+
+        memcpy(j->out + body, j->scratch, len);
+    }
+
+    j->members_len = f->first;
+    j->depth--;
+    j->objects--;
+
+    if(json_putc(j, '}') != 0)
+        return -1;
+
+    json_value_done(j);
+    return 0;
+}
+
+static int json_close_array(struct qrh_json *j) {
+    j->depth--;
+
+    if(json_putc(j, ']') != 0)
+        return -1;
+
+    json_value_done(j);
+    return 0;
+}
+
+static int json_begin_key(struct qrh_json *j) {
+    struct json_member *m;
+
+    if(j->members_len == j->members_cap) {
+        size_t cap = j->members_cap ? j->members_cap * 2 : 64;
+        struct json_member *grown = realloc(j->members, cap * sizeof(*grown));
+        struct json_member *tmp;
+
+        if(!grown)
+            return json_fail(j, ENOMEM);
+
+        j->members = grown;
+        tmp = realloc(j->sort_tmp, cap * sizeof(*tmp));
+
+        if(!tmp)
+            return json_fail(j, ENOMEM);
+
+        j->sort_tmp    = tmp;
+        j->members_cap = cap;
+    }
+
+    m = &j->members[j->members_len++];
+    m->start = j->out_len;
+
+    j->token      = JSON_TOKEN_STRING;
+    j->string_key = 1;
+    j->escape     = JSON_ESCAPE_NONE;
+    return json_putc(j, '"');
+}
+
+static int json_end_key(struct qrh_json *j) {
+    struct json_frame *f = &j->frames[j->depth - 1];
+    struct json_member *m = &j->members[j->members_len - 1];
+
+    m->key_len = j->out_len - m->start - 1;
+
+    if(json_putc(j, '"') != 0)
+        return -1;
+
+    /* in-order keys need no rewrite; adjacent duplicates are caught here, the rest when sorting */
+    if(f->sorted && j->members_len - 1 > f->first) {
+        int c = json_key_cmp(j->out, m - 1, m);
+
+        if(c == 0)
+            return json_fail(j, EINVAL);
+
+        if(c > 0)
+            f->sorted = 0;
+    }
+
+    j->expect = JSON_COLON;
+    return 0;
+}
+
+/* a decoded code point in canonical string form */
+static int json_emit_code_point(struct qrh_json *j, uint32_t cp) {
+    static const char hex[] = "0123456789abcdef";
+    uint8_t buf[6];
+    size_t n = 0;
+
+    if(cp == '"' || cp == '\\') {
+        buf[n++] = '\\';
+        buf[n++] = (uint8_t)cp;
+    } else if(cp < 0x20) {
+        const char *shorts = "btn\0fr";
+
+        buf[n++] = '\\';
+
+        if(cp >= 8 && cp <= 13 && shorts[cp - 8]) {
+            buf[n++] = (uint8_t)shorts[cp - 8];
+        } else {
+            buf[n++] = 'u';
+            buf[n++] = '0';
+            buf[n++] = '0';
+            buf[n++] = (uint8_t)hex[cp >> 4];
+            buf[n++] = (uint8_t)hex[cp & 15];
+        }
+    } else if(cp < 0x80) {
+        buf[n++] = (uint8_t)cp;
+    } else if(cp < 0x800) {
+        buf[n++] = (uint8_t)(0xC0 | cp >> 6);
+        buf[n++] = (uint8_t)(0x80 | (cp & 0x3F));
+    } else if(cp < 0x10000) {
+        buf[n++] = (uint8_t)(0xE0 | cp >> 12);
+        buf[n++] = (uint8_t)(0x80 | (cp >> 6 & 0x3F));
+        buf[n++] = (uint8_t)(0x80 | (cp & 0x3F));
+    } else {
+        buf[n++] = (uint8_t)(0xF0 | cp >> 18);
+        buf[n++] = (uint8_t)(0x80 | (cp >> 12 & 0x3F));
+        buf[n++] = (uint8_t)(0x80 | (cp >> 6 & 0x3F));
+        buf[n++] = (uint8_t)(0x80 | (cp & 0x3F));
+    }
+
+    return json_put(j, buf, n);
+}
+
+static int json_hex_digit(uint8_t c) {
+    if(c >= '0' && c <= '9')
+        return c - '0';
+
+    c |= 0x20;
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/* continues the string in progress; NULL on error */
+static const uint8_t *json_string(struct qrh_json *j, const uint8_t *p, const uint8_t *end) {
+    while(p < end) {
+        uint8_t c;
+
+        if(j->escape == JSON_ESCAPE_NONE) {
+            size_t run = json_scan_string(p, (size_t)(end - p));
+
+            if(run && json_put(j, p, run) != 0)
+                return NULL;
+
+            p += run;
+
+            if(p == end)
+                break;
+
+            c = *p++;
+
+            if(c == '\\') {
+                j->escape = JSON_ESCAPE_START;
+                continue;
+            }
+
+            if(c != '"') {
+                json_fail(j, EINVAL);
+                return NULL;
+            }
+
+            j->token = JSON_TOKEN_NONE;
+
+            if(j->string_key)
+                return json_end_key(j) == 0 ? p : NULL;
+
+            if(json_putc(j, '"') != 0)
+                return NULL;
+
+            json_value_done(j);
+            return p;
+        }
+
+        c = *p++;
+
+        switch(j->escape) {
+        case JSON_ESCAPE_START: {
+            uint32_t cp;
+
+            j->escape = JSON_ESCAPE_NONE;
+
+            switch(c) {
+            case '"': case '\\': case '/':
+                cp = c;
+                break;
+            case 'b':
+                cp = '\b';
+                break;
+            case 'f':
+                cp = '\f';
+                break;
+            case 'n':
+                cp = '\n';
+                break;
+            case 'r':
+                cp = '\r';
+                break;
+            case 't':
+                cp = '\t';
+                break;
+            case 'u':
+                j->escape    = JSON_ESCAPE_HEX;
+                j->hex_count = 0;
+                j->hex       = 0;
+                continue;
+            default:
+                json_fail(j, EINVAL);
+                return NULL;
+            }
+
+            if(json_emit_code_point(j, cp) != 0)
+                return NULL;
+
+            break;
+        }
+
+        case JSON_ESCAPE_HEX: {
+            int d = json_hex_digit(c);
+
+            if(d < 0) {
+                json_fail(j, EINVAL);
+                return NULL;
+            }
+
+            j->hex = j->hex << 4 | (uint32_t)d;
+
+            if(++j->hex_count < 4)
+                break;
+
+            j->escape = JSON_ESCAPE_NONE;
+
+            if(j->high) {
+                if(j->hex < 0xDC00 || j->hex > 0xDFFF) {
+                    json_fail(j, EINVAL);
+                    return NULL;
+                }
+
+                j->hex  = 0x10000 + ((j->high - 0xD800) << 10) + (j->hex - 0xDC00);
+                j->high = 0;
+            } else if(j->hex >= 0xD800 && j->hex <= 0xDBFF) {
+                j->high   = j->hex;
+                j->escape = JSON_ESCAPE_LOW_SLASH;
+                break;
+            } else if(j->hex >= 0xDC00 && j->hex <= 0xDFFF) {
+                json_fail(j, EINVAL);
+                return NULL;
+            }
+
+            if(json_emit_code_point(j, j->hex) != 0)
+                return NULL;
+
+            break;
+        }
+
+        case JSON_ESCAPE_LOW_SLASH:
+        case JSON_ESCAPE_LOW_U:
+            /* a high surrogate must be followed by an escaped low one */
+            if(c != (j->escape == JSON_ESCAPE_LOW_SLASH ? '\\' : 'u')) {
+                json_fail(j, EINVAL);
+                return NULL;
+            }
+
+            if(j->escape == JSON_ESCAPE_LOW_SLASH) {
+                j->escape = JSON_ESCAPE_LOW_U;
+            } else {
+                j->escape    = JSON_ESCAPE_HEX;
+                j->hex_count = 0;
+                j->hex       = 0;
+            }
+
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return p;
+}
+
+static inline int json_is_number_char(uint8_t c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+static inline int json_is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+/* validates the buffered number and writes its canonical form */
+static int json_number_done(struct qrh_json *j) {
+    const char *s = j->number, *end = j->number + j->number_len;
+    char digits[JSON_NUMBER_MAX], text[JSON_NUMBER_MAX + 32];
+    size_t k = 0, n = 0;
+    int negative = 0;
+    long long exponent = 0, point;
+
+    j->token = JSON_TOKEN_NONE;
+
+    if(s < end && *s == '-') {
+        negative = 1;
+        s++;
+    }
+
+    /* integer part: 0, or no leading zero */
+    if(s == end || !json_is_digit(*s) || (*s == '0' && s + 1 < end && json_is_digit(s[1])))
+        return json_fail(j, EINVAL);
+
+    while(s < end && json_is_digit(*s))
+        digits[k++] = *s++;
+
+    if(s < end && *s == '.') {
+        if(++s == end || !json_is_digit(*s))
+            return json_fail(j, EINVAL);
+
+        while(s < end && json_is_digit(*s)) {
+            digits[k++] = *s++;
+            exponent--;
+        }
+    }
+
+    if(s < end && (*s == 'e' || *s == 'E')) {
+        int exp_negative = 0;
+        long long value = 0;
+
+        if(++s < end && (*s == '+' || *s == '-'))
+            exp_negative = *s++ == '-';
+
+        if(s == end || !json_is_digit(*s))
+            return json_fail(j, EINVAL);
+
+        for(; s < end && json_is_digit(*s); s++) {
+            value = value * 10 + (*s - '0');
+
+            if(value > JSON_EXPONENT_MAX)
+                return json_fail(j, ERANGE);
+        }
+
+        exponent += exp_negative ? -value : value;
+    }
+
+    if(s != end)
+        return json_fail(j, EINVAL);
+
+    /* significant digits only: value = 0.digits * 10^point */
+    size_t lead = 0;
+
+    while(lead < k && digits[lead] == '0')
+        lead++;
+
+    while(k > lead && digits[k - 1] == '0') {
+        k--;
+        exponent++;
+    }
+
+    memmove(digits, digits + lead, k - lead);
+    k -= lead;
+    point = (long long)k + exponent;
+
+    if(negative && k)
+        text[n++] = '-';
+
+    if(k == 0) {
+        text[n++] = '0';
+    } else if((long long)k <= point && point <= 21) {
+        memcpy(text + n, digits, k);
+        n += k;
+
+        for(long long z = (long long)k; z < point; z++)
+            text[n++] = '0';
+    } else if(0 < point && point <= 21) {
+        memcpy(text + n, digits, (size_t)point);
+        n += (size_t)point;
+        text[n++] = '.';
+        memcpy(text + n, digits + point, k - (size_t)point);
+        n += k - (size_t)point;
+    } else if(-6 < point && point <= 0) {
+        text[n++] = '0';
+        text[n++] = '.';
+
+        for(long long z = point; z < 0; z++)
+            text[n++] = '0';
+
+        memcpy(text + n, digits, k);
+        n += k;
+    } else {
+        long long e = point - 1;
+        char exp_text[24];
+        int exp_len = 0;
+
+        text[n++] = digits[0];
+
+        if(k > 1) {
+            text[n++] = '.';
+            memcpy(text + n, digits + 1, k - 1);
+            n += k - 1;
+        }
+
+        text[n++] = 'e';
+        text[n++] = e < 0 ? '-' : '+';
+
+        for(long long v = e < 0 ? -e : e; v || !exp_len; v /= 10)
+            exp_text[exp_len++] = (char)('0' + v % 10);
+
+        while(exp_len)
+            text[n++] = exp_text[--exp_len];
+    }
+
+    if(json_put(j, text, n) != 0)
+        return -1;
+
+    json_value_done(j);
+    return 0;
+}
+
+/* continues the number in progress; it ends at the first byte that cannot belong to it */
+static const uint8_t *json_number(struct qrh_json *j, const uint8_t *p, const uint8_t *end) {
+    while(p < end && json_is_number_char(*p)) {
+        if(j->number_len == JSON_NUMBER_MAX) {
+            json_fail(j, ENOBUFS);
+            return NULL;
+        }
+
+        j->number[j->number_len++] = (char)*p++;
+    }
+
+    if(p < end && json_number_done(j) != 0)
+        return NULL;
+
+    return p;
+}
+
+static const uint8_t *json_literal(struct qrh_json *j, const uint8_t *p, const uint8_t *end) {
+    while(p < end && j->literal[j->literal_pos]) {
+        if(*p++ != (uint8_t)j->literal[j->literal_pos++]) {
+            json_fail(j, EINVAL);
+            return NULL;
+        }
+    }
+
+    if(!j->literal[j->literal_pos]) {
+        j->token = JSON_TOKEN_NONE;
+
+        if(json_put(j, j->literal, j->literal_pos) != 0)
+            return NULL;
+
+        json_value_done(j);
+    }
+
+    return p;
+}
+
+/* the first byte of a value */
+static int json_begin_value(struct qrh_json *j, uint8_t c) {
+    switch(c) {
+    case '{':
+        return json_push(j, 1);
+    case '[':
+        return json_push(j, 0);
+    case '"':
+        j->token      = JSON_TOKEN_STRING;
+        j->string_key = 0;
+        j->escape     = JSON_ESCAPE_NONE;
+        return json_putc(j, '"');
+    case 't':
+        j->literal = "true";
+        break;
+    case 'f':
+        j->literal = "false";
+        break;
+    case 'n':
+        j->literal = "null";
+        break;
+    default:
+        if(c != '-' && !json_is_digit((char)c))
+            return json_fail(j, EINVAL);
+
+        j->token      = JSON_TOKEN_NUMBER;
+        j->number[0]  = (char)c;
+        j->number_len = 1;
+        return 0;
+    }
+
+    /* the first letter was consumed to pick the literal */
+    j->token       = JSON_TOKEN_LITERAL;
+    j->literal_pos = 1;
+    return 0;
+}
+
+struct qrh_json *qrh_json_create(const struct qrh_json_config *cfg) {
+    struct qrh_json *j = calloc(1, sizeof(*j));
+
+    if(!j)
+        return NULL;
+
+    if(cfg)
+        j->cfg = *cfg;
+
+    if(!j->cfg.buffer_limit)
+        j->cfg.buffer_limit = JSON_DEFAULT_LIMIT;
+
+    if(!j->cfg.max_depth)
+        j->cfg.max_depth = JSON_DEFAULT_DEPTH;
+
+    j->frames = malloc(j->cfg.max_depth * sizeof(*j->frames));
+    j->out    = malloc(JSON_FLUSH);
+
+    if(!j->frames || !j->out) {
+        qrh_json_destroy(j);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    j->out_cap = JSON_FLUSH;
+    qrh_json_reset(j);
+
+    return j;
+}
+
+void qrh_json_destroy(struct qrh_json *json) {
+    if(!json)
+        return;
+
+    free(json->frames);
+    free(json->out);
+    free(json->members);
+    free(json->sort_tmp);
+    free(json->scratch);
+    free(json);
+}
+
+void qrh_json_reset(struct qrh_json *json) {
+    qrh_log_init(&json->log);
+
+    json->expect      = JSON_VALUE;
+    json->token       = JSON_TOKEN_NONE;
+    json->error       = 0;
+    json->high        = 0;
+    json->depth       = 0;
+    json->objects     = 0;
+    json->out_len     = 0;
+    json->members_len = 0;
+}
+
+int qrh_json_update(struct qrh_json *json, const uint8_t *data, size_t len) {
+    const uint8_t *p = data, *end = data + len;
+    struct qrh_json *j = json;
+
+    while(!j->error && p < end) {
+        uint8_t c;
+
+        switch(j->token) {
+        case JSON_TOKEN_STRING:
+            p = json_string(j, p, end);
+            continue;
+        case JSON_TOKEN_NUMBER:
+            p = json_number(j, p, end);
+            continue;
+        case JSON_TOKEN_LITERAL:
+            p = json_literal(j, p, end);
+            continue;
+        default:
+            break;
+        }
+
+        p = json_skip_space(p, end);
+
+        if(p == end)
+            break;
+
+        c = *p++;
+
+        switch(j->expect) {
+        case JSON_VALUE_OR_END:
+            if(c == ']') {
+                json_close_array(j);
+                break;
+            }
+            /* fall through */
+        case JSON_VALUE:
+            json_begin_value(j, c);
+            break;
+
+        case JSON_KEY_OR_END:
+            if(c == '}') {
+                json_close_object(j);
+                break;
+            }
+            /* fall through */
+        case JSON_KEY:
+            if(c != '"')
+                json_fail(j, EINVAL);
+            else
+                json_begin_key(j);
+            break;
+
+        case JSON_COLON:
+            if(c != ':')
+                json_fail(j, EINVAL);
+            else if(json_putc(j, ':') == 0)
+                j->expect = JSON_VALUE;
+            break;
+
+        case JSON_COMMA_OR_END: {
+            struct json_frame *f = &j->frames[j->depth - 1];
+
+            if(f->object && (c == ',' || c == '}'))
+                j->members[j->members_len - 1].end = j->out_len;
+
+            if(c == ',') {
+                if(json_putc(j, ',') == 0)
+                    j->expect = f->object ? JSON_KEY : JSON_VALUE;
+            } else if(c == (f->object ? '}' : ']')) {
+                if(f->object)
+                    json_close_object(j);
+                else
+                    json_close_array(j);
+            } else {
+                json_fail(j, EINVAL);
+            }
+
+            break;
+        }
+
+        default:
+            /* anything but whitespace after the value */
+            json_fail(j, EINVAL);
+            break;
+        }
+    }
+
+    if(j->error) {
+        errno = j->error;
+        return -1;
+    }
+
+    return 0;
+}
+
+int qrh_json_final(struct qrh_json *json, uint8_t out[32]) {
+    /* a number at the very end has nothing after it to end it */
+    if(!json->error && json->token == JSON_TOKEN_NUMBER)
+        json_number_done(json);
+
+    if(!json->error && (json->token != JSON_TOKEN_NONE || json->expect != JSON_DONE))
+        json->error = EINVAL;
+
+    if(json->error) {
+        errno = json->error;
+        return -1;
+    }
+
+    json_flush(json);
+    qrh_log_digest(&json->log, out);
+    return 0;
+}
+
+int qrh_json_digest(const uint8_t *doc, size_t len, uint8_t out[32]) {
+    struct qrh_json *j = qrh_json_create(NULL);
+    int rc;
+
+    if(!j)
+        return -1;
+
+    rc = qrh_json_update(j, doc, len);
+
+    if(rc == 0)
+        rc = qrh_json_final(j, out);
+
+    qrh_json_destroy(j);
+    return rc;
+}
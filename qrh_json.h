@@ -0,0 +1,59 @@
+#ifndef QRH_JSON_H
+#define QRH_JSON_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Content digest of JSON documents. The input is tokenized and
+ * canonicalized as it streams in, without building a tree:
+ *   - no whitespace outside strings
+ *   - object members ordered by the bytes of their canonical key;
+ *     duplicate keys are an error
+ *   - strings with escapes decoded and only '"', '\' and control
+ *     characters re-escaped (\b \t \n \f \r, else \u00xx)
+ *   - numbers as their exact decimal value in ECMAScript Number-to-String
+ *     layout: 100, 1.5, 0.001, 1e+21, 1.5e-7; -0 is 0
+ * Bytes outside ASCII are passed through as they are, without UTF-8
+ * validation.
+ *
+ * An object's members can only be ordered once it closes, so open objects
+ * are buffered; everything else streams straight into the hash. QRH-256
+ * needs the total length up front, which a canonical form only has at the
+ * end, so the canonical bytes go into a qrh_log (qrh_log.h) and the digest
+ * is that log's digest.
+ */
+
+struct qrh_json_config {
+    size_t buffer_limit;       /* canonical bytes held for open objects, default 64 MiB */
+    unsigned max_depth;        /* nesting of objects and arrays, default 512 */
+
+    /* when set, also receives the canonical text in order */
+    void (*sink)(void *user, const uint8_t *bytes, size_t len);
+    void *user;
+};
+
+struct qrh_json;
+
+/* `cfg` may be NULL for defaults; NULL with errno set on failure */
+struct qrh_json *qrh_json_create(const struct qrh_json_config *cfg);
+void qrh_json_destroy(struct qrh_json *json);
+
+/* ready for the next document */
+void qrh_json_reset(struct qrh_json *json);
+
+/*
+ * Feeds the next `len` bytes of the document, split anywhere. 0, or -1
+ * with errno EINVAL (not JSON, or a duplicate key), ENOBUFS (buffer_limit
+ * or max_depth exceeded), ERANGE (exponent too large) or ENOMEM. An
+ * error is sticky until qrh_json_reset().
+ */
+int qrh_json_update(struct qrh_json *json, const uint8_t *data, size_t len);
+
+/* digest once exactly one complete value was fed; -1 with errno EINVAL otherwise */
+int qrh_json_final(struct qrh_json *json, uint8_t out[32]);
+
+/* whole document in one call */
+int qrh_json_digest(const uint8_t *doc, size_t len, uint8_t out[32]);
+
+#endif
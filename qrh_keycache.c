@@ -0,0 +1,296 @@
+/**
+ * qrh_keycache.c
+ *
+ * Features:
+ *   - Set-associative cache of HMAC key pads, one writer lock per set
+ *   - Lookups without locks: entries are copied under a per-entry sequence
+ *     counter, and entries are never freed while the cache lives
+ *   - CLOCK eviction within a set, so a hit only sets a reference bit
+ *   - Hit and miss counts go to per-thread shards on their own cache lines,
+ *     so concurrent readers of one set never write a line they share
+ *   - Fixed memory, allocated at creation; evicted and removed pads are
+ *     overwritten with zeros
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "qrh_256.h"
+#include "qrh_keycache.h"
+
+#define KEYCACHE_WORDS    (sizeof(qrh_hmac_key) / sizeof(uint64_t))
+#define KEYCACHE_CAPACITY 65536
+#define KEYCACHE_SHARDS   64         /* counter shards, threads beyond this share them */
+#define KEYCACHE_LINE     64
+
+/* every field is read with atomics, so lookups can race with writers */
+struct keycache_entry {
+    uint32_t seq;              /* odd while a writer is changing the entry */
+    uint32_t used;             /* CLOCK reference bit, set on a hit */
+    uint32_t live;
+    uint64_t id;
+    uint64_t pads[KEYCACHE_WORDS];
+};
+
+struct keycache_set {
+    pthread_mutex_t lock;      /* writers only */
+    unsigned hand;             /* next CLOCK victim */
+    uint64_t evictions;        /* counted under the lock */
+    struct keycache_entry ways[QRH_KEYCACHE_WAYS];
+};
+
+/* one per thread slot; hits never write anything near a set */
+struct keycache_counters {
+    uint64_t hits;
+    uint64_t misses;
+} __attribute__((aligned(KEYCACHE_LINE)));
+
+struct qrh_keycache {
+    size_t nsets;              /* power of two */
+    uint64_t seed;
+    struct keycache_set *sets;
+    struct keycache_counters *counters;     /* KEYCACHE_SHARDS */
+};
+
+/* 1-based slot handed to each thread on its first lookup, 0 until then */
+static unsigned keycache_next_slot;
+static __thread unsigned keycache_slot;
+
+static struct keycache_counters *keycache_counters_of(struct qrh_keycache *cache) {
+    if(!keycache_slot)
+        keycache_slot = __atomic_add_fetch(&keycache_next_slot, 1, __ATOMIC_RELAXED);
+
+    return &cache->counters[(keycache_slot - 1) % KEYCACHE_SHARDS];
+}
+
+static struct keycache_set *keycache_set_of(struct qrh_keycache *cache, uint64_t id) {
+    return &cache->sets[qrh_64_u64(id, cache->seed) & (cache->nsets - 1)];
+}
+
+/* copies the entry's pads if it holds `id`; 1 on success */
+static int keycache_read(struct keycache_entry *e, uint64_t id, uint64_t pads[KEYCACHE_WORDS]) {
+    for(;;) {
+        uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+        int match;
+
+        if(seq & 1)
+            continue;
+
+        match = __atomic_load_n(&e->live, __ATOMIC_RELAXED) && __atomic_load_n(&e->id, __ATOMIC_RELAXED) == id;
+
+        if(match)
+            for(size_t i = 0; i < KEYCACHE_WORDS; i++)
+                pads[i] = __atomic_load_n(&e->pads[i], __ATOMIC_RELAXED);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if(__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == seq)
+            return match;
+    }
+}
+
+/* rewrites an entry under its sequence counter; the set lock is held */
+static void keycache_write(struct keycache_entry *e, int live, uint64_t id, const uint64_t pads[KEYCACHE_WORDS]) {
+    uint32_t seq = e->seq;
+
+    __atomic_store_n(&e->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&e->live, (uint32_t)live, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->id, id, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->used, 0, __ATOMIC_RELAXED);
+
+    /* atomic stores cannot be elided, so a dead entry's pads really are zeroed */
+    for(size_t i = 0; i < KEYCACHE_WORDS; i++)
+        __atomic_store_n(&e->pads[i], pads ? pads[i] : 0, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/* the entry holding `id` under the set lock, or NULL */
+static struct keycache_entry *keycache_find_locked(struct keycache_set *set, uint64_t id) {
+    for(int w = 0; w < QRH_KEYCACHE_WAYS; w++)
+        if(set->ways[w].live && set->ways[w].id == id)
+            return &set->ways[w];
+
+    return NULL;
+}
+
+/* a free entry, or the CLOCK victim */
+static struct keycache_entry *keycache_victim_locked(struct keycache_set *set) {
+    for(int w = 0; w < QRH_KEYCACHE_WAYS; w++)
+        if(!set->ways[w].live)
+            return &set->ways[w];
+
+    for(;;) {
+        struct keycache_entry *e = &set->ways[set->hand];
+
+        set->hand = (set->hand + 1) % QRH_KEYCACHE_WAYS;
+
+        if(!__atomic_load_n(&e->used, __ATOMIC_RELAXED)) {
+            __atomic_add_fetch(&set->evictions, 1, __ATOMIC_RELAXED);
+            return e;
+        }
+
+        __atomic_store_n(&e->used, 0, __ATOMIC_RELAXED);
+    }
+}
+
+struct qrh_keycache *qrh_keycache_create(const struct qrh_keycache_config *cfg) {
+    struct qrh_keycache *cache = calloc(1, sizeof(*cache));
+    size_t capacity = cfg && cfg->capacity ? cfg->capacity : KEYCACHE_CAPACITY;
+
+    if(!cache)
+        return NULL;
+
+    cache->seed  = cfg ? cfg->seed : 0;
+    cache->nsets = 1;
+
+    while(cache->nsets * QRH_KEYCACHE_WAYS < capacity)
+        cache->nsets <<= 1;
+
+    cache->sets = calloc(cache->nsets, sizeof(*cache->sets));
+
+    if(!cache->sets || posix_memalign((void **)&cache->counters, KEYCACHE_LINE,
+                                      KEYCACHE_SHARDS * sizeof(*cache->counters)) != 0) {
+        free(cache->sets);
+        free(cache);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    memset(cache->counters, 0, KEYCACHE_SHARDS * sizeof(*cache->counters));
+
+    for(size_t s = 0; s < cache->nsets; s++)
+        pthread_mutex_init(&cache->sets[s].lock, NULL);
+
+    return cache;
+}
+
+void qrh_keycache_destroy(struct qrh_keycache *cache) {
+    if(!cache)
+        return;
+
+    for(size_t s = 0; s < cache->nsets; s++) {
+        struct keycache_set *set = &cache->sets[s];
+
+        for(int w = 0; w < QRH_KEYCACHE_WAYS; w++)
+            keycache_write(&set->ways[w], 0, 0, NULL);
+
+        pthread_mutex_destroy(&set->lock);
+    }
+
+    free(cache->sets);
+    free(cache->counters);
+    free(cache);
+}
+
+int qrh_keycache_put(struct qrh_keycache *cache, uint64_t id, const uint8_t *key, size_t key_len) {
+    struct keycache_set *set = keycache_set_of(cache, id);
+    struct keycache_entry *e;
+    uint64_t pads[KEYCACHE_WORDS];
+    qrh_hmac_key derived;
+
+    /* keys longer than a block are hashed here, outside the lock */
+    qrh_hmac_key_init(&derived, key, key_len);
+    memcpy(pads, &derived, sizeof(pads));
+
+    pthread_mutex_lock(&set->lock);
+
+    e = keycache_find_locked(set, id);
+
+    if(!e)
+        e = keycache_victim_locked(set);
+
+    keycache_write(e, 1, id, pads);
+
+    pthread_mutex_unlock(&set->lock);
+
+    qrh_wipe(&derived, sizeof(derived));
+    qrh_wipe(pads, sizeof(pads));
+
+    return 0;
+}
+
+int qrh_keycache_get(struct qrh_keycache *cache, uint64_t id, qrh_hmac_key *out) {
+    struct keycache_set *set = keycache_set_of(cache, id);
+    uint64_t pads[KEYCACHE_WORDS];
+
+    for(int w = 0; w < QRH_KEYCACHE_WAYS; w++) {
+        struct keycache_entry *e = &set->ways[w];
+
+        if(!keycache_read(e, id, pads))
+            continue;
+
+        /* only the first hit after a CLOCK sweep writes the shared line */
+        if(!__atomic_load_n(&e->used, __ATOMIC_RELAXED))
+            __atomic_store_n(&e->used, 1, __ATOMIC_RELAXED);
+
+        __atomic_add_fetch(&keycache_counters_of(cache)->hits, 1, __ATOMIC_RELAXED);
+
+        memcpy(out, pads, sizeof(*out));
+        qrh_wipe(pads, sizeof(pads));
+
+        return 0;
+    }
+
+    __atomic_add_fetch(&keycache_counters_of(cache)->misses, 1, __ATOMIC_RELAXED);
+
+    errno = ENOENT;
+    return -1;
+}
+
+int qrh_keycache_hmac(struct qrh_keycache *cache, uint64_t id, const uint8_t *bytes, size_t bytes_len,
+                      uint8_t out[32]) {
+    qrh_hmac_key key;
+
+    if(qrh_keycache_get(cache, id, &key) < 0)
+        return -1;
+
+    qrh_256_hmac_with_key(&key, bytes, bytes_len, out);
+    qrh_wipe(&key, sizeof(key));
+
+    return 0;
+}
+
+int qrh_keycache_remove(struct qrh_keycache *cache, uint64_t id) {
+    struct keycache_set *set = keycache_set_of(cache, id);
+    struct keycache_entry *e;
+
+    pthread_mutex_lock(&set->lock);
+
+    e = keycache_find_locked(set, id);
+
+    if(e)
+        keycache_write(e, 0, 0, NULL);
+
+    pthread_mutex_unlock(&set->lock);
+
+    if(!e) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    return 0;
+}
+
+void qrh_keycache_stats(struct qrh_keycache *cache, struct qrh_keycache_stats *out) {
+    memset(out, 0, sizeof(*out));
+    out->capacity = cache->nsets * QRH_KEYCACHE_WAYS;
+
+    for(size_t i = 0; i < KEYCACHE_SHARDS; i++) {
+        out->hits   += __atomic_load_n(&cache->counters[i].hits, __ATOMIC_RELAXED);
+        out->misses += __atomic_load_n(&cache->counters[i].misses, __ATOMIC_RELAXED);
+    }
+
+    for(size_t s = 0; s < cache->nsets; s++) {
+        struct keycache_set *set = &cache->sets[s];
+
+        out->evictions += __atomic_load_n(&set->evictions, __ATOMIC_RELAXED);
+
+        for(int w = 0; w < QRH_KEYCACHE_WAYS; w++)
+            out->entries += __atomic_load_n(&set->ways[w].live, __ATOMIC_RELAXED) != 0;
+    }
+}
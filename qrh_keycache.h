@@ -0,0 +1,57 @@
+#ifndef QRH_KEYCACHE_H
+#define QRH_KEYCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+
+/*
+ * Cache of derived HMAC key pads by key ID, for servers holding many keys.
+ * Sharded into small sets: an ID can only live in one set of
+ * QRH_KEYCACHE_WAYS entries, and each set has its own writer lock. Lookups
+ * take no lock. They copy the entry under a sequence counter and retry if
+ * a writer changed it. Eviction is CLOCK (second chance) within the set, an
+ * LRU approximation that lets a hit mark the entry with a single store.
+ * Memory is allocated once at creation. Evicted and removed pads are zeroed.
+ */
+
+#define QRH_KEYCACHE_WAYS 8
+
+struct qrh_keycache_config {
+    size_t capacity;           /* keys held at most, rounded up to a power of two; default 65536 */
+    uint64_t seed;             /* spreads IDs over the sets */
+};
+
+struct qrh_keycache_stats {
+    size_t capacity;
+    size_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+struct qrh_keycache;
+
+/* `cfg` may be NULL for defaults; NULL with errno set on failure */
+struct qrh_keycache *qrh_keycache_create(const struct qrh_keycache_config *cfg);
+
+/* zeroes every cached key, then frees the cache */
+void qrh_keycache_destroy(struct qrh_keycache *cache);
+
+/* derives and caches the pads for `id`, replacing any previous key; 0 always */
+int qrh_keycache_put(struct qrh_keycache *cache, uint64_t id, const uint8_t *key, size_t key_len);
+
+/* copies the pads for `id` into `out`; -1 with errno ENOENT on a miss */
+int qrh_keycache_get(struct qrh_keycache *cache, uint64_t id, qrh_hmac_key *out);
+
+/* HMAC-QRH-256 under the cached key; -1 with errno ENOENT on a miss */
+int qrh_keycache_hmac(struct qrh_keycache *cache, uint64_t id, const uint8_t *bytes, size_t bytes_len,
+                      uint8_t out[32]);
+
+/* drops and zeroes the key for `id`; -1 with errno ENOENT if it was not cached */
+int qrh_keycache_remove(struct qrh_keycache *cache, uint64_t id);
+
+void qrh_keycache_stats(struct qrh_keycache *cache, struct qrh_keycache_stats *out);
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * qrh_lines.c
+ *
+ * Features:
+ *   - Per-record QRH-256 digests for log and NDJSON data
+ *   - Newlines located 16/32 bytes at a time (SSE2 / AVX2 compare + movemask)
+ *   - Records of a batch go through the multi-buffer scheduler together
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_multi.h"
+#include "qrh_lines.h"
+
+/* fills `ends` with offsets of up to `max` newlines at or after `pos`, returns how many */
+static size_t lines_find_newlines(const uint8_t *data, size_t pos, size_t len, size_t *ends, size_t max) {
+    size_t found = 0;
+
+#if defined(__AVX2__)
+    const __m256i nl = _mm256_set1_epi8('\n');
+
+    while(pos + 32 <= len && found + 32 <= max) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(data + pos));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl));
+
+        while(mask) {
+            ends[found++] = pos + (size_t)__builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+
+        pos += 32;
+    }
+#elif defined(__SSE2__)
+    const __m128i nl = _mm_set1_epi8('\n');
+
+    while(pos + 16 <= len && found + 16 <= max) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(data + pos));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+
+        while(mask) {
+            ends[found++] = pos + (size_t)__builtin_ctz(mask);
+            mask &= mask - 1;
+        }
+
+        pos += 16;
+    }
+#endif
+
+    /* tail, or the whole input without SIMD */
+    while(pos < len && found < max) {
+        const uint8_t *hit = memchr(data + pos, '\n', len - pos);
+
+        if(!hit)
+            break;
+
+        ends[found++] = (size_t)(hit - data);
+        pos = ends[found - 1] + 1;
+    }
+
+    return found;
+}
+
+size_t qrh_256_lines(const uint8_t *data, size_t len, qrh_lines_fn fn, void *user) {
+    const uint8_t *inputs[QRH_LINES_BATCH];
+    size_t lens[QRH_LINES_BATCH];
+    size_t ends[QRH_LINES_BATCH];
+    uint8_t digests[QRH_LINES_BATCH * 32];
+    size_t record = 0;
+    size_t start  = 0;
+
+    while(start < len) {
+        size_t scan_from = start;
+        size_t count     = 0;
+
+        while(count < QRH_LINES_BATCH) {
+            size_t found = lines_find_newlines(data, scan_from, len, ends + count, QRH_LINES_BATCH - count);
+
+            if(found == 0)
+                break;
+
+            count    += found;
+            scan_from = ends[count - 1] + 1;
+
+            if(scan_from >= len)
+                break;
+        }
+
+        size_t batch = 0;
+
+        for(size_t i = 0; i < count; i++) {
+            inputs[batch] = data + start;
+            lens[batch]   = ends[i] - start;
+            start         = ends[i] + 1;
+            batch++;
+        }
+
+        if(count == 0) {
+            /* no newline left: the unterminated tail is the last record */
+            inputs[batch] = data + start;
+            lens[batch]   = len - start;
+            start         = len;
+            batch++;
+        }
+
+        qrh_256_multi(inputs, lens, batch, digests);
+
+        if(fn && fn(digests, batch, record, user) != 0)
+            return record + batch;
+
+        record += batch;
+    }
+
+    return record;
+}
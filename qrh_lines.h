@@ -0,0 +1,23 @@
+#ifndef QRH_LINES_H
+#define QRH_LINES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* records handed to the callback per batch */
+#define QRH_LINES_BATCH 1024
+
+/*
+ * Receives digests first_record .. first_record + count - 1, 32 bytes each,
+ * in input order. Return non-zero to stop early.
+ */
+typedef int (*qrh_lines_fn)(const uint8_t *digests, size_t count, size_t first_record, void *user);
+
+/*
+ * Hashes every '\n'-terminated record of `data` (newline excluded) with
+ * qrh_256(). A trailing record without a newline is hashed as well.
+ * Returns the number of records hashed.
+ */
+size_t qrh_256_lines(const uint8_t *data, size_t len, qrh_lines_fn fn, void *user);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * qrh_log.c
+ *
+ * Features:
+ *   - Merkle mountain range over fixed chunks, so a growing log never has
+ *     to be rehashed from the start
+ *   - Bulk appends hash whole chunks in place, QRH_MULTI_LANES at a time
+ *     through qrh_256_multi()
+ *   - Partial chunks are buffered in the state and only hashed for a digest
+ */
+
+#include <string.h>
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_log.h"
+
+#define LOG_HASH_SIZE 32
+#define LOG_NODE      0x01
+#define LOG_ROOT      0x02
+
+/* adds a complete chunk's leaf, merging equal-height peaks like a binary carry */
+static void log_push_leaf(qrh_log *log, const uint8_t leaf[LOG_HASH_SIZE]) {
+    uint8_t node[1 + 2 * LOG_HASH_SIZE];
+    uint8_t top[LOG_HASH_SIZE];
+
+    memcpy(top, leaf, LOG_HASH_SIZE);
+
+    for(uint64_t carry = log->chunks; carry & 1; carry >>= 1) {
+        node[0] = LOG_NODE;
+        memcpy(node + 1, log->peaks[--log->npeaks], LOG_HASH_SIZE);
+        memcpy(node + 1 + LOG_HASH_SIZE, top, LOG_HASH_SIZE);
+        qrh_256(node, sizeof(node), top);
+    }
+
+    memcpy(log->peaks[log->npeaks++], top, LOG_HASH_SIZE);
+    log->chunks++;
+}
+
+void qrh_log_init(qrh_log *log) {
+    log->length   = 0;
+    log->chunks   = 0;
+    log->npeaks   = 0;
+    log->tail_len = 0;
+}
+
+void qrh_log_append(qrh_log *log, const uint8_t *data, size_t len) {
+    log->length += len;
+
+    /* top up a partial chunk first */
+    if(log->tail_len) {
+        size_t take = QRH_LOG_CHUNK - log->tail_len < len ? QRH_LOG_CHUNK - log->tail_len : len;
+        uint8_t leaf[LOG_HASH_SIZE];
+
+        memcpy(log->tail + log->tail_len, data, take);
+        log->tail_len += take;
+        data += take;
+        len  -= take;
+
+        if(log->tail_len < QRH_LOG_CHUNK)
+            return;
+
+        qrh_256(log->tail, QRH_LOG_CHUNK, leaf);
+        log_push_leaf(log, leaf);
+        log->tail_len = 0;
+    }
+
+    /* whole chunks straight from the caller's buffer, one SIMD lane each */
+    while(len >= QRH_LOG_CHUNK) {
+        const uint8_t *inputs[QRH_MULTI_LANES];
+        size_t lens[QRH_MULTI_LANES];
+        uint8_t leaves[QRH_MULTI_LANES * LOG_HASH_SIZE];
+        size_t n = 0;
+
+        for(; n < QRH_MULTI_LANES && len >= QRH_LOG_CHUNK; n++) {
+            inputs[n] = data;
+            lens[n]   = QRH_LOG_CHUNK;
+            data += QRH_LOG_CHUNK;
+            len  -= QRH_LOG_CHUNK;
+        }
+
+        qrh_256_multi(inputs, lens, n, leaves);
+
+        for(size_t i = 0; i < n; i++)
+            log_push_leaf(log, leaves + i * LOG_HASH_SIZE);
+    }
+
+    memcpy(log->tail, data, len);
+    log->tail_len = len;
+}
+
+void qrh_log_digest(const qrh_log *log, uint8_t out[32]) {
+    uint8_t root[1 + 8 + (QRH_LOG_PEAKS + 1) * LOG_HASH_SIZE];
+    size_t n = 0;
+
+    root[n++] = LOG_ROOT;
+
+    for(int i = 0; i < 8; i++)
+        root[n++] = (uint8_t)(log->length >> (8 * i));
+
+    memcpy(root + n, log->peaks, log->npeaks * LOG_HASH_SIZE);
+    n += log->npeaks * LOG_HASH_SIZE;
+
+    if(log->tail_len) {
+        qrh_256(log->tail, log->tail_len, root + n);
+        n += LOG_HASH_SIZE;
+    }
+
+    qrh_256(root, n, out);
+}
@@ -0,0 +1,41 @@
+#ifndef QRH_LOG_H
+#define QRH_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Append-only log digest. qrh_256() mixes the total length into every block,
+ * so it cannot be extended. This instead keeps a Merkle mountain range over
+ * QRH_LOG_CHUNK-byte chunks:
+ *
+ *   leaf   = qrh_256(chunk)
+ *   node   = qrh_256(0x01 || left || right)
+ *   digest = qrh_256(0x02 || le64(length) || peaks, highest first || [qrh_256(tail)])
+ *
+ * where the tail is the partial last chunk, present when length is not a
+ * multiple of QRH_LOG_CHUNK. An append costs the new bytes plus one node per
+ * carried tree level; a digest costs the tail and the O(log n) peaks. The
+ * result is not qrh_256() of the log.
+ */
+
+#define QRH_LOG_CHUNK 4096
+#define QRH_LOG_PEAKS 64   /* one per bit of the chunk count */
+
+/* plain data: may be copied or stored to resume a log later */
+typedef struct qrh_log {
+    uint64_t length;                    /* bytes appended */
+    uint64_t chunks;                    /* complete chunks, peaks[i] covers one set bit each, highest first */
+    unsigned npeaks;
+    uint8_t peaks[QRH_LOG_PEAKS][32];
+    size_t tail_len;
+    uint8_t tail[QRH_LOG_CHUNK];
+} qrh_log;
+
+void qrh_log_init(qrh_log *log);
+void qrh_log_append(qrh_log *log, const uint8_t *data, size_t len);
+
+/* digest of everything appended so far; the log can keep growing */
+void qrh_log_digest(const qrh_log *log, uint8_t out[32]);
+
+#endif
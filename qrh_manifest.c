@@ -0,0 +1,388 @@
+/**
+ * qrh_manifest.c
+ *
+ * Features:
+ *   - Compact binary manifest: sorted QRH-256 digests plus a path string table
+ *   - Manifests are mmap'd, lookups by digest or path are binary searches
+ *   - Diff is a merge-join of the two path indexes, no parsing involved
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "qrh_manifest.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "qrh_manifest maps the little-endian on-disk layout directly"
+#endif
+
+#define MANIFEST_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+_Static_assert(sizeof(struct qrh_manifest_header) == 64, "manifest header layout");
+_Static_assert(sizeof(struct qrh_manifest_entry) == 64, "manifest entry layout");
+
+static int manifest_compare_paths(const char *a, size_t a_len, const char *b, size_t b_len) {
+    int cmp = memcmp(a, b, a_len < b_len ? a_len : b_len);
+
+    if(cmp != 0)
+        return cmp;
+
+    return (a_len > b_len) - (a_len < b_len);
+}
+
+/* builder */
+void qrh_manifest_builder_init(struct qrh_manifest_builder *builder) {
+    memset(builder, 0, sizeof(*builder));
+}
+
+void qrh_manifest_builder_free(struct qrh_manifest_builder *builder) {
+    free(builder->entries);
+    free(builder->strings);
+    memset(builder, 0, sizeof(*builder));
+}
+
+int qrh_manifest_builder_add(struct qrh_manifest_builder *builder, const char *path, const uint8_t digest[32], uint64_t size, uint64_t location) {
+    size_t path_len = strlen(path);
+
+    if(path_len > UINT32_MAX || builder->count >= UINT32_MAX) {
+        errno = EOVERFLOW;
+        return -1;
+    }
+
+    if(builder->count == builder->capacity) {
+        size_t capacity = builder->capacity ? builder->capacity * 2 : 1024;
+        struct qrh_manifest_entry *entries = realloc(builder->entries, capacity * sizeof(*entries));
+
+        if(!entries)
+            return -1;
+
+        builder->entries  = entries;
+        builder->capacity = capacity;
+    }
+
+    if(builder->strings_size + path_len + 1 > builder->strings_capacity) {
+        size_t capacity = builder->strings_capacity ? builder->strings_capacity : 64 * 1024;
+
+        while(builder->strings_size + path_len + 1 > capacity)
+            capacity *= 2;
+
+        char *strings = realloc(builder->strings, capacity);
+
+        if(!strings)
+            return -1;
+
+        builder->strings          = strings;
+        builder->strings_capacity = capacity;
+    }
+
+    struct qrh_manifest_entry *entry = &builder->entries[builder->count++];
+
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->digest, digest, sizeof(entry->digest));
+    entry->path_offset = builder->strings_size;
+    entry->path_len    = (uint32_t)path_len;
+    entry->size        = size;
+    entry->location    = location;
+
+    memcpy(builder->strings + builder->strings_size, path, path_len + 1);
+    builder->strings_size += path_len + 1;
+
+    return 0;
+}
+
+static int manifest_compare_entries(const void *pa, const void *pb, void *strings) {
+    const struct qrh_manifest_entry *a = pa;
+    const struct qrh_manifest_entry *b = pb;
+    int cmp = memcmp(a->digest, b->digest, sizeof(a->digest));
+
+    if(cmp != 0)
+        return cmp;
+
+    return manifest_compare_paths((const char *)strings + a->path_offset, a->path_len,
+                                  (const char *)strings + b->path_offset, b->path_len);
+}
+
+static int manifest_compare_index(const void *pa, const void *pb, void *entries) {
+    const struct qrh_manifest_builder *builder = entries;
+    const struct qrh_manifest_entry *a = &builder->entries[*(const uint32_t *)pa];
+    const struct qrh_manifest_entry *b = &builder->entries[*(const uint32_t *)pb];
+
+    return manifest_compare_paths(builder->strings + a->path_offset, a->path_len,
+                                  builder->strings + b->path_offset, b->path_len);
+}
+
+static int manifest_write_all(FILE *out, const void *data, size_t len) {
+    static const uint8_t zeros[8] = {0};
+    size_t padding = MANIFEST_ALIGN(len) - len;
+
+    if(len && fwrite(data, 1, len, out) != len)
+        return -1;
+
+    if(padding && fwrite(zeros, 1, padding, out) != padding)
+        return -1;
+
+    return 0;
+}
+
+int qrh_manifest_builder_write(struct qrh_manifest_builder *builder, const char *out_path) {
+    uint32_t *index = malloc((builder->count ? builder->count : 1) * sizeof(*index));
+
+    if(!index)
+        return -1;
+
+    qsort_r(builder->entries, builder->count, sizeof(*builder->entries), manifest_compare_entries, builder->strings);
+
+    for(size_t i = 0; i < builder->count; i++)
+        index[i] = (uint32_t)i;
+
+    qsort_r(index, builder->count, sizeof(*index), manifest_compare_index, builder);
+
+    /* one entry per path, or the path index could not be searched or merge-joined */
+    for(size_t i = 1; i < builder->count; i++) {
+        if(manifest_compare_index(&index[i - 1], &index[i], builder) == 0) {
+            builder->duplicate = builder->strings + builder->entries[index[i]].path_offset;
+            free(index);
+            errno = EEXIST;
+            return -1;
+        }
+    }
+
+    struct qrh_manifest_header header = {
+        .magic       = QRH_MANIFEST_MAGIC,
+        .version     = QRH_MANIFEST_VERSION,
+        .header_size = sizeof(header),
+        .count       = builder->count,
+    };
+
+    header.entries_offset = sizeof(header);
+    header.index_offset   = header.entries_offset + builder->count * sizeof(*builder->entries);
+    header.strings_offset = header.index_offset + MANIFEST_ALIGN(builder->count * sizeof(*index));
+    header.strings_size   = builder->strings_size;
+
+    /* written beside the target and renamed, so an interrupted write leaves the old manifest or none */
+    char *tmp_path = NULL;
+    FILE *out      = NULL;
+    int fd         = -1;
+    int ret        = -1;
+
+    if(asprintf(&tmp_path, "%s.tmp.%ld", out_path, (long)getpid()) < 0) {
+        free(index);
+        return -1;
+    }
+
+    if((fd = open(tmp_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666)) >= 0 && !(out = fdopen(fd, "wb")))
+        close(fd);
+
+    if(out &&
+       manifest_write_all(out, &header, sizeof(header)) == 0 &&
+       manifest_write_all(out, builder->entries, builder->count * sizeof(*builder->entries)) == 0 &&
+       manifest_write_all(out, index, builder->count * sizeof(*index)) == 0 &&
+       manifest_write_all(out, builder->strings, builder->strings_size) == 0 &&
+       fflush(out) == 0 && fsync(fileno(out)) == 0)
+        ret = 0;
+
+    if(out && fclose(out) != 0)
+        ret = -1;
+
+    if(ret == 0 && rename(tmp_path, out_path) != 0)
+        ret = -1;
+
+    if(ret != 0 && fd >= 0) {
+        int saved = errno;
+
+        unlink(tmp_path);
+        errno = saved;
+    }
+
+    free(tmp_path);
+    free(index);
+    return ret;
+}
+
+/* reader */
+int qrh_manifest_open(struct qrh_manifest *manifest, const char *path) {
+    struct stat st;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    memset(manifest, 0, sizeof(*manifest));
+
+    if(fd < 0)
+        return -1;
+
+    if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct qrh_manifest_header)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if(map == MAP_FAILED)
+        return -1;
+
+    const struct qrh_manifest_header *header = map;
+    uint64_t size = (uint64_t)st.st_size;
+
+    /* every section must lie inside the file and the string table must be terminated */
+    int valid = memcmp(header->magic, QRH_MANIFEST_MAGIC, sizeof(header->magic)) == 0 &&
+                header->version == QRH_MANIFEST_VERSION &&
+                header->header_size == sizeof(*header) &&
+                header->count <= UINT32_MAX &&
+                header->entries_offset <= size &&
+                header->count * sizeof(struct qrh_manifest_entry) <= size - header->entries_offset &&
+                header->index_offset <= size &&
+                header->count * sizeof(uint32_t) <= size - header->index_offset &&
+                header->strings_offset <= size &&
+                header->strings_size <= size - header->strings_offset &&
+                (header->count == 0 ||
+                 (header->strings_size > 0 && ((const char *)map)[header->strings_offset + header->strings_size - 1] == '\0'));
+
+    /* entries and the index are read in place, so they must be aligned for their types */
+    valid = valid && header->entries_offset % 8 == 0 && header->index_offset % 4 == 0;
+
+    /* each path must lie inside the string table with its terminator, each index name an entry */
+    if(valid) {
+        const struct qrh_manifest_entry *entries = (const void *)((const uint8_t *)map + header->entries_offset);
+        const uint32_t *index = (const void *)((const uint8_t *)map + header->index_offset);
+        const char *strings   = (const char *)map + header->strings_offset;
+
+        for(uint64_t i = 0; valid && i < header->count; i++) {
+            const struct qrh_manifest_entry *entry = &entries[i];
+
+            valid = entry->path_offset < header->strings_size &&
+                    entry->path_len < header->strings_size - entry->path_offset &&
+                    strings[entry->path_offset + entry->path_len] == '\0' &&
+                    index[i] < header->count;
+        }
+
+        /* lookups and the diff merge-join need the path index strictly ascending: no duplicates */
+        for(uint64_t i = 1; valid && i < header->count; i++) {
+            const struct qrh_manifest_entry *a = &entries[index[i - 1]];
+            const struct qrh_manifest_entry *b = &entries[index[i]];
+
+            valid = manifest_compare_paths(strings + a->path_offset, a->path_len,
+                                           strings + b->path_offset, b->path_len) < 0;
+        }
+    }
+
+    if(!valid) {
+        munmap(map, (size_t)st.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+
+    manifest->map      = map;
+    manifest->map_size = (size_t)st.st_size;
+    manifest->header   = header;
+    manifest->entries  = (const struct qrh_manifest_entry *)(manifest->map + header->entries_offset);
+    manifest->index    = (const uint32_t *)(manifest->map + header->index_offset);
+    manifest->strings  = (const char *)(manifest->map + header->strings_offset);
+    manifest->count    = (size_t)header->count;
+
+    return 0;
+}
+
+void qrh_manifest_close(struct qrh_manifest *manifest) {
+    if(manifest->map)
+        munmap((void *)manifest->map, manifest->map_size);
+
+    memset(manifest, 0, sizeof(*manifest));
+}
+
+/* paths and index entries were checked by qrh_manifest_open() */
+const char *qrh_manifest_path(const struct qrh_manifest *manifest, const struct qrh_manifest_entry *entry) {
+    return manifest->strings + entry->path_offset;
+}
+
+static const struct qrh_manifest_entry *manifest_indexed(const struct qrh_manifest *manifest, size_t i) {
+    return &manifest->entries[manifest->index[i]];
+}
+
+const struct qrh_manifest_entry *qrh_manifest_find_path(const struct qrh_manifest *manifest, const char *path) {
+    size_t path_len = strlen(path);
+    size_t lo = 0;
+    size_t hi = manifest->count;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const struct qrh_manifest_entry *entry = manifest_indexed(manifest, mid);
+        int cmp = manifest_compare_paths(qrh_manifest_path(manifest, entry), entry->path_len, path, path_len);
+
+        if(cmp == 0)
+            return entry;
+
+        if(cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return NULL;
+}
+
+/* returns the first entry carrying `digest`, duplicates follow it in path order */
+const struct qrh_manifest_entry *qrh_manifest_find_digest(const struct qrh_manifest *manifest, const uint8_t digest[32]) {
+    size_t lo = 0;
+    size_t hi = manifest->count;
+
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if(memcmp(manifest->entries[mid].digest, digest, 32) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo < manifest->count && memcmp(manifest->entries[lo].digest, digest, 32) == 0)
+        return &manifest->entries[lo];
+
+    return NULL;
+}
+
+size_t qrh_manifest_diff(const struct qrh_manifest *a, const struct qrh_manifest *b, qrh_manifest_diff_fn fn, void *user) {
+    size_t i = 0;
+    size_t j = 0;
+    size_t changes = 0;
+
+    while(i < a->count || j < b->count) {
+        const struct qrh_manifest_entry *ea = i < a->count ? manifest_indexed(a, i) : NULL;
+        const struct qrh_manifest_entry *eb = j < b->count ? manifest_indexed(b, j) : NULL;
+        int cmp;
+
+        if(ea && eb)
+            cmp = manifest_compare_paths(qrh_manifest_path(a, ea), ea->path_len,
+                                         qrh_manifest_path(b, eb), eb->path_len);
+        else
+            cmp = ea ? -1 : 1;
+
+        if(cmp < 0) {
+            fn(QRH_MANIFEST_REMOVED, a, ea, b, NULL, user);
+            changes++;
+            i++;
+        } else if(cmp > 0) {
+            fn(QRH_MANIFEST_ADDED, a, NULL, b, eb, user);
+            changes++;
+            j++;
+        } else {
+            if(memcmp(ea->digest, eb->digest, sizeof(ea->digest)) != 0) {
+                fn(QRH_MANIFEST_CHANGED, a, ea, b, eb, user);
+                changes++;
+            }
+
+            i++;
+            j++;
+        }
+    }
+
+    return changes;
+}
@@ -0,0 +1,89 @@
+#ifndef QRH_MANIFEST_H
+#define QRH_MANIFEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Binary manifest layout (little-endian, every section 8-byte aligned):
+ *
+ *   header        struct qrh_manifest_header
+ *   entries       count * struct qrh_manifest_entry, sorted by digest then path
+ *   path index    count * uint32_t entry numbers, sorted by path
+ *   string table  NUL-terminated paths referenced by the entries
+ */
+
+#define QRH_MANIFEST_MAGIC   "QRHMANIF"
+#define QRH_MANIFEST_VERSION 1
+
+struct qrh_manifest_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t count;
+    uint64_t entries_offset;
+    uint64_t index_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t reserved;
+};
+
+struct qrh_manifest_entry {
+    uint8_t  digest[32];
+    uint64_t path_offset;
+    uint32_t path_len;
+    uint32_t flags;
+    uint64_t size;
+    uint64_t location; /* on-disk ordering hint (inode number) */
+};
+
+struct qrh_manifest {
+    const uint8_t *map;
+    size_t map_size;
+
+    const struct qrh_manifest_header *header;
+    const struct qrh_manifest_entry *entries;
+    const uint32_t *index;
+    const char *strings;
+    size_t count;
+};
+
+struct qrh_manifest_builder {
+    struct qrh_manifest_entry *entries;
+    size_t count;
+    size_t capacity;
+
+    char *strings;
+    size_t strings_size;
+    size_t strings_capacity;
+
+    const char *duplicate;  /* a path added twice, when _write() fails with EEXIST */
+};
+
+enum qrh_manifest_change {
+    QRH_MANIFEST_ADDED,
+    QRH_MANIFEST_REMOVED,
+    QRH_MANIFEST_CHANGED
+};
+
+/* receives the entry from `a` and/or `b`, the other one is NULL for ADDED/REMOVED */
+typedef void (*qrh_manifest_diff_fn)(enum qrh_manifest_change change,
+                                     const struct qrh_manifest *a, const struct qrh_manifest_entry *ea,
+                                     const struct qrh_manifest *b, const struct qrh_manifest_entry *eb,
+                                     void *user);
+
+void qrh_manifest_builder_init(struct qrh_manifest_builder *builder);
+int qrh_manifest_builder_add(struct qrh_manifest_builder *builder, const char *path, const uint8_t digest[32], uint64_t size, uint64_t location);
+int qrh_manifest_builder_write(struct qrh_manifest_builder *builder, const char *out_path);
+void qrh_manifest_builder_free(struct qrh_manifest_builder *builder);
+
+int qrh_manifest_open(struct qrh_manifest *manifest, const char *path);
+void qrh_manifest_close(struct qrh_manifest *manifest);
+
+const char *qrh_manifest_path(const struct qrh_manifest *manifest, const struct qrh_manifest_entry *entry);
+const struct qrh_manifest_entry *qrh_manifest_find_path(const struct qrh_manifest *manifest, const char *path);
+const struct qrh_manifest_entry *qrh_manifest_find_digest(const struct qrh_manifest *manifest, const uint8_t digest[32]);
+
+size_t qrh_manifest_diff(const struct qrh_manifest *a, const struct qrh_manifest *b, qrh_manifest_diff_fn fn, void *user);
+
+#endif
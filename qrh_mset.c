@@ -0,0 +1,195 @@
+/**
+ * qrh_mset.c
+ *
+ * Features:
+ *   - Additive multiset hash over QRH_MSET_LANES 32-bit lanes
+ *   - Element digests and expansion blocks go through qrh_256_multi(), so a
+ *     batch fills every SIMD lane
+ *   - Lanes are added or subtracted 8 (AVX2) or 4 (SSE2) at a time
+ *   - Parallel inserts accumulate per part on a qrh_pool, then merge
+ */
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+#include "qrh_mset.h"
+
+#define MSET_HASH_SIZE  32
+#define MSET_BATCH      32                       /* elements expanded together */
+#define MSET_SEED_SIZE  (4 + MSET_HASH_SIZE)
+#define MSET_ROOT       0x03
+#define MSET_PART_MIN   256                      /* elements per parallel part */
+
+struct mset_parallel {
+    const uint8_t *const *elements;
+    const size_t *lens;
+    size_t count;
+    size_t parts;
+    qrh_mset *partial;
+};
+
+/* acc += v (sign 1) or acc -= v (sign -1), lanes read little-endian from `bytes` */
+static void mset_accumulate(uint32_t *acc, const uint8_t *bytes, int sign) {
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for(; i < QRH_MSET_LANES / 8 * 8; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i));
+        __m256i v = _mm256_loadu_si256((const __m256i *)(bytes + i * 4));
+
+        a = sign > 0 ? _mm256_add_epi32(a, v) : _mm256_sub_epi32(a, v);
+        _mm256_storeu_si256((__m256i *)(acc + i), a);
+    }
+#elif defined(__SSE2__)
+    for(; i < QRH_MSET_LANES / 4 * 4; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i));
+        __m128i v = _mm_loadu_si128((const __m128i *)(bytes + i * 4));
+
+        a = sign > 0 ? _mm_add_epi32(a, v) : _mm_sub_epi32(a, v);
+        _mm_storeu_si128((__m128i *)(acc + i), a);
+    }
+#endif
+
+    /* tail, or every lane without SIMD */
+    for(; i < QRH_MSET_LANES; i++) {
+        const uint8_t *p = bytes + i * 4;
+        uint32_t v = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+
+        acc[i] = sign > 0 ? acc[i] + v : acc[i] - v;
+    }
+}
+
+/* up to MSET_BATCH elements: digest, expand, accumulate */
+static void mset_batch(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count, int sign) {
+    uint8_t digests[MSET_BATCH * MSET_HASH_SIZE];
+    uint8_t seeds[MSET_BATCH * QRH_MSET_BLOCKS][MSET_SEED_SIZE];
+    const uint8_t *inputs[MSET_BATCH * QRH_MSET_BLOCKS];
+    size_t seed_lens[MSET_BATCH * QRH_MSET_BLOCKS];
+    uint8_t blocks[MSET_BATCH * QRH_MSET_BLOCKS * MSET_HASH_SIZE];
+    size_t n = 0;
+
+    qrh_256_multi(elements, lens, count, digests);
+
+    for(size_t e = 0; e < count; e++) {
+        for(uint32_t j = 0; j < QRH_MSET_BLOCKS; j++, n++) {
+            seeds[n][0] = (uint8_t)j;
+            seeds[n][1] = (uint8_t)(j >> 8);
+            seeds[n][2] = (uint8_t)(j >> 16);
+            seeds[n][3] = (uint8_t)(j >> 24);
+            memcpy(seeds[n] + 4, digests + e * MSET_HASH_SIZE, MSET_HASH_SIZE);
+
+            inputs[n]    = seeds[n];
+            seed_lens[n] = MSET_SEED_SIZE;
+        }
+    }
+
+    qrh_256_multi(inputs, seed_lens, n, blocks);
+
+    for(size_t e = 0; e < count; e++)
+        mset_accumulate(mset->lanes, blocks + e * QRH_MSET_BLOCKS * MSET_HASH_SIZE, sign);
+
+    mset->count += sign > 0 ? (uint64_t)count : (uint64_t)0 - (uint64_t)count;
+}
+
+static void mset_update(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count, int sign) {
+    for(size_t i = 0; i < count; i += MSET_BATCH)
+        mset_batch(mset, elements + i, lens + i, count - i < MSET_BATCH ? count - i : MSET_BATCH, sign);
+}
+
+void qrh_mset_init(qrh_mset *mset) {
+    memset(mset, 0, sizeof(*mset));
+}
+
+void qrh_mset_insert(qrh_mset *mset, const uint8_t *element, size_t len) {
+    mset_update(mset, &element, &len, 1, 1);
+}
+
+void qrh_mset_remove(qrh_mset *mset, const uint8_t *element, size_t len) {
+    mset_update(mset, &element, &len, 1, -1);
+}
+
+void qrh_mset_insert_batch(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count) {
+    mset_update(mset, elements, lens, count, 1);
+}
+
+void qrh_mset_remove_batch(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count) {
+    mset_update(mset, elements, lens, count, -1);
+}
+
+static void mset_part_task(void *arg, size_t part) {
+    struct mset_parallel *job = arg;
+    size_t first = job->count * part / job->parts;
+    size_t last  = job->count * (part + 1) / job->parts;
+
+    qrh_mset_init(&job->partial[part]);
+    mset_update(&job->partial[part], job->elements + first, job->lens + first, last - first, 1);
+}
+
+void qrh_mset_insert_parallel(qrh_mset *mset, struct qrh_pool *pool, const uint8_t *const elements[],
+                              const size_t lens[], size_t count) {
+    enum { MSET_PARTS_MAX = 64 };
+    qrh_mset partial[MSET_PARTS_MAX];
+    size_t parts = count / MSET_PART_MIN;
+    unsigned threads = qrh_pool_threads(pool ? pool : qrh_pool_default());
+
+    if(parts > threads)
+        parts = threads;
+
+    if(parts > MSET_PARTS_MAX)
+        parts = MSET_PARTS_MAX;
+
+    if(parts < 2) {
+        qrh_mset_insert_batch(mset, elements, lens, count);
+        return;
+    }
+
+    struct mset_parallel job = { elements, lens, count, parts, partial };
+
+    qrh_pool_parallel(pool, parts, mset_part_task, &job);
+
+    for(size_t p = 0; p < parts; p++)
+        qrh_mset_merge(mset, &partial[p]);
+}
+
+void qrh_mset_merge(qrh_mset *mset, const qrh_mset *other) {
+    uint8_t bytes[QRH_MSET_LANES * 4];
+
+    for(size_t i = 0; i < QRH_MSET_LANES; i++) {
+        bytes[i * 4]     = (uint8_t)other->lanes[i];
+        bytes[i * 4 + 1] = (uint8_t)(other->lanes[i] >> 8);
+        bytes[i * 4 + 2] = (uint8_t)(other->lanes[i] >> 16);
+        bytes[i * 4 + 3] = (uint8_t)(other->lanes[i] >> 24);
+    }
+
+    mset_accumulate(mset->lanes, bytes, 1);
+    mset->count += other->count;
+}
+
+int qrh_mset_equal(const qrh_mset *a, const qrh_mset *b) {
+    return a->count == b->count && memcmp(a->lanes, b->lanes, sizeof(a->lanes)) == 0;
+}
+
+void qrh_mset_digest(const qrh_mset *mset, uint8_t out[32]) {
+    uint8_t root[1 + 8 + QRH_MSET_LANES * 4];
+    size_t n = 0;
+
+    root[n++] = MSET_ROOT;
+
+    for(int i = 0; i < 8; i++)
+        root[n++] = (uint8_t)(mset->count >> (8 * i));
+
+    for(size_t i = 0; i < QRH_MSET_LANES; i++) {
+        root[n++] = (uint8_t)mset->lanes[i];
+        root[n++] = (uint8_t)(mset->lanes[i] >> 8);
+        root[n++] = (uint8_t)(mset->lanes[i] >> 16);
+        root[n++] = (uint8_t)(mset->lanes[i] >> 24);
+    }
+
+    qrh_256(root, n, out);
+}
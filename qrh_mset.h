@@ -0,0 +1,55 @@
+#ifndef QRH_MSET_H
+#define QRH_MSET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_pool.h"
+
+/*
+ * Order-independent multiset digest. Each element is expanded to
+ * QRH_MSET_BLOCKS * 32 bytes,
+ *
+ *   block j = qrh_256(le32(j) || qrh_256(element))
+ *
+ * and read as 32-bit lanes added to the accumulator modulo 2^32. Addition
+ * is associative, commutative and invertible, so elements can be inserted
+ * and removed in any order, and accumulators built on different threads
+ * merge by adding them.
+ */
+
+#ifndef QRH_MSET_BLOCKS
+#define QRH_MSET_BLOCKS 16
+#endif
+
+#define QRH_MSET_LANES (QRH_MSET_BLOCKS * 8)
+
+/* plain data: copy, store or send it to merge elsewhere */
+typedef struct qrh_mset {
+    uint32_t lanes[QRH_MSET_LANES];
+    uint64_t count;                 /* inserts minus removes, modulo 2^64 */
+} qrh_mset;
+
+void qrh_mset_init(qrh_mset *mset);
+
+void qrh_mset_insert(qrh_mset *mset, const uint8_t *element, size_t len);
+void qrh_mset_remove(qrh_mset *mset, const uint8_t *element, size_t len);
+
+/* the same for many elements, expanded through the multi-buffer scheduler */
+void qrh_mset_insert_batch(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count);
+void qrh_mset_remove_batch(qrh_mset *mset, const uint8_t *const elements[], const size_t lens[], size_t count);
+
+/* insert_batch split across `pool` (NULL: the default pool) */
+void qrh_mset_insert_parallel(qrh_mset *mset, struct qrh_pool *pool, const uint8_t *const elements[],
+                              const size_t lens[], size_t count);
+
+/* mset += other, e.g. to combine per-thread accumulators */
+void qrh_mset_merge(qrh_mset *mset, const qrh_mset *other);
+
+/* 1 when both hold the same multiset */
+int qrh_mset_equal(const qrh_mset *a, const qrh_mset *b);
+
+/* 32-byte digest of the accumulator */
+void qrh_mset_digest(const qrh_mset *mset, uint8_t out[32]);
+
+#endif
@@ -0,0 +1,423 @@
+/**
+ * qrh_multi.c
+ *
+ * Features:
+ *   - Multi-buffer QRH-256: up to QRH_MULTI_LANES messages share one permutation
+ *   - Variable-length scheduler refills a lane as soon as its message is done
+ *   - Permutation written once over GCC vector types (AVX2 or 2x SSE2)
+ *   - qrh_64() over the same lanes, one short key per lane
+ *   - HMAC under one key over many messages, the pads fed to each lane as a prefix block
+ */
+
+#include <string.h>
+
+#include "qrh_256.h"
+#include "qrh_256_internal.h"
+#include "qrh_multi.h"
+
+#define QRH_BLOCK_SIZE 64
+#define QRH_HASH_SIZE  32
+#define QRH_WORDS_SIZE 16
+
+/* inner digests re-hashed per outer pass of qrh_256_hmac_multi() */
+#define QRH_MULTI_HMAC_BATCH 64
+
+/* qrh_64's seed and finish constants (qrh_256.c) */
+#define QRH_64_C0 0x6A09E667u
+#define QRH_64_C1 0xBB67AE85u
+#define QRH_64_C2 0x3C6EF372u
+#define QRH_64_C3 0xA54FF53Au
+#define QRH_64_C8 0xC1059ED8u
+#define QRH_64_C9 0x367CD507u
+
+typedef uint32_t qrh_vec __attribute__((vector_size(QRH_MULTI_LANES * sizeof(uint32_t))));
+
+#define ROTL32V(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+/* lane-parallel copies of the round helpers in qrh_256.c, same operation order */
+static inline void round4_v(qrh_vec *a, qrh_vec *b, qrh_vec *c, qrh_vec *d) {
+    *a += *b; *b ^= *d;  *b = ROTL32V((*b), 9);  *a = ROTL32V((*a), 6);
+    *c += *d; *a ^= *c;  *d = ROTL32V((*d), 12); *c = ROTL32V((*c), 13);
+    *a += *b; *c ^= *d;  *b = ROTL32V((*d), 14); *a = ROTL32V((*a), 25);
+    *c += *d; *a ^= *b;  *d = ROTL32V((*b), 23); *c = ROTL32V((*c), 30);
+}
+
+static inline void add3_v(qrh_vec *a, qrh_vec *b, qrh_vec *c) {
+    *a += (*c + *b);
+    *b += (*a + *c);
+    *c += (*a + *b);
+
+    *a += ROTL32V((*c), 19);
+    *b += ROTL32V((*a), 13);
+    *c += ROTL32V((*b), 8);
+}
+
+static inline void round_matrix_v(qrh_vec *a, qrh_vec *b, qrh_vec *c, qrh_vec *d) {
+    add3_v(b, c, a);
+    add3_v(a, c, d);
+    round4_v(a, b, c, d);
+    add3_v(b, d, a);
+    add3_v(b, c, d);
+}
+
+static inline void round2_v(qrh_vec *a, qrh_vec *b) {
+    *a += (*b | *a);
+    *b += (*b | *a);
+
+    *a += ROTL32V((*a), 13);
+    *b += ROTL32V((*b), 14);
+
+    *b ^= ROTL32V((*b), 15);
+    *a += ROTL32V((*a), 26);
+
+    *a += ROTL32V((*a), 11);
+    *b += ROTL32V((*b), 10);
+
+    *b ^= ROTL32V((*a + *b), 23);
+    *a ^= ROTL32V((*b + *a), 10);
+}
+
+static void qrh_run_state_v(qrh_vec s[QRH_WORDS_SIZE]) {
+    for(int i = 0; i < QRH_HALF_ROUNDS; i++) {
+        round2_v(&s[0],  &s[5]);
+        round2_v(&s[1],  &s[6]);
+        round2_v(&s[2],  &s[7]);
+        round2_v(&s[3],  &s[4]);
+
+        round2_v(&s[4],  &s[9]);
+        round2_v(&s[5],  &s[10]);
+        round2_v(&s[6],  &s[11]);
+        round2_v(&s[7],  &s[8]);
+
+        round2_v(&s[8],  &s[13]);
+        round2_v(&s[9],  &s[14]);
+        round2_v(&s[10], &s[15]);
+        round2_v(&s[11], &s[12]);
+
+        round2_v(&s[12], &s[1]);
+        round2_v(&s[13], &s[2]);
+        round2_v(&s[14], &s[3]);
+        round2_v(&s[15], &s[0]);
+    }
+
+    for(int i = 0; i < QRH_MATRIX_ROUNDS; i++) {
+        /* column quarter-rounds */
+        round_matrix_v(&s[0], &s[4], &s[8],  &s[12]);
+        round_matrix_v(&s[1], &s[5], &s[9],  &s[13]);
+        round_matrix_v(&s[2], &s[6], &s[10], &s[14]);
+        round_matrix_v(&s[3], &s[7], &s[11], &s[15]);
+
+        /* diagonal quarter-rounds */
+        round_matrix_v(&s[0], &s[5], &s[10], &s[15]);
+        round_matrix_v(&s[1], &s[6], &s[11], &s[12]);
+        round_matrix_v(&s[2], &s[7], &s[8],  &s[13]);
+        round_matrix_v(&s[3], &s[4], &s[9],  &s[14]);
+    }
+
+    for(int i = 0; i < QRH_DIFFUSIONS; i++) {
+        for(int w = 0; w < QRH_WORDS_SIZE; w++) {
+            s[w] ^= ROTL32V(s[(w + 7) % 16], 11);
+            s[w] += ROTL32V(s[(w + 3) % 16], 17);
+        }
+    }
+}
+
+struct qrh_lane {
+    qrh_ctx ctx;
+    size_t msg;
+    int active;
+};
+
+/*
+ * Lane scheduler behind qrh_256_multi() and qrh_256_hmac_multi(). A non-NULL
+ * `prefix` is one block hashed in front of every message, as if each input
+ * were prefix || inputs[i]; the block is whole, so message blocks stay aligned.
+ */
+static void qrh_multi_run(const uint8_t *prefix, const uint8_t *const inputs[], const size_t lens[],
+                          const size_t count, uint8_t *outs) {
+    const size_t prefix_len = prefix ? QRH_BLOCK_SIZE : 0;
+    struct qrh_lane lanes[QRH_MULTI_LANES];
+    qrh_vec s[QRH_WORDS_SIZE];
+    size_t next = 0;
+
+    memset(lanes, 0, sizeof(lanes));
+
+    for(;;) {
+        int active = 0;
+
+        /* refill idle lanes, empty messages never need a lane */
+        for(int l = 0; l < QRH_MULTI_LANES; l++) {
+            while(!lanes[l].active && next < count) {
+                if(prefix_len + lens[next] == 0) {
+                    qrh_256(inputs[next], 0, outs + next * QRH_HASH_SIZE);
+                    next++;
+                    continue;
+                }
+
+                qrh_init(&lanes[l].ctx, prefix_len + lens[next]);
+                lanes[l].msg    = next++;
+                lanes[l].active = 1;
+            }
+
+            active += lanes[l].active;
+        }
+
+        if(!active)
+            break;
+
+        /* a lone straggler is cheaper on the scalar path */
+        if(active == 1 && next == count) {
+            for(int l = 0; l < QRH_MULTI_LANES; l++) {
+                if(!lanes[l].active)
+                    continue;
+
+                qrh_ctx *ctx = &lanes[l].ctx;
+                const uint8_t *in = inputs[lanes[l].msg];
+                size_t done = ctx->offset < prefix_len ? 0 : ctx->offset - prefix_len;
+
+                if(ctx->offset < prefix_len)
+                    qrh_update(ctx, prefix, prefix_len);
+
+                qrh_update(ctx, in + done, lens[lanes[l].msg] - done);
+                qrh_final(ctx, outs + lanes[l].msg * QRH_HASH_SIZE);
+                lanes[l].active = 0;
+            }
+
+            break;
+        }
+
+        for(int l = 0; l < QRH_MULTI_LANES; l++) {
+            qrh_ctx *ctx = &lanes[l].ctx;
+
+            if(lanes[l].active && ctx->offset < prefix_len) {
+                qrh_ctx_mix_block(ctx, prefix, QRH_BLOCK_SIZE);
+            } else if(lanes[l].active) {
+                size_t left = ctx->total_len - ctx->offset;
+
+                qrh_ctx_mix_block(ctx, inputs[lanes[l].msg] + (ctx->offset - prefix_len),
+                                  left < QRH_BLOCK_SIZE ? left : QRH_BLOCK_SIZE);
+            }
+
+            for(int w = 0; w < QRH_WORDS_SIZE; w++)
+                s[w][l] = ctx->state[w];
+        }
+
+        qrh_run_state_v(s);
+
+        for(int l = 0; l < QRH_MULTI_LANES; l++) {
+            qrh_ctx *ctx = &lanes[l].ctx;
+
+            if(!lanes[l].active)
+                continue;
+
+            for(int w = 0; w < QRH_WORDS_SIZE; w++)
+                ctx->state[w] = s[w][l];
+
+            if(ctx->offset == ctx->total_len) {
+                qrh_ctx_finish(ctx, outs + lanes[l].msg * QRH_HASH_SIZE);
+                lanes[l].active = 0;
+            }
+        }
+    }
+
+    /* with HMAC pads as the prefix, the lane states are keyed material */
+    if(prefix) {
+        qrh_wipe(lanes, sizeof(lanes));
+        qrh_wipe(s, sizeof(s));
+    }
+}
+
+void qrh_256_multi(const uint8_t *const inputs[], const size_t lens[], const size_t count, uint8_t *outs) {
+    qrh_multi_run(NULL, inputs, lens, count, outs);
+}
+
+/*
+ * Same construction as qrh_256_hmac_with_key(): the inner pass hashes
+ * in_padding || message into outs, the outer pass out_padding || inner digest
+ * in place. A lane reads only its own 32 bytes and writes them once it has
+ * absorbed them, so the in-place outer pass is safe.
+ */
+void qrh_256_hmac_multi(const struct qrh_hmac_key *key, const uint8_t *const inputs[], const size_t lens[],
+                        const size_t count, uint8_t *outs) {
+    const uint8_t *inner[QRH_MULTI_HMAC_BATCH];
+    size_t inner_lens[QRH_MULTI_HMAC_BATCH];
+
+    qrh_multi_run(key->in_padding, inputs, lens, count, outs);
+
+    for(size_t base = 0; base < count; base += QRH_MULTI_HMAC_BATCH) {
+        size_t n = count - base < QRH_MULTI_HMAC_BATCH ? count - base : QRH_MULTI_HMAC_BATCH;
+
+        for(size_t i = 0; i < n; i++) {
+            inner[i]      = outs + (base + i) * QRH_HASH_SIZE;
+            inner_lens[i] = QRH_HASH_SIZE;
+        }
+
+        qrh_multi_run(key->out_padding, inner, inner_lens, n, outs + base * QRH_HASH_SIZE);
+    }
+}
+
+static inline void qrh_64_mix_v(qrh_vec s[4]) {
+    add3_v(&s[0], &s[1], &s[2]);
+    add3_v(&s[1], &s[2], &s[3]);
+    add3_v(&s[2], &s[3], &s[0]);
+}
+
+static inline void qrh_64_finish_v(qrh_vec s[4], uint64_t *outs, size_t count) {
+    uint32_t hi[QRH_MULTI_LANES], lo[QRH_MULTI_LANES];
+    qrh_vec h, l;
+
+    qrh_64_mix_v(s);
+    s[0] ^= QRH_64_C8;
+    s[3] ^= QRH_64_C9;
+    qrh_64_mix_v(s);
+
+    h = s[0] ^ s[2];
+    l = s[1] ^ s[3];
+    memcpy(hi, &h, sizeof(hi));
+    memcpy(lo, &l, sizeof(lo));
+
+    for(size_t i = 0; i < count; i++)
+        outs[i] = (uint64_t)hi[i] << 32 | lo[i];
+}
+
+static inline uint32_t qrh_64_load_v(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void qrh_64_multi(const uint8_t *const inputs[], const size_t lens[], const size_t count, const uint64_t seed,
+                  uint64_t *outs) {
+    for(size_t first = 0; first < count; first += QRH_MULTI_LANES) {
+        size_t group = count - first < QRH_MULTI_LANES ? count - first : QRH_MULTI_LANES;
+        uint32_t words[4][QRH_MULTI_LANES] = { { 0 } };
+        size_t steps[QRH_MULTI_LANES] = { 0 }, max_steps = 0;
+        qrh_vec s[4];
+
+        /* qrh_64_seed(), and the number of full 16-byte steps before each lane's tail */
+        for(size_t l = 0; l < group; l++) {
+            size_t len = lens[first + l];
+
+            words[0][l] = QRH_64_C0 ^ (uint32_t)seed;
+            words[1][l] = QRH_64_C1 ^ (uint32_t)(seed >> 32);
+            words[2][l] = QRH_64_C2 ^ (uint32_t)len;
+            words[3][l] = QRH_64_C3 ^ (uint32_t)((uint64_t)len >> 32);
+
+            steps[l] = len > 16 ? (len - 1) / 16 : 0;
+
+            if(steps[l] > max_steps)
+                max_steps = steps[l];
+        }
+
+        for(int w = 0; w < 4; w++)
+            memcpy(&s[w], words[w], sizeof(qrh_vec));
+
+        /* lanes past their last full step keep their state through the blend */
+        for(size_t step = 0; step < max_steps; step++) {
+            uint32_t active[QRH_MULTI_LANES] = { 0 };
+            qrh_vec mixed[4], mask;
+
+            memset(words, 0, sizeof(words));
+
+            for(size_t l = 0; l < group; l++) {
+                if(step >= steps[l])
+                    continue;
+
+                for(int w = 0; w < 4; w++)
+                    words[w][l] = qrh_64_load_v(inputs[first + l] + step * 16 + w * 4);
+
+                active[l] = 0xFFFFFFFFu;
+            }
+
+            memcpy(&mask, active, sizeof(mask));
+
+            for(int w = 0; w < 4; w++) {
+                qrh_vec block;
+
+                memcpy(&block, words[w], sizeof(block));
+                mixed[w] = s[w] ^ block;
+            }
+
+            qrh_64_mix_v(mixed);
+
+            for(int w = 0; w < 4; w++)
+                s[w] = (mixed[w] & mask) | (s[w] & ~mask);
+        }
+
+        /* last 0-16 bytes, zero padded */
+        memset(words, 0, sizeof(words));
+
+        for(size_t l = 0; l < group; l++) {
+            uint8_t tail[16] = { 0 };
+            size_t done = steps[l] * 16;
+
+            if(lens[first + l] > done)
+                memcpy(tail, inputs[first + l] + done, lens[first + l] - done);
+
+            for(int w = 0; w < 4; w++)
+                words[w][l] = qrh_64_load_v(tail + w * 4);
+        }
+
+        for(int w = 0; w < 4; w++) {
+            qrh_vec block;
+
+            memcpy(&block, words[w], sizeof(block));
+            s[w] ^= block;
+        }
+
+        qrh_64_finish_v(s, outs + first, group);
+    }
+}
+
+void qrh_64_u64_multi(const uint64_t *values, const size_t count, const uint64_t seed, uint64_t *outs) {
+    size_t first = 0;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* whole groups: split the words with shuffles instead of going through memory lane by lane */
+    const qrh_vec even = { 0, 2, 4, 6, 8, 10, 12, 14 }, odd = { 1, 3, 5, 7, 9, 11, 13, 15 };
+    const qrh_vec low  = { 0, 8, 1, 9, 2, 10, 3, 11 }, high = { 4, 12, 5, 13, 6, 14, 7, 15 };
+
+    for(; first + QRH_MULTI_LANES <= count; first += QRH_MULTI_LANES) {
+        qrh_vec a, b, s[4];
+
+        memcpy(&a, values + first, sizeof(a));
+        memcpy(&b, values + first + QRH_MULTI_LANES / 2, sizeof(b));
+
+        s[0] = __builtin_shuffle(a, b, even) ^ (QRH_64_C0 ^ (uint32_t)seed);
+        s[1] = __builtin_shuffle(a, b, odd) ^ (QRH_64_C1 ^ (uint32_t)(seed >> 32));
+        s[2] = (qrh_vec){ 0 } + (QRH_64_C2 ^ 8u);
+        s[3] = (qrh_vec){ 0 } + QRH_64_C3;
+
+        qrh_64_mix_v(s);
+        s[0] ^= QRH_64_C8;
+        s[3] ^= QRH_64_C9;
+        qrh_64_mix_v(s);
+
+        a = s[1] ^ s[3];
+        b = s[0] ^ s[2];
+        s[0] = __builtin_shuffle(a, b, low);
+        s[1] = __builtin_shuffle(a, b, high);
+        memcpy(outs + first, &s[0], sizeof(qrh_vec));
+        memcpy(outs + first + QRH_MULTI_LANES / 2, &s[1], sizeof(qrh_vec));
+    }
+#endif
+
+    for(; first < count; first += QRH_MULTI_LANES) {
+        size_t group = count - first < QRH_MULTI_LANES ? count - first : QRH_MULTI_LANES;
+        uint32_t lo[QRH_MULTI_LANES] = { 0 }, hi[QRH_MULTI_LANES] = { 0 };
+        qrh_vec s[4];
+
+        for(size_t l = 0; l < group; l++) {
+            lo[l] = (uint32_t)values[first + l];
+            hi[l] = (uint32_t)(values[first + l] >> 32);
+        }
+
+        /* qrh_64_seed() for 8 bytes with the value as the only tail */
+        memcpy(&s[0], lo, sizeof(qrh_vec));
+        memcpy(&s[1], hi, sizeof(qrh_vec));
+        s[0] ^= QRH_64_C0 ^ (uint32_t)seed;
+        s[1] ^= QRH_64_C1 ^ (uint32_t)(seed >> 32);
+        s[2] = (qrh_vec){ 0 } + (QRH_64_C2 ^ 8u);
+        s[3] = (qrh_vec){ 0 } + QRH_64_C3;
+
+        qrh_64_finish_v(s, outs + first, group);
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef QRH_MULTI_H
+#define QRH_MULTI_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* messages hashed side by side, one 32-bit SIMD lane each */
+#define QRH_MULTI_LANES 8
+
+/*
+ * Hashes `count` independent messages of any length, writing digest i to
+ * outs + i * 32. Identical to calling qrh_256() on each message.
+ */
+void qrh_256_multi(const uint8_t *const inputs[], const size_t lens[], const size_t count, uint8_t *outs);
+
+/*
+ * qrh_64() of `count` keys into outs[i], QRH_MULTI_LANES keys per step. A
+ * group of lanes runs as many 16-byte steps as its longest key, so this
+ * suits short keys of similar length.
+ */
+void qrh_64_multi(const uint8_t *const inputs[], const size_t lens[], const size_t count, const uint64_t seed,
+                  uint64_t *outs);
+
+struct qrh_hmac_key;
+
+/*
+ * HMAC-QRH-256 of `count` messages under one key, writing tag i to
+ * outs + i * 32. Identical to qrh_256_hmac_with_key() on each message.
+ */
+void qrh_256_hmac_multi(const struct qrh_hmac_key *key, const uint8_t *const inputs[], const size_t lens[],
+                        const size_t count, uint8_t *outs);
+
+/* qrh_64_u64() of `count` values */
+void qrh_64_u64_multi(const uint64_t *values, const size_t count, const uint64_t seed, uint64_t *outs);
+
+#endif
@@ -0,0 +1,458 @@
+/**
+ * qrh_pool.c
+ *
+ * Features:
+ *   - Work-stealing pool: one deque per worker, LIFO for the owner and FIFO
+ *     for thieves, plus a shared queue for tasks from outside the pool
+ *   - Optional CPU pinning per worker
+ *   - Host executor hook, so an application with its own thread pool does not
+ *     get a second one
+ *   - Blocking parallel-for in which the waiting thread takes part
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "qrh_pool.h"
+
+#define POOL_MAX_THREADS 1024
+#define POOL_DEQUE_MIN   64
+
+struct pool_task {
+    qrh_pool_task_fn fn;
+    void *arg;
+};
+
+/* ring buffer, capacity is a power of two */
+struct pool_deque {
+    pthread_mutex_t lock;
+    struct pool_task *tasks;
+    size_t cap;
+    size_t head;
+    size_t count;
+};
+
+struct pool_worker {
+    struct qrh_pool *pool;
+    unsigned index;
+    pthread_t thread;
+    struct pool_deque deque;
+};
+
+struct qrh_pool {
+    struct qrh_pool_executor executor;
+    int has_executor;
+    unsigned threads;
+
+    struct pool_worker *workers;
+    unsigned nworkers;
+    struct pool_deque inject;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    size_t pending;    /* queued tasks, atomic */
+    unsigned sleeping; /* atomic */
+    int stopping;
+};
+
+struct pool_parallel {
+    qrh_pool_index_fn fn;
+    void *arg;
+    size_t n;
+    size_t next;    /* atomic */
+    size_t helpers; /* submitted and not yet finished */
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+static __thread struct pool_worker *pool_self;
+
+static pthread_mutex_t pool_default_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct qrh_pool *pool_default;
+
+static void pool_deque_init(struct pool_deque *d) {
+    memset(d, 0, sizeof(*d));
+    pthread_mutex_init(&d->lock, NULL);
+}
+
+static void pool_deque_destroy(struct pool_deque *d) {
+    pthread_mutex_destroy(&d->lock);
+    free(d->tasks);
+}
+
+static int pool_deque_push(struct pool_deque *d, qrh_pool_task_fn fn, void *arg) {
+    pthread_mutex_lock(&d->lock);
+
+    if(d->count == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : POOL_DEQUE_MIN;
+        struct pool_task *tasks = malloc(cap * sizeof(*tasks));
+
+        if(!tasks) {
+            pthread_mutex_unlock(&d->lock);
+            errno = ENOMEM;
+            return -1;
+        }
+
+        for(size_t i = 0; i < d->count; i++)
+            tasks[i] = d->tasks[(d->head + i) & (d->cap - 1)];
+
+        free(d->tasks);
+        d->tasks = tasks;
+        d->cap   = cap;
+        d->head  = 0;
+    }
+
+    d->tasks[(d->head + d->count) & (d->cap - 1)] = (struct pool_task){ fn, arg };
+
+    /* thieves peek at `count` without the lock */
+    __atomic_store_n(&d->count, d->count + 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&d->lock);
+    return 0;
+}
+
+/* `newest` for the owner, the oldest task otherwise */
+static int pool_deque_pop(struct pool_deque *d, int newest, struct pool_task *out) {
+    if(__atomic_load_n(&d->count, __ATOMIC_RELAXED) == 0)
+        return 0;
+
+    pthread_mutex_lock(&d->lock);
+
+    if(d->count == 0) {
+        pthread_mutex_unlock(&d->lock);
+        return 0;
+    }
+
+    if(newest) {
+        *out = d->tasks[(d->head + d->count - 1) & (d->cap - 1)];
+    } else {
+        *out    = d->tasks[d->head];
+        d->head = (d->head + 1) & (d->cap - 1);
+    }
+
+    __atomic_store_n(&d->count, d->count - 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&d->lock);
+    return 1;
+}
+
+/* own deque, then the shared queue, then the other workers */
+static int pool_take(struct qrh_pool *pool, struct pool_worker *self, struct pool_task *out) {
+    int found = 0;
+
+    if(self)
+        found = pool_deque_pop(&self->deque, 1, out);
+
+    if(!found)
+        found = pool_deque_pop(&pool->inject, 0, out);
+
+    unsigned start = self ? self->index + 1 : 0;
+
+    for(unsigned k = 0; !found && k < pool->nworkers; k++) {
+        struct pool_worker *victim = &pool->workers[(start + k) % pool->nworkers];
+
+        if(victim != self)
+            found = pool_deque_pop(&victim->deque, 0, out);
+    }
+
+    if(found)
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+    return found;
+}
+
+static struct pool_worker *pool_current(struct qrh_pool *pool) {
+    return pool_self && pool_self->pool == pool ? pool_self : NULL;
+}
+
+static void *pool_worker_main(void *arg) {
+    struct pool_worker *self = arg;
+    struct qrh_pool *pool    = self->pool;
+    struct pool_task task;
+
+    pool_self = self;
+
+    for(;;) {
+        if(pool_take(pool, self, &task)) {
+            task.fn(task.arg);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        __atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+
+        /* submitters bump `pending` before they look at `sleeping` */
+        while(__atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->wake, &pool->lock);
+
+        __atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+
+        int done = pool->stopping && __atomic_load_n(&pool->pending, __ATOMIC_SEQ_CST) == 0;
+
+        pthread_mutex_unlock(&pool->lock);
+
+        if(done)
+            break;
+    }
+
+    return NULL;
+}
+
+static unsigned pool_default_threads(void) {
+    const char *env = getenv("QRH_POOL_THREADS");
+    long n = env ? strtol(env, NULL, 10) : 0;
+
+    if(n <= 0)
+        n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if(n <= 0)
+        n = 1;
+
+    return n > POOL_MAX_THREADS ? POOL_MAX_THREADS : (unsigned)n;
+}
+
+struct qrh_pool *qrh_pool_create(const struct qrh_pool_config *cfg) {
+    struct qrh_pool *pool = calloc(1, sizeof(*pool));
+
+    if(!pool)
+        return NULL;
+
+    pool->threads = cfg && cfg->threads ? cfg->threads : pool_default_threads();
+
+    if(pool->threads > POOL_MAX_THREADS)
+        pool->threads = POOL_MAX_THREADS;
+
+    pool_deque_init(&pool->inject);
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    if(cfg && cfg->executor) {
+        pool->executor     = *cfg->executor;
+        pool->has_executor = 1;
+        return pool;
+    }
+
+    pool->workers = calloc(pool->threads, sizeof(*pool->workers));
+
+    if(!pool->workers) {
+        qrh_pool_destroy(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* all deques exist before the first worker starts stealing */
+    for(unsigned i = 0; i < pool->threads; i++) {
+        pool->workers[i].pool  = pool;
+        pool->workers[i].index = i;
+        pool_deque_init(&pool->workers[i].deque);
+    }
+
+    pool->nworkers = pool->threads;
+
+    for(unsigned i = 0; i < pool->threads; i++) {
+        struct pool_worker *w = &pool->workers[i];
+        int err = pthread_create(&w->thread, NULL, pool_worker_main, w);
+
+        if(err != 0) {
+            /* stop the ones already running; their deques are still empty */
+            pthread_mutex_lock(&pool->lock);
+            pool->stopping = 1;
+            pthread_cond_broadcast(&pool->wake);
+            pthread_mutex_unlock(&pool->lock);
+
+            for(unsigned j = 0; j < i; j++)
+                pthread_join(pool->workers[j].thread, NULL);
+
+            for(unsigned j = 0; j < pool->threads; j++)
+                pool_deque_destroy(&pool->workers[j].deque);
+
+            pool->nworkers = 0;
+            qrh_pool_destroy(pool);
+            errno = err;
+            return NULL;
+        }
+
+        if(cfg && cfg->cpus && cfg->ncpus) {
+            cpu_set_t set;
+
+            CPU_ZERO(&set);
+            CPU_SET(cfg->cpus[i % cfg->ncpus], &set);
+            pthread_setaffinity_np(w->thread, sizeof(set), &set);
+        }
+    }
+
+    return pool;
+}
+
+void qrh_pool_destroy(struct qrh_pool *pool) {
+    if(!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(unsigned i = 0; i < pool->nworkers; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+
+    for(unsigned i = 0; i < pool->nworkers; i++)
+        pool_deque_destroy(&pool->workers[i].deque);
+
+    pool_deque_destroy(&pool->inject);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+
+    free(pool->workers);
+    free(pool);
+}
+
+struct qrh_pool *qrh_pool_default(void) {
+    pthread_mutex_lock(&pool_default_lock);
+
+    if(!pool_default)
+        pool_default = qrh_pool_create(NULL);
+
+    struct qrh_pool *pool = pool_default;
+
+    pthread_mutex_unlock(&pool_default_lock);
+    return pool;
+}
+
+int qrh_pool_set_default(struct qrh_pool *pool) {
+    int ret = 0;
+
+    pthread_mutex_lock(&pool_default_lock);
+
+    if(pool_default) {
+        errno = EBUSY;
+        ret   = -1;
+    } else {
+        pool_default = pool;
+    }
+
+    pthread_mutex_unlock(&pool_default_lock);
+    return ret;
+}
+
+unsigned qrh_pool_threads(struct qrh_pool *pool) {
+    if(!pool)
+        pool = qrh_pool_default();
+
+    return pool ? pool->threads : 1;
+}
+
+int qrh_pool_submit(struct qrh_pool *pool, qrh_pool_task_fn fn, void *arg) {
+    if(!pool)
+        pool = qrh_pool_default();
+
+    if(!pool || (pool->has_executor && pool->executor.submit(pool->executor.ctx, fn, arg) < 0)) {
+        fn(arg);
+        return 0;
+    }
+
+    if(pool->has_executor)
+        return 0;
+
+    struct pool_worker *self = pool_current(pool);
+
+    if(pool_deque_push(self ? &self->deque : &pool->inject, fn, arg) < 0)
+        return -1;
+
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_SEQ_CST);
+
+    if(__atomic_load_n(&pool->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    return 0;
+}
+
+static void pool_parallel_claim(struct pool_parallel *job) {
+    size_t i;
+
+    while((i = __atomic_fetch_add(&job->next, 1, __ATOMIC_RELAXED)) < job->n)
+        job->fn(job->arg, i);
+}
+
+static void pool_parallel_helper(void *arg) {
+    struct pool_parallel *job = arg;
+
+    pool_parallel_claim(job);
+
+    pthread_mutex_lock(&job->lock);
+
+    if(--job->helpers == 0)
+        pthread_cond_signal(&job->done);
+
+    pthread_mutex_unlock(&job->lock);
+}
+
+void qrh_pool_parallel(struct qrh_pool *pool, size_t n, qrh_pool_index_fn fn, void *arg) {
+    struct pool_parallel job = { .fn = fn, .arg = arg, .n = n };
+
+    if(!pool)
+        pool = qrh_pool_default();
+
+    if(!pool || n < 2) {
+        pool_parallel_claim(&job);
+        return;
+    }
+
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.done, NULL);
+
+    /* the calling thread is one of the participants */
+    size_t want = n - 1 < pool->threads ? n - 1 : pool->threads;
+
+    for(size_t h = 0; h < want; h++) {
+        pthread_mutex_lock(&job.lock);
+        job.helpers++;
+        pthread_mutex_unlock(&job.lock);
+
+        if(qrh_pool_submit(pool, pool_parallel_helper, &job) < 0) {
+            pthread_mutex_lock(&job.lock);
+            job.helpers--;
+            pthread_mutex_unlock(&job.lock);
+            break;
+        }
+    }
+
+    pool_parallel_claim(&job);
+
+    /* helpers still queued are run here rather than waited for */
+    struct pool_worker *self = pool_current(pool);
+    struct pool_task task;
+
+    for(;;) {
+        pthread_mutex_lock(&job.lock);
+        size_t left = job.helpers;
+        pthread_mutex_unlock(&job.lock);
+
+        if(left == 0)
+            break;
+
+        if(!pool->has_executor && pool_take(pool, self, &task)) {
+            task.fn(task.arg);
+            continue;
+        }
+
+        pthread_mutex_lock(&job.lock);
+
+        while(job.helpers)
+            pthread_cond_wait(&job.done, &job.lock);
+
+        pthread_mutex_unlock(&job.lock);
+    }
+
+    pthread_mutex_destroy(&job.lock);
+    pthread_cond_destroy(&job.done);
+}
@@ -0,0 +1,61 @@
+#ifndef QRH_POOL_H
+#define QRH_POOL_H
+
+#include <stddef.h>
+
+/*
+ * Shared worker pool for everything in this library that hashes in parallel.
+ * Each worker keeps its own task deque: it pops its newest task and steals the
+ * oldest from other workers when it runs dry. Tasks submitted from outside
+ * the pool go through a shared queue.
+ */
+
+typedef void (*qrh_pool_task_fn)(void *arg);
+typedef void (*qrh_pool_index_fn)(void *arg, size_t index);
+
+/* hands tasks to the host application's threads instead of our own */
+struct qrh_pool_executor {
+    void *ctx;
+    /* runs `run(arg)` once, later; 0, or -1 to have the caller run it inline */
+    int (*submit)(void *ctx, qrh_pool_task_fn run, void *arg);
+};
+
+struct qrh_pool_config {
+    unsigned threads;                          /* 0: QRH_POOL_THREADS environment variable, else online CPUs */
+    const unsigned *cpus;                      /* worker i is pinned to cpus[i % ncpus], NULL: not pinned */
+    size_t ncpus;
+    const struct qrh_pool_executor *executor;  /* no threads are started when set */
+};
+
+struct qrh_pool;
+
+/* `cfg` may be NULL for defaults; NULL with errno set on failure */
+struct qrh_pool *qrh_pool_create(const struct qrh_pool_config *cfg);
+
+/* runs every queued task, then stops the workers */
+void qrh_pool_destroy(struct qrh_pool *pool);
+
+/* process-wide pool, created with defaults on first use; NULL if that fails */
+struct qrh_pool *qrh_pool_default(void);
+
+/* installs `pool` as the default; -1 with errno EBUSY once the default exists */
+int qrh_pool_set_default(struct qrh_pool *pool);
+
+/* parallelism to plan for: worker count, or the configured hint with an executor */
+unsigned qrh_pool_threads(struct qrh_pool *pool);
+
+/*
+ * Queues `fn(arg)`. A NULL `pool` means qrh_pool_default(); if there is no
+ * pool at all, or the executor declines, `fn` runs before this returns.
+ * 0 or -1 with errno ENOMEM.
+ */
+int qrh_pool_submit(struct qrh_pool *pool, qrh_pool_task_fn fn, void *arg);
+
+/*
+ * Calls `fn(arg, i)` for every i in [0, n) and returns once all calls are
+ * done. Indices are handed out one at a time to the workers and the calling
+ * thread, which also runs other queued tasks while it waits.
+ */
+void qrh_pool_parallel(struct qrh_pool *pool, size_t n, qrh_pool_index_fn fn, void *arg);
+
+#endif
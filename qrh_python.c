@@ -0,0 +1,661 @@
+/**
+ * qrh_python.c
+ *
+ * Features:
+ *   - CPython extension module `qrh`
+ *   - qrh_256(), hmac() and hash_many() read any buffer-protocol object in place
+ *   - hashlib-compatible qrh256 objects and reusable HmacKey objects
+ *   - The GIL is released for inputs above QRH_PY_GIL_THRESHOLD bytes
+ *
+ * QRH-256 mixes the total length into every block, so a qrh256 object only
+ * streams when the length is declared up front (`length=`); otherwise it
+ * collects the data and hashes it once in digest(). That copy has no bound,
+ * so the module docstring steers large inputs to `length=` or qrh_256().
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pythread.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_encode.h"
+
+/* below this the GIL round trip costs more than the hash */
+#define QRH_PY_GIL_THRESHOLD 2048
+
+typedef struct {
+    PyObject_HEAD
+    PyThread_type_lock lock; /* held while the GIL is released around this object */
+    qrh_ctx ctx;
+    int streaming;           /* total length was declared, ctx is live */
+    int keyed;               /* HMAC: ctx/buffer hold the inner message */
+    qrh_hmac_key key;
+    uint8_t *buffer;         /* data seen so far when not streaming */
+    size_t len;
+    size_t capacity;
+} QrhObject;
+
+typedef struct {
+    PyObject_HEAD
+    qrh_hmac_key key;
+} HmacKeyObject;
+
+static PyTypeObject QrhType;
+static PyTypeObject HmacKeyType;
+
+/* object lock, taken without dropping the GIL when uncontended */
+static void qrh_py_lock(QrhObject *self) {
+    if(!PyThread_acquire_lock(self->lock, 0)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(self->lock, 1);
+        Py_END_ALLOW_THREADS
+    }
+}
+
+static void qrh_py_unlock(QrhObject *self) {
+    PyThread_release_lock(self->lock);
+}
+
+static int qrh_py_get_buffer(PyObject *obj, Py_buffer *view) {
+    if(PyUnicode_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "Strings must be encoded before hashing");
+        return -1;
+    }
+
+    return PyObject_GetBuffer(obj, view, PyBUF_SIMPLE);
+}
+
+static void qrh_py_hash(const Py_buffer *view, uint8_t *out) {
+    if(view->len >= QRH_PY_GIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        qrh_256(view->buf, (size_t)view->len, out);
+        Py_END_ALLOW_THREADS
+    } else {
+        qrh_256(view->buf, (size_t)view->len, out);
+    }
+}
+
+static void qrh_py_hmac(const qrh_hmac_key *key, const Py_buffer *view, uint8_t *out) {
+    if(view->len >= QRH_PY_GIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        qrh_256_hmac_with_key(key, view->buf, (size_t)view->len, out);
+        Py_END_ALLOW_THREADS
+    } else {
+        qrh_256_hmac_with_key(key, view->buf, (size_t)view->len, out);
+    }
+}
+
+static PyObject *qrh_py_hexdigest(const uint8_t digest[QRH_DIGEST_SIZE]) {
+    char hex[QRH_HEX_LEN + 1];
+
+    qrh_digest_to_hex(digest, hex);
+    return PyUnicode_FromStringAndSize(hex, QRH_HEX_LEN);
+}
+
+/*
+ * hash_many() and digest_many() backend: every buffer is exported (so a
+ * bytearray cannot be resized underneath us), then all of them go through
+ * qrh_256_multi() or qrh_256_hmac_multi() with the GIL released.
+ */
+static PyObject *qrh_py_hash_views(PyObject *iterable, const qrh_hmac_key *key) {
+    PyObject *seq = PySequence_Fast(iterable, "hash_many() expects an iterable of bytes-like objects");
+
+    if(!seq)
+        return NULL;
+
+    Py_ssize_t count     = PySequence_Fast_GET_SIZE(seq);
+    Py_buffer *views     = PyMem_Calloc(count ? (size_t)count : 1, sizeof(*views));
+    const uint8_t **ptrs = PyMem_Calloc(count ? (size_t)count : 1, sizeof(*ptrs));
+    size_t *lens         = PyMem_Calloc(count ? (size_t)count : 1, sizeof(*lens));
+    uint8_t *digests     = PyMem_Malloc(count ? (size_t)count * QRH_DIGEST_SIZE : 1);
+    PyObject *result     = NULL;
+    Py_ssize_t acquired  = 0;
+
+    if(!views || !ptrs || !lens || !digests) {
+        PyErr_NoMemory();
+        goto out;
+    }
+
+    for(; acquired < count; acquired++) {
+        if(qrh_py_get_buffer(PySequence_Fast_GET_ITEM(seq, acquired), &views[acquired]) < 0)
+            goto out;
+
+        ptrs[acquired] = views[acquired].buf;
+        lens[acquired] = (size_t)views[acquired].len;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    if(key)
+        qrh_256_hmac_multi(key, ptrs, lens, (size_t)count, digests);
+    else
+        qrh_256_multi(ptrs, lens, (size_t)count, digests);
+    Py_END_ALLOW_THREADS
+
+    result = PyList_New(count);
+
+    for(Py_ssize_t i = 0; result && i < count; i++) {
+        PyObject *digest = PyBytes_FromStringAndSize((const char *)digests + (size_t)i * QRH_DIGEST_SIZE, QRH_DIGEST_SIZE);
+
+        if(!digest) {
+            Py_CLEAR(result);
+            break;
+        }
+
+        PyList_SET_ITEM(result, i, digest);
+    }
+
+out:
+    for(Py_ssize_t i = 0; i < acquired; i++)
+        PyBuffer_Release(&views[i]);
+
+    PyMem_Free(views);
+    PyMem_Free(ptrs);
+    PyMem_Free(lens);
+    PyMem_Free(digests);
+    Py_DECREF(seq);
+
+    return result;
+}
+
+/* qrh256 objects */
+static QrhObject *qrh_py_alloc(void) {
+    QrhObject *self = PyObject_New(QrhObject, &QrhType);
+
+    if(!self)
+        return NULL;
+
+    self->streaming = 0;
+    self->keyed     = 0;
+    self->buffer    = NULL;
+    self->len       = 0;
+    self->capacity  = 0;
+    self->lock      = PyThread_allocate_lock();
+
+    memset(&self->ctx, 0, sizeof(self->ctx));
+    memset(&self->key, 0, sizeof(self->key));
+
+    if(!self->lock) {
+        Py_DECREF(self);
+        PyErr_SetString(PyExc_MemoryError, "unable to allocate lock");
+        return NULL;
+    }
+
+    return self;
+}
+
+static void qrh_py_dealloc(QrhObject *self) {
+    if(self->lock)
+        PyThread_free_lock(self->lock);
+
+    PyMem_Free(self->buffer);
+    qrh_wipe(&self->ctx, sizeof(self->ctx));
+    qrh_wipe(&self->key, sizeof(self->key));
+    PyObject_Free(self);
+}
+
+/* called with the object lock held */
+static int qrh_py_feed(QrhObject *self, const Py_buffer *view) {
+    const size_t len = (size_t)view->len;
+    int ret = 0;
+
+    if(self->streaming) {
+        if(len >= QRH_PY_GIL_THRESHOLD) {
+            Py_BEGIN_ALLOW_THREADS
+            ret = qrh_update(&self->ctx, view->buf, len);
+            Py_END_ALLOW_THREADS
+        } else {
+            ret = qrh_update(&self->ctx, view->buf, len);
+        }
+
+        if(ret < 0)
+            PyErr_SetString(PyExc_ValueError, "more data than the declared length");
+
+        return ret;
+    }
+
+    if(len > self->capacity - self->len) {
+        size_t capacity = self->capacity ? self->capacity : 256;
+
+        while(capacity - self->len < len) {
+            if(capacity > PY_SSIZE_T_MAX / 2) {
+                PyErr_NoMemory();
+                return -1;
+            }
+
+            capacity *= 2;
+        }
+
+        uint8_t *grown = PyMem_Realloc(self->buffer, capacity);
+
+        if(!grown) {
+            PyErr_NoMemory();
+            return -1;
+        }
+
+        self->buffer   = grown;
+        self->capacity = capacity;
+    }
+
+    if(len >= QRH_PY_GIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        memcpy(self->buffer + self->len, view->buf, len);
+        Py_END_ALLOW_THREADS
+    } else if(len) {
+        memcpy(self->buffer + self->len, view->buf, len);
+    }
+
+    self->len += len;
+    return 0;
+}
+
+static QrhObject *qrh_py_create(PyObject *data, PyObject *length, const qrh_hmac_key *key) {
+    QrhObject *self = qrh_py_alloc();
+
+    if(!self)
+        return NULL;
+
+    if(key) {
+        self->keyed = 1;
+        self->key   = *key;
+    }
+
+    if(length && length != Py_None) {
+        Py_ssize_t total = PyNumber_AsSsize_t(length, PyExc_OverflowError);
+
+        if(total == -1 && PyErr_Occurred()) {
+            Py_DECREF(self);
+            return NULL;
+        }
+
+        if(total < 0) {
+            PyErr_SetString(PyExc_ValueError, "length must not be negative");
+            Py_DECREF(self);
+            return NULL;
+        }
+
+        self->streaming = 1;
+
+        if(key) {
+            /* inner hash runs over ipad || message */
+            qrh_init(&self->ctx, sizeof(key->in_padding) + (size_t)total);
+            qrh_update(&self->ctx, key->in_padding, sizeof(key->in_padding));
+        } else {
+            qrh_init(&self->ctx, (size_t)total);
+        }
+    }
+
+    if(data) {
+        Py_buffer view;
+
+        if(qrh_py_get_buffer(data, &view) < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+
+        int ret = qrh_py_feed(self, &view);
+        PyBuffer_Release(&view);
+
+        if(ret < 0) {
+            Py_DECREF(self);
+            return NULL;
+        }
+    }
+
+    return self;
+}
+
+static PyObject *qrh_py_update(QrhObject *self, PyObject *data) {
+    Py_buffer view;
+
+    if(qrh_py_get_buffer(data, &view) < 0)
+        return NULL;
+
+    qrh_py_lock(self);
+    int ret = qrh_py_feed(self, &view);
+    qrh_py_unlock(self);
+
+    PyBuffer_Release(&view);
+
+    if(ret < 0)
+        return NULL;
+
+    Py_RETURN_NONE;
+}
+
+/* finishes a copy of the state, so digest() can be called repeatedly */
+static int qrh_py_finish(QrhObject *self, uint8_t out[QRH_DIGEST_SIZE]) {
+    int ret = 0;
+
+    qrh_py_lock(self);
+
+    if(self->streaming) {
+        qrh_ctx ctx = self->ctx;
+
+        if(qrh_final(&ctx, out) < 0) {
+            ret = -1;
+        } else if(self->keyed) {
+            uint8_t outer[sizeof(self->key.out_padding) + QRH_DIGEST_SIZE];
+
+            memcpy(outer, self->key.out_padding, sizeof(self->key.out_padding));
+            memcpy(outer + sizeof(self->key.out_padding), out, QRH_DIGEST_SIZE);
+            qrh_init(&ctx, sizeof(outer));
+            qrh_update(&ctx, outer, sizeof(outer));
+            qrh_final(&ctx, out);
+            qrh_wipe(outer, sizeof(outer));
+        }
+
+        /* the copy carries the inner HMAC state, then the outer one */
+        qrh_wipe(&ctx, sizeof(ctx));
+    } else if(self->len >= QRH_PY_GIL_THRESHOLD) {
+        Py_BEGIN_ALLOW_THREADS
+        if(self->keyed)
+            qrh_256_hmac_with_key(&self->key, self->buffer, self->len, out);
+        else
+            qrh_256(self->buffer, self->len, out);
+        Py_END_ALLOW_THREADS
+    } else {
+        if(self->keyed)
+            qrh_256_hmac_with_key(&self->key, self->buffer, self->len, out);
+        else
+            qrh_256(self->buffer, self->len, out);
+    }
+
+    qrh_py_unlock(self);
+
+    if(ret < 0)
+        PyErr_SetString(PyExc_ValueError, "fewer bytes than the declared length");
+
+    return ret;
+}
+
+static PyObject *qrh_py_digest(QrhObject *self, PyObject *unused) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+
+    (void)unused;
+
+    if(qrh_py_finish(self, digest) < 0)
+        return NULL;
+
+    return PyBytes_FromStringAndSize((const char *)digest, QRH_DIGEST_SIZE);
+}
+
+static PyObject *qrh_py_hexdigest_method(QrhObject *self, PyObject *unused) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+
+    (void)unused;
+
+    if(qrh_py_finish(self, digest) < 0)
+        return NULL;
+
+    return qrh_py_hexdigest(digest);
+}
+
+static PyObject *qrh_py_copy(QrhObject *self, PyObject *unused) {
+    QrhObject *copy = qrh_py_alloc();
+
+    (void)unused;
+
+    if(!copy)
+        return NULL;
+
+    qrh_py_lock(self);
+
+    copy->ctx       = self->ctx;
+    copy->streaming = self->streaming;
+    copy->keyed     = self->keyed;
+    copy->key       = self->key;
+
+    if(self->len) {
+        copy->buffer = PyMem_Malloc(self->len);
+
+        if(copy->buffer) {
+            memcpy(copy->buffer, self->buffer, self->len);
+            copy->len      = self->len;
+            copy->capacity = self->len;
+        }
+    }
+
+    qrh_py_unlock(self);
+
+    if(self->len && !copy->buffer) {
+        Py_DECREF(copy);
+        return PyErr_NoMemory();
+    }
+
+    return (PyObject *)copy;
+}
+
+static PyObject *qrh_py_get_name(QrhObject *self, void *closure) {
+    (void)closure;
+    return PyUnicode_FromString(self->keyed ? "hmac-qrh256" : "qrh256");
+}
+
+static PyObject *qrh_py_get_digest_size(QrhObject *self, void *closure) {
+    (void)self;
+    (void)closure;
+    return PyLong_FromLong(QRH_DIGEST_SIZE);
+}
+
+static PyObject *qrh_py_get_block_size(QrhObject *self, void *closure) {
+    (void)self;
+    (void)closure;
+    return PyLong_FromLong(64);
+}
+
+static PyMethodDef qrh_py_methods[] = {
+    { "update",    (PyCFunction)qrh_py_update,           METH_O,      "Feed a bytes-like object." },
+    { "digest",    (PyCFunction)qrh_py_digest,           METH_NOARGS, "Return the 32-byte digest of the data fed so far." },
+    { "hexdigest", (PyCFunction)qrh_py_hexdigest_method, METH_NOARGS, "Return the digest as 64 lowercase hex digits." },
+    { "copy",      (PyCFunction)qrh_py_copy,             METH_NOARGS, "Return an independent copy of this object." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyGetSetDef qrh_py_getset[] = {
+    { "name",        (getter)qrh_py_get_name,        NULL, NULL, NULL },
+    { "digest_size", (getter)qrh_py_get_digest_size, NULL, NULL, NULL },
+    { "block_size",  (getter)qrh_py_get_block_size,  NULL, NULL, NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyTypeObject QrhType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name      = "qrh.qrh256",
+    .tp_doc       = "hashlib-style QRH-256 object, created with qrh.new(); streams only with length=",
+    .tp_basicsize = sizeof(QrhObject),
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_dealloc   = (destructor)qrh_py_dealloc,
+    .tp_methods   = qrh_py_methods,
+    .tp_getset    = qrh_py_getset,
+};
+
+/* HmacKey objects */
+static PyObject *hmac_key_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "key", NULL };
+    HmacKeyObject *self;
+    Py_buffer key;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "y*:HmacKey", keywords, &key))
+        return NULL;
+
+    self = (HmacKeyObject *)type->tp_alloc(type, 0);
+
+    if(self)
+        qrh_hmac_key_init(&self->key, key.buf, (size_t)key.len);
+
+    PyBuffer_Release(&key);
+    return (PyObject *)self;
+}
+
+static void hmac_key_dealloc(HmacKeyObject *self) {
+    qrh_wipe(&self->key, sizeof(self->key));
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *hmac_key_digest(HmacKeyObject *self, PyObject *data) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+    Py_buffer view;
+
+    if(qrh_py_get_buffer(data, &view) < 0)
+        return NULL;
+
+    qrh_py_hmac(&self->key, &view, digest);
+    PyBuffer_Release(&view);
+
+    return PyBytes_FromStringAndSize((const char *)digest, QRH_DIGEST_SIZE);
+}
+
+static PyObject *hmac_key_hexdigest(HmacKeyObject *self, PyObject *data) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+    Py_buffer view;
+
+    if(qrh_py_get_buffer(data, &view) < 0)
+        return NULL;
+
+    qrh_py_hmac(&self->key, &view, digest);
+    PyBuffer_Release(&view);
+
+    return qrh_py_hexdigest(digest);
+}
+
+static PyObject *hmac_key_digest_many(HmacKeyObject *self, PyObject *iterable) {
+    return qrh_py_hash_views(iterable, &self->key);
+}
+
+static PyObject *hmac_key_new_stream(HmacKeyObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "data", "length", NULL };
+    PyObject *data   = NULL;
+    PyObject *length = NULL;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|O$O:new", keywords, &data, &length))
+        return NULL;
+
+    return (PyObject *)qrh_py_create(data, length, &self->key);
+}
+
+static PyMethodDef hmac_key_methods[] = {
+    { "digest",      (PyCFunction)hmac_key_digest,      METH_O, "HMAC-QRH-256 of a bytes-like object." },
+    { "hexdigest",   (PyCFunction)hmac_key_hexdigest,   METH_O, "HMAC-QRH-256 of a bytes-like object, as hex." },
+    { "digest_many", (PyCFunction)hmac_key_digest_many, METH_O, "HMAC-QRH-256 of every object in an iterable." },
+    { "new",         (PyCFunction)(void (*)(void))hmac_key_new_stream, METH_VARARGS | METH_KEYWORDS,
+      "new(data=b'', *, length=None) -> hashlib-style HMAC object under this key.\n"
+      "Without length= every update() is buffered in memory until digest()." },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject HmacKeyType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name      = "qrh.HmacKey",
+    .tp_doc       = "HmacKey(key): HMAC pads derived once and reused for every message",
+    .tp_basicsize = sizeof(HmacKeyObject),
+    .tp_flags     = Py_TPFLAGS_DEFAULT,
+    .tp_new       = hmac_key_new,
+    .tp_dealloc   = (destructor)hmac_key_dealloc,
+    .tp_methods   = hmac_key_methods,
+};
+
+/* module functions */
+static PyObject *qrh_py_qrh_256(PyObject *module, PyObject *data) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+    Py_buffer view;
+
+    (void)module;
+
+    if(qrh_py_get_buffer(data, &view) < 0)
+        return NULL;
+
+    qrh_py_hash(&view, digest);
+    PyBuffer_Release(&view);
+
+    return PyBytes_FromStringAndSize((const char *)digest, QRH_DIGEST_SIZE);
+}
+
+static PyObject *qrh_py_hmac_func(PyObject *module, PyObject *args) {
+    uint8_t digest[QRH_DIGEST_SIZE];
+    qrh_hmac_key key;
+    Py_buffer key_view;
+    Py_buffer view;
+
+    (void)module;
+
+    if(!PyArg_ParseTuple(args, "y*y*:hmac", &key_view, &view))
+        return NULL;
+
+    qrh_hmac_key_init(&key, key_view.buf, (size_t)key_view.len);
+    qrh_py_hmac(&key, &view, digest);
+    qrh_wipe(&key, sizeof(key));
+
+    PyBuffer_Release(&key_view);
+    PyBuffer_Release(&view);
+
+    return PyBytes_FromStringAndSize((const char *)digest, QRH_DIGEST_SIZE);
+}
+
+static PyObject *qrh_py_hash_many(PyObject *module, PyObject *iterable) {
+    (void)module;
+    return qrh_py_hash_views(iterable, NULL);
+}
+
+static PyObject *qrh_py_new(PyObject *module, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = { "data", "length", NULL };
+    PyObject *data   = NULL;
+    PyObject *length = NULL;
+
+    (void)module;
+
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|O$O:new", keywords, &data, &length))
+        return NULL;
+
+    return (PyObject *)qrh_py_create(data, length, NULL);
+}
+
+static PyMethodDef qrh_module_methods[] = {
+    { "qrh_256",   qrh_py_qrh_256,   METH_O,       "qrh_256(data) -> 32-byte digest" },
+    { "hmac",      qrh_py_hmac_func, METH_VARARGS, "hmac(key, data) -> 32-byte HMAC-QRH-256" },
+    { "hash_many", qrh_py_hash_many, METH_O,       "hash_many(iterable) -> list of digests, multi-buffer" },
+    { "new",       (PyCFunction)(void (*)(void))qrh_py_new, METH_VARARGS | METH_KEYWORDS,
+      "new(data=b'', *, length=None) -> hashlib-style qrh256 object\n"
+      "Without length= every update() is buffered in memory until digest()." },
+    { NULL, NULL, 0, NULL }
+};
+
+static struct PyModuleDef qrh_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name    = "qrh",
+    .m_doc     = "QRH-256 hashing over the buffer protocol.\n\n"
+                 "QRH-256 mixes the total length into every block. Objects from new()\n"
+                 "and HmacKey.new() stream in constant memory only when created with\n"
+                 "length=; without it, update() keeps a copy of all data fed so far and\n"
+                 "digest() hashes it at the end, so memory grows with the input. Pass\n"
+                 "length= for files and streams, or hash a single buffer with qrh_256().",
+    .m_size    = -1,
+    .m_methods = qrh_module_methods,
+};
+
+PyMODINIT_FUNC PyInit_qrh(void) {
+    PyObject *module;
+
+    if(PyType_Ready(&QrhType) < 0 || PyType_Ready(&HmacKeyType) < 0)
+        return NULL;
+
+    module = PyModule_Create(&qrh_module);
+
+    if(!module)
+        return NULL;
+
+    Py_INCREF(&QrhType);
+    Py_INCREF(&HmacKeyType);
+
+    if(PyModule_AddObject(module, "qrh256", (PyObject *)&QrhType) < 0 ||
+       PyModule_AddObject(module, "HmacKey", (PyObject *)&HmacKeyType) < 0 ||
+       PyModule_AddIntConstant(module, "digest_size", QRH_DIGEST_SIZE) < 0 ||
+       PyModule_AddIntConstant(module, "gil_threshold", QRH_PY_GIL_THRESHOLD) < 0) {
+        Py_DECREF(module);
+        return NULL;
+    }
+
+    return module;
+}
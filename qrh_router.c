@@ -0,0 +1,274 @@
+/**
+ * qrh_router.c
+ *
+ * Features:
+ *   - Rendezvous scores are qrh_64_u64() of the key hash under a per-node
+ *     seed, so each score is two rounds of qrh_64's add3 mixer
+ *   - Per-node seed words are precomputed in lane-sized arrays; 8 nodes are
+ *     scored at once over GCC vector types (AVX2 or 2x SSE2)
+ *   - Batches put 8 keys in the lanes instead and keep a per-lane best
+ *   - Jump consistent hashing on the same key hash
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "qrh_256.h"
+#include "qrh_router.h"
+
+#define ROUTER_LANES 8
+
+typedef uint32_t router_vec __attribute__((vector_size(ROUTER_LANES * sizeof(uint32_t))));
+
+#define ROTL32V(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+/* qrh_64's seed and finish constants (qrh_256.c), so lane scores equal qrh_64_u64() */
+#define ROUTER_C0 0x6A09E667u
+#define ROUTER_C1 0xBB67AE85u
+#define ROUTER_C2 0x3C6EF372u
+#define ROUTER_C3 0xA54FF53Au
+#define ROUTER_C8 0xC1059ED8u
+#define ROUTER_C9 0x367CD507u
+
+struct qrh_router {
+    size_t count;
+    size_t padded;          /* count rounded up to whole vectors */
+    uint64_t seed;
+    uint64_t *ids;
+    uint32_t *seed_lo;      /* C0 ^ low word of the node's seed, per lane */
+    uint32_t *seed_hi;      /* C1 ^ high word */
+};
+
+/* lane-parallel copy of QRH_ADD3 in qrh_256.c, same operation order */
+static inline void router_add3(router_vec *a, router_vec *b, router_vec *c) {
+    *a += *c + *b;
+    *b += *a + *c;
+    *c += *a + *b;
+    *a += ROTL32V((*c), 19);
+    *b += ROTL32V((*a), 13);
+    *c += ROTL32V((*b), 8);
+}
+
+static inline void router_mix(router_vec s[4]) {
+    router_add3(&s[0], &s[1], &s[2]);
+    router_add3(&s[1], &s[2], &s[3]);
+    router_add3(&s[2], &s[3], &s[0]);
+}
+
+/* qrh_64_u64(value, seed) per lane, with the seed words already XORed into C0 and C1 */
+static inline void router_score(const router_vec *seed_lo, const router_vec *seed_hi, const router_vec *value_lo,
+                                const router_vec *value_hi, router_vec *hi, router_vec *lo) {
+    router_vec s[4];
+
+    /* qrh_64_seed() for an 8-byte input, then the value XORed in */
+    s[0] = *seed_lo ^ *value_lo;
+    s[1] = *seed_hi ^ *value_hi;
+    s[2] = (router_vec){ 0 } + (ROUTER_C2 ^ 8u);
+    s[3] = (router_vec){ 0 } + ROUTER_C3;
+
+    router_mix(s);
+    s[0] ^= ROUTER_C8;
+    s[3] ^= ROUTER_C9;
+    router_mix(s);
+
+    *hi = s[0] ^ s[2];
+    *lo = s[1] ^ s[3];
+}
+
+/* scores of nodes base .. base + 7 for one key, as high and low words */
+static inline void router_score8(const struct qrh_router *r, size_t base, uint64_t key_hash,
+                                 uint32_t hi[ROUTER_LANES], uint32_t lo[ROUTER_LANES]) {
+    router_vec seed_lo, seed_hi, value_lo, value_hi, vhi, vlo;
+
+    memcpy(&seed_lo, r->seed_lo + base, sizeof(router_vec));
+    memcpy(&seed_hi, r->seed_hi + base, sizeof(router_vec));
+    value_lo = (router_vec){ 0 } + (uint32_t)key_hash;
+    value_hi = (router_vec){ 0 } + (uint32_t)(key_hash >> 32);
+
+    router_score(&seed_lo, &seed_hi, &value_lo, &value_hi, &vhi, &vlo);
+
+    memcpy(hi, &vhi, sizeof(vhi));
+    memcpy(lo, &vlo, sizeof(vlo));
+}
+
+struct qrh_router *qrh_router_create(const uint64_t *node_ids, size_t count, uint64_t seed) {
+    struct qrh_router *r = calloc(1, sizeof(*r));
+
+    if(!r)
+        return NULL;
+
+    r->count  = count;
+    r->padded = (count + ROUTER_LANES - 1) / ROUTER_LANES * ROUTER_LANES;
+    r->seed   = seed;
+    r->ids    = malloc((count ? count : 1) * sizeof(*r->ids));
+    r->seed_lo = calloc(r->padded ? r->padded : 1, sizeof(*r->seed_lo));
+    r->seed_hi = calloc(r->padded ? r->padded : 1, sizeof(*r->seed_hi));
+
+    if(!r->ids || !r->seed_lo || !r->seed_hi) {
+        qrh_router_destroy(r);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+        uint64_t node_seed = qrh_64_u64(node_ids[i], seed);
+
+        r->ids[i]     = node_ids[i];
+        r->seed_lo[i] = ROUTER_C0 ^ (uint32_t)node_seed;
+        r->seed_hi[i] = ROUTER_C1 ^ (uint32_t)(node_seed >> 32);
+    }
+
+    return r;
+}
+
+void qrh_router_destroy(struct qrh_router *router) {
+    if(!router)
+        return;
+
+    free(router->ids);
+    free(router->seed_lo);
+    free(router->seed_hi);
+    free(router);
+}
+
+size_t qrh_router_nodes(const struct qrh_router *router) {
+    return router->count;
+}
+
+uint64_t qrh_router_node_id(const struct qrh_router *router, size_t index) {
+    return router->ids[index];
+}
+
+uint64_t qrh_router_key(const struct qrh_router *router, const void *key, size_t len) {
+    return qrh_64(key, len, router->seed);
+}
+
+size_t qrh_router_hrw(const struct qrh_router *router, uint64_t key_hash) {
+    uint64_t best_score = 0;
+    size_t best = 0;
+
+    for(size_t base = 0; base < router->count; base += ROUTER_LANES) {
+        uint32_t hi[ROUTER_LANES], lo[ROUTER_LANES];
+        size_t lanes = router->count - base < ROUTER_LANES ? router->count - base : ROUTER_LANES;
+
+        router_score8(router, base, key_hash, hi, lo);
+
+        for(size_t l = 0; l < lanes; l++) {
+            uint64_t score = (uint64_t)hi[l] << 32 | lo[l];
+
+            if(score > best_score || base + l == 0) {
+                best_score = score;
+                best       = base + l;
+            }
+        }
+    }
+
+    return best;
+}
+
+size_t qrh_router_hrw_top(const struct qrh_router *router, uint64_t key_hash, size_t k, size_t *out) {
+    uint64_t *scores;
+    size_t found = 0;
+
+    if(k > router->count)
+        k = router->count;
+
+    if(k == 0)
+        return 0;
+
+    if(k == 1) {
+        out[0] = qrh_router_hrw(router, key_hash);
+        return 1;
+    }
+
+    scores = malloc(k * sizeof(*scores));
+
+    if(!scores)
+        return 0;
+
+    /* insertion into the sorted best-k list; strict comparisons keep ties on the lower index */
+    for(size_t base = 0; base < router->count; base += ROUTER_LANES) {
+        uint32_t hi[ROUTER_LANES], lo[ROUTER_LANES];
+        size_t lanes = router->count - base < ROUTER_LANES ? router->count - base : ROUTER_LANES;
+
+        router_score8(router, base, key_hash, hi, lo);
+
+        for(size_t l = 0; l < lanes; l++) {
+            uint64_t score = (uint64_t)hi[l] << 32 | lo[l];
+            size_t at;
+
+            if(found == k && score <= scores[k - 1])
+                continue;
+
+            at = found < k ? found++ : k - 1;
+
+            while(at > 0 && score > scores[at - 1]) {
+                scores[at] = scores[at - 1];
+                out[at]    = out[at - 1];
+                at--;
+            }
+
+            scores[at] = score;
+            out[at]    = base + l;
+        }
+    }
+
+    free(scores);
+    return found;
+}
+
+/*
+ * Eight keys per vector against one node at a time, so small node sets
+ * waste no lanes. The running best is kept per lane with compare and blend.
+ */
+void qrh_router_hrw_batch(const struct qrh_router *router, const uint64_t *key_hashes, size_t n, size_t *out) {
+    for(size_t first = 0; first < n; first += ROUTER_LANES) {
+        size_t keys = n - first < ROUTER_LANES ? n - first : ROUTER_LANES;
+        uint32_t klo[ROUTER_LANES] = { 0 }, khi[ROUTER_LANES] = { 0 }, best[ROUTER_LANES];
+        router_vec value_lo, value_hi, best_hi = { 0 }, best_lo = { 0 }, best_node = { 0 };
+
+        for(size_t l = 0; l < keys; l++) {
+            klo[l] = (uint32_t)key_hashes[first + l];
+            khi[l] = (uint32_t)(key_hashes[first + l] >> 32);
+        }
+
+        memcpy(&value_lo, klo, sizeof(value_lo));
+        memcpy(&value_hi, khi, sizeof(value_hi));
+
+        for(size_t node = 0; node < router->count; node++) {
+            router_vec seed_lo = (router_vec){ 0 } + router->seed_lo[node];
+            router_vec seed_hi = (router_vec){ 0 } + router->seed_hi[node];
+            router_vec hi, lo, better;
+
+            router_score(&seed_lo, &seed_hi, &value_lo, &value_hi, &hi, &lo);
+
+            /* unsigned 64-bit greater-than from 32-bit halves; node 0 always takes the lane */
+            better = (router_vec)((hi > best_hi) | ((hi == best_hi) & (lo > best_lo)));
+
+            if(node == 0)
+                better = (router_vec){ 0 } - 1;
+
+            best_hi   = (hi & better) | (best_hi & ~better);
+            best_lo   = (lo & better) | (best_lo & ~better);
+            best_node = (((router_vec){ 0 } + (uint32_t)node) & better) | (best_node & ~better);
+        }
+
+        memcpy(best, &best_node, sizeof(best));
+
+        for(size_t l = 0; l < keys; l++)
+            out[first + l] = best[l];
+    }
+}
+
+uint32_t qrh_jump(uint64_t key_hash, uint32_t buckets) {
+    int64_t b = -1, j = 0;
+
+    while(j < (int64_t)buckets) {
+        b = j;
+        key_hash = key_hash * 2862933555777941757ULL + 1;
+        j = (int64_t)((double)(b + 1) * ((double)(1LL << 31) / (double)((key_hash >> 33) + 1)));
+    }
+
+    return (uint32_t)b;
+}
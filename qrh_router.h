@@ -0,0 +1,41 @@
+#ifndef QRH_ROUTER_H
+#define QRH_ROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Key-to-node routing on qrh_64():
+ *   - jump consistent hashing: buckets 0..n-1, no state, moves 1/n of the keys
+ *     when a bucket is appended
+ *   - rendezvous (highest random weight): any node set, moves only the keys
+ *     of a node that leaves; the score of key k on node n is
+ *     qrh_64_u64(qrh_64(k), qrh_64_u64(node_id, seed)), evaluated for 8
+ *     nodes at a time in SIMD lanes
+ */
+
+struct qrh_router;
+
+/* NULL with errno set on failure; node ids are copied */
+struct qrh_router *qrh_router_create(const uint64_t *node_ids, size_t count, uint64_t seed);
+void qrh_router_destroy(struct qrh_router *router);
+
+size_t qrh_router_nodes(const struct qrh_router *router);
+uint64_t qrh_router_node_id(const struct qrh_router *router, size_t index);
+
+/* key hash shared by every selection below */
+uint64_t qrh_router_key(const struct qrh_router *router, const void *key, size_t len);
+
+/* index of the node with the highest score, ties to the lower index */
+size_t qrh_router_hrw(const struct qrh_router *router, uint64_t key_hash);
+
+/* the `k` best nodes for replicas, best first; returns how many were written */
+size_t qrh_router_hrw_top(const struct qrh_router *router, uint64_t key_hash, size_t k, size_t *out);
+
+/* qrh_router_hrw() for `n` key hashes */
+void qrh_router_hrw_batch(const struct qrh_router *router, const uint64_t *key_hashes, size_t n, size_t *out);
+
+/* Lamping and Veach's jump consistent hash */
+uint32_t qrh_jump(uint64_t key_hash, uint32_t buckets);
+
+#endif
@@ -0,0 +1,185 @@
+/**
+ * qrh_router_bench.c
+ *
+ * Features:
+ *   - Keys per second routed by qrh_router for 10, 100 and 1000 nodes
+ *   - Jump hashing, SIMD rendezvous per key and batched, next to scalar
+ *     rendezvous on qrh_64_u64() and on qrh_256() as the baseline
+ *   - Node counts from the command line replace the default sweep
+ *
+ *   cc -O2 -mavx2 qrh_router_bench.c qrh_router.c qrh_256.c -o qrh_router_bench
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "qrh_256.h"
+#include "qrh_router.h"
+
+#define ROUTER_BENCH_KEYS   4096
+#define ROUTER_BENCH_SEED   0x5EEDu
+#define ROUTER_BENCH_MAX    16
+
+enum { BENCH_JUMP, BENCH_HRW, BENCH_BATCH, BENCH_SCALAR, BENCH_QRH256, BENCH_METHODS };
+
+static const char *const router_bench_names[BENCH_METHODS] = {
+    "jump", "hrw simd", "hrw batch", "hrw scalar", "hrw qrh_256"
+};
+
+static double router_bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* per-node qrh_64_u64() without the lane layout */
+static size_t router_bench_scalar(const uint64_t *node_seeds, size_t count, uint64_t key_hash) {
+    uint64_t best_score = 0;
+    size_t best = 0;
+
+    for(size_t i = 0; i < count; i++) {
+        uint64_t score = qrh_64_u64(key_hash, node_seeds[i]);
+
+        if(score > best_score || i == 0) {
+            best_score = score;
+            best       = i;
+        }
+    }
+
+    return best;
+}
+
+/* a full qrh_256() of key || node id per node */
+static size_t router_bench_qrh256(const uint64_t *ids, size_t count, uint64_t key_hash) {
+    uint8_t best_digest[32], digest[32], input[16];
+    size_t best = 0;
+
+    memcpy(input, &key_hash, 8);
+
+    for(size_t i = 0; i < count; i++) {
+        memcpy(input + 8, &ids[i], 8);
+        qrh_256(input, sizeof(input), digest);
+
+        if(i == 0 || memcmp(digest, best_digest, sizeof(digest)) > 0) {
+            memcpy(best_digest, digest, sizeof(digest));
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+static double router_bench_run(int method, const struct qrh_router *router, const uint64_t *ids,
+                               const uint64_t *node_seeds, size_t count, const uint64_t *keys, double seconds) {
+    size_t out[ROUTER_BENCH_KEYS];
+    volatile size_t sink = 0;
+    unsigned long long routed = 0;
+    double t0 = router_bench_now(), elapsed;
+
+    do {
+        switch(method) {
+        case BENCH_JUMP:
+            for(size_t k = 0; k < ROUTER_BENCH_KEYS; k++)
+                sink += qrh_jump(keys[k], (uint32_t)count);
+            break;
+        case BENCH_HRW:
+            for(size_t k = 0; k < ROUTER_BENCH_KEYS; k++)
+                sink += qrh_router_hrw(router, keys[k]);
+            break;
+        case BENCH_BATCH:
+            qrh_router_hrw_batch(router, keys, ROUTER_BENCH_KEYS, out);
+            sink += out[0];
+            break;
+        case BENCH_SCALAR:
+            for(size_t k = 0; k < ROUTER_BENCH_KEYS; k++)
+                sink += router_bench_scalar(node_seeds, count, keys[k]);
+            break;
+        default:
+            for(size_t k = 0; k < ROUTER_BENCH_KEYS; k++)
+                sink += router_bench_qrh256(ids, count, keys[k]);
+            break;
+        }
+
+        routed += ROUTER_BENCH_KEYS;
+        elapsed = router_bench_now() - t0;
+    } while(elapsed < seconds);
+
+    (void)sink;
+    return (double)routed / elapsed;
+}
+
+int main(int argc, char **argv) {
+    unsigned long nodes[ROUTER_BENCH_MAX] = { 10, 100, 1000 };
+    size_t nnodes  = 3;
+    double seconds = 0.3;
+    int custom     = 0;
+    uint64_t keys[ROUTER_BENCH_KEYS];
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if(argv[i][0] != '-' && nnodes < ROUTER_BENCH_MAX) {
+            if(!custom) {
+                custom = 1;
+                nnodes = 0;
+            }
+
+            nodes[nnodes++] = strtoul(argv[i], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [-s SECONDS] [NODES ...]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for(size_t k = 0; k < ROUTER_BENCH_KEYS; k++)
+        keys[k] = qrh_64_u64(k, ROUTER_BENCH_SEED);
+
+    printf("%-8s", "nodes");
+
+    for(int m = 0; m < BENCH_METHODS; m++)
+        printf(" %14s", router_bench_names[m]);
+
+    printf("   (keys/s)\n");
+
+    for(size_t n = 0; n < nnodes; n++) {
+        size_t count = nodes[n] ? nodes[n] : 1;
+        uint64_t *ids = malloc(count * sizeof(*ids));
+        uint64_t *node_seeds = malloc(count * sizeof(*node_seeds));
+        struct qrh_router *router;
+
+        if(!ids || !node_seeds) {
+            perror("malloc");
+            return 1;
+        }
+
+        for(size_t i = 0; i < count; i++) {
+            ids[i]        = 0x1000 + i;
+            node_seeds[i] = qrh_64_u64(ids[i], ROUTER_BENCH_SEED);
+        }
+
+        router = qrh_router_create(ids, count, ROUTER_BENCH_SEED);
+
+        if(!router) {
+            perror("qrh_router_create");
+            return 1;
+        }
+
+        printf("%-8zu", count);
+
+        for(int m = 0; m < BENCH_METHODS; m++) {
+            printf(" %14.3e", router_bench_run(m, router, ids, node_seeds, count, keys, seconds));
+            fflush(stdout);
+        }
+
+        printf("\n");
+
+        qrh_router_destroy(router);
+        free(node_seeds);
+        free(ids);
+    }
+
+    return 0;
+}
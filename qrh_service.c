@@ -0,0 +1,545 @@
+/**
+ * qrh_service.c
+ *
+ * Features:
+ *   - Latency and bulk classes so small requests never queue behind big ones
+ *   - Latency requests (plain and HMAC) share qrh_256_multi() lanes, with a
+ *     microsecond deadline bounding how long a batch waits to fill up
+ *   - Bulk requests stream through qrh_ctx one chunk at a time, latency
+ *     batches are picked up between chunks
+ *   - Per-class queue depth and latency percentiles from a log histogram
+ *   - No threads of its own: up to `workers` draining tasks run on a qrh_pool
+ *     and return to it as soon as nothing is runnable
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_pool.h"
+#include "qrh_service.h"
+
+#define SERVICE_HASH_SIZE    32
+#define SERVICE_BLOCK_SIZE   64
+#define SERVICE_HIST_BUCKETS 256
+#define SERVICE_BATCH_MAX    256
+
+struct service_request {
+    const uint8_t *data;
+    size_t len;
+    int keyed;
+    qrh_hmac_key key;
+    qrh_service_done_fn done;
+    void *user;
+    uint64_t submitted_ns;
+
+    /* bulk only */
+    qrh_ctx ctx;
+    size_t offset;
+    int busy;
+
+    struct service_request *next;
+};
+
+struct service_queue {
+    struct service_request *head;
+    struct service_request *tail;
+    size_t count;
+};
+
+struct service_class {
+    struct service_queue queue;
+    size_t queued;     /* queued plus in progress */
+    uint64_t completed;
+    uint64_t max_ns;
+    uint64_t hist[SERVICE_HIST_BUCKETS];
+};
+
+/* slot i < latency_workers never takes bulk work */
+struct service_slot {
+    struct qrh_service *svc;
+    unsigned index;
+    int busy;
+};
+
+struct qrh_service {
+    struct qrh_service_config cfg;
+    struct qrh_pool *pool;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work;  /* wakes the task waiting out a batch deadline */
+    pthread_cond_t idle;  /* the last draining task returned */
+    int stopping;
+    int timer;            /* a task is waiting out a batch deadline */
+    unsigned running;
+
+    struct service_class classes[QRH_SERVICE_CLASSES];
+    struct service_slot *slots;
+};
+
+static uint64_t service_now_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/* 4 buckets per power of two: ~19% resolution at any scale */
+static unsigned service_bucket(uint64_t ns) {
+    if(ns < 8)
+        return (unsigned)ns;
+
+    unsigned msb = 63u - (unsigned)__builtin_clzll(ns);
+
+    return (msb - 1) * 4 + (unsigned)((ns >> (msb - 2)) & 3);
+}
+
+static uint64_t service_bucket_upper(unsigned idx) {
+    if(idx < 8)
+        return idx;
+
+    unsigned msb = idx / 4 + 1;
+    uint64_t sub = idx % 4;
+
+    return ((4 + sub) << (msb - 2)) + (1ull << (msb - 2)) - 1;
+}
+
+static uint64_t service_percentile(const struct service_class *c, double q) {
+    uint64_t want = (uint64_t)((double)c->completed * q);
+    uint64_t seen = 0;
+
+    if(c->completed == 0)
+        return 0;
+
+    for(unsigned i = 0; i < SERVICE_HIST_BUCKETS; i++) {
+        seen += c->hist[i];
+
+        if(seen > want)
+            return service_bucket_upper(i);
+    }
+
+    return c->max_ns;
+}
+
+/* a request holds a copy of the HMAC pads, and a bulk one the keyed inner state */
+static void service_free_request(struct service_request *req) {
+    if(req->keyed) {
+        qrh_wipe(&req->key, sizeof(req->key));
+        qrh_wipe(&req->ctx, sizeof(req->ctx));
+    }
+
+    free(req);
+}
+
+static void service_push(struct service_queue *q, struct service_request *req) {
+    req->next = NULL;
+
+    if(q->tail)
+        q->tail->next = req;
+    else
+        q->head = req;
+
+    q->tail = req;
+    q->count++;
+}
+
+static void service_unlink(struct service_queue *q, struct service_request *req) {
+    struct service_request **link = &q->head;
+    struct service_request *prev  = NULL;
+
+    while(*link != req) {
+        prev = *link;
+        link = &(*link)->next;
+    }
+
+    *link = req->next;
+
+    if(q->tail == req)
+        q->tail = prev;
+
+    q->count--;
+}
+
+/* called with the lock held */
+static void service_complete(struct qrh_service *svc, enum qrh_service_class cls, uint64_t submitted_ns, uint64_t now) {
+    struct service_class *c = &svc->classes[cls];
+    uint64_t ns = now - submitted_ns;
+
+    c->queued--;
+    c->completed++;
+    c->hist[service_bucket(ns)]++;
+
+    if(ns > c->max_ns)
+        c->max_ns = ns;
+}
+
+/* one multi-buffer pass for plain requests, two (inner, outer) for HMAC */
+static void service_run_batch(struct service_request **batch, size_t n) {
+    const uint8_t *inputs[n ? n : 1];
+    size_t lens[n ? n : 1];
+    uint8_t digests[(n ? n : 1) * SERVICE_HASH_SIZE];
+    size_t scratch_len = 0;
+    size_t keyed       = 0;
+
+    for(size_t i = 0; i < n; i++) {
+        if(batch[i]->keyed) {
+            scratch_len += SERVICE_BLOCK_SIZE + batch[i]->len;
+            keyed++;
+        }
+    }
+
+    uint8_t *scratch = keyed ? malloc(scratch_len + keyed * (SERVICE_BLOCK_SIZE + SERVICE_HASH_SIZE)) : NULL;
+    uint8_t *outer   = scratch ? scratch + scratch_len : NULL;
+
+    for(size_t i = 0, off = 0; i < n; i++) {
+        struct service_request *req = batch[i];
+
+        if(req->keyed && scratch) {
+            /* inner message ipad || data, contiguous for the lanes */
+            memcpy(scratch + off, req->key.in_padding, SERVICE_BLOCK_SIZE);
+            memcpy(scratch + off + SERVICE_BLOCK_SIZE, req->data, req->len);
+            inputs[i] = scratch + off;
+            lens[i]   = SERVICE_BLOCK_SIZE + req->len;
+            off      += lens[i];
+        } else {
+            inputs[i] = req->data;
+            lens[i]   = req->len;
+        }
+    }
+
+    qrh_256_multi(inputs, lens, n, digests);
+
+    if(keyed) {
+        const uint8_t *outer_inputs[n];
+        size_t outer_lens[n];
+        uint8_t outer_digests[n * SERVICE_HASH_SIZE];
+        size_t m = 0;
+
+        for(size_t i = 0; i < n; i++) {
+            if(!batch[i]->keyed)
+                continue;
+
+            if(!scratch) {
+                /* no scratch memory: fall back to the one-at-a-time HMAC */
+                qrh_256_hmac_with_key(&batch[i]->key, batch[i]->data, batch[i]->len, digests + i * SERVICE_HASH_SIZE);
+                continue;
+            }
+
+            uint8_t *o = outer + m * (SERVICE_BLOCK_SIZE + SERVICE_HASH_SIZE);
+
+            memcpy(o, batch[i]->key.out_padding, SERVICE_BLOCK_SIZE);
+            memcpy(o + SERVICE_BLOCK_SIZE, digests + i * SERVICE_HASH_SIZE, SERVICE_HASH_SIZE);
+            outer_inputs[m] = o;
+            outer_lens[m]   = SERVICE_BLOCK_SIZE + SERVICE_HASH_SIZE;
+            m++;
+        }
+
+        if(m) {
+            qrh_256_multi(outer_inputs, outer_lens, m, outer_digests);
+
+            for(size_t i = 0, j = 0; i < n; i++) {
+                if(batch[i]->keyed)
+                    memcpy(digests + i * SERVICE_HASH_SIZE, outer_digests + j++ * SERVICE_HASH_SIZE, SERVICE_HASH_SIZE);
+            }
+        }
+
+        /* pads and inner digests, wiped with the copied data */
+        if(scratch)
+            qrh_wipe(scratch, scratch_len + keyed * (SERVICE_BLOCK_SIZE + SERVICE_HASH_SIZE));
+
+        free(scratch);
+    }
+
+    for(size_t i = 0; i < n; i++)
+        batch[i]->done(batch[i]->user, digests + i * SERVICE_HASH_SIZE);
+}
+
+/* one bulk chunk; returns 1 once the request is complete */
+static int service_run_chunk(struct qrh_service *svc, struct service_request *req) {
+    size_t take = req->len - req->offset;
+
+    if(take > svc->cfg.bulk_chunk)
+        take = svc->cfg.bulk_chunk;
+
+    qrh_update(&req->ctx, req->data + req->offset, take);
+    req->offset += take;
+
+    if(req->offset < req->len)
+        return 0;
+
+    uint8_t digest[SERVICE_HASH_SIZE];
+
+    qrh_final(&req->ctx, digest);
+
+    if(req->keyed) {
+        uint8_t outer[SERVICE_BLOCK_SIZE + SERVICE_HASH_SIZE];
+
+        memcpy(outer, req->key.out_padding, SERVICE_BLOCK_SIZE);
+        memcpy(outer + SERVICE_BLOCK_SIZE, digest, SERVICE_HASH_SIZE);
+        qrh_256(outer, sizeof(outer), digest);
+        qrh_wipe(outer, sizeof(outer));
+    }
+
+    req->done(req->user, digest);
+    return 1;
+}
+
+static void service_wait_until(struct qrh_service *svc, uint64_t deadline_ns) {
+    struct timespec ts = {
+        .tv_sec  = (time_t)(deadline_ns / 1000000000ull),
+        .tv_nsec = (long)(deadline_ns % 1000000000ull)
+    };
+
+    pthread_cond_timedwait(&svc->work, &svc->lock, &ts);
+}
+
+/* pool task: runs whatever is due, returns once nothing is runnable */
+static void service_drain(void *arg) {
+    struct service_slot *slot     = arg;
+    struct qrh_service *svc       = slot->svc;
+    const int takes_bulk          = slot->index >= svc->cfg.latency_workers;
+    struct service_class *latency = &svc->classes[QRH_SERVICE_LATENCY];
+    struct service_class *bulk    = &svc->classes[QRH_SERVICE_BULK];
+    struct service_request *batch[SERVICE_BATCH_MAX];
+
+    pthread_mutex_lock(&svc->lock);
+
+    for(;;) {
+        uint64_t now = service_now_ns();
+        struct service_queue *lq = &latency->queue;
+
+        /* latency work first: a full batch, an expired deadline, or draining */
+        if(lq->count && (lq->count >= svc->cfg.batch_max || svc->stopping ||
+                         now >= lq->head->submitted_ns + svc->cfg.deadline_us * 1000ull)) {
+            size_t n = 0;
+
+            while(lq->head && n < svc->cfg.batch_max) {
+                struct service_request *req = lq->head;
+
+                service_unlink(lq, req);
+                batch[n++] = req;
+            }
+
+            pthread_mutex_unlock(&svc->lock);
+            service_run_batch(batch, n);
+            now = service_now_ns();
+            pthread_mutex_lock(&svc->lock);
+
+            for(size_t i = 0; i < n; i++) {
+                service_complete(svc, QRH_SERVICE_LATENCY, batch[i]->submitted_ns, now);
+                service_free_request(batch[i]);
+            }
+
+            continue;
+        }
+
+        struct service_request *req = NULL;
+
+        if(takes_bulk) {
+            for(req = bulk->queue.head; req && req->busy; req = req->next)
+                ;
+        }
+
+        if(req) {
+            req->busy = 1;
+            pthread_mutex_unlock(&svc->lock);
+
+            int finished = service_run_chunk(svc, req);
+
+            pthread_mutex_lock(&svc->lock);
+            req->busy = 0;
+
+            if(finished) {
+                service_unlink(&bulk->queue, req);
+                service_complete(svc, QRH_SERVICE_BULK, req->submitted_ns, service_now_ns());
+                service_free_request(req);
+            }
+
+            continue;
+        }
+
+        /* one task waits out the batch deadline, the others go back to the pool */
+        if(lq->count && !svc->timer) {
+            svc->timer = 1;
+            service_wait_until(svc, lq->head->submitted_ns + svc->cfg.deadline_us * 1000ull);
+            svc->timer = 0;
+            continue;
+        }
+
+        break;
+    }
+
+    slot->busy = 0;
+
+    if(--svc->running == 0)
+        pthread_cond_broadcast(&svc->idle);
+
+    pthread_mutex_unlock(&svc->lock);
+}
+
+/* called with the lock held; the caller submits the returned slot once unlocked */
+static struct service_slot *service_claim_slot(struct qrh_service *svc, enum qrh_service_class cls) {
+    unsigned first = cls == QRH_SERVICE_BULK ? svc->cfg.latency_workers : 0;
+
+    for(unsigned i = first; i < svc->cfg.workers; i++) {
+        if(!svc->slots[i].busy) {
+            svc->slots[i].busy = 1;
+            svc->running++;
+            return &svc->slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+struct qrh_service *qrh_service_create(const struct qrh_service_config *cfg) {
+    struct qrh_service *svc = calloc(1, sizeof(*svc));
+    pthread_condattr_t attr;
+
+    if(!svc)
+        return NULL;
+
+    if(cfg)
+        svc->cfg = *cfg;
+
+    svc->pool = svc->cfg.pool ? svc->cfg.pool : qrh_pool_default();
+
+    if(svc->cfg.workers == 0)
+        svc->cfg.workers = qrh_pool_threads(svc->pool);
+
+    if(svc->cfg.latency_workers == 0 || svc->cfg.latency_workers >= svc->cfg.workers)
+        svc->cfg.latency_workers = svc->cfg.workers > 1 ? 1 : 0;
+
+    if(svc->cfg.deadline_us == 0)
+        svc->cfg.deadline_us = 50;
+
+    if(svc->cfg.batch_max == 0)
+        svc->cfg.batch_max = 64;
+
+    if(svc->cfg.batch_max > SERVICE_BATCH_MAX)
+        svc->cfg.batch_max = SERVICE_BATCH_MAX;
+
+    if(svc->cfg.small_limit == 0)
+        svc->cfg.small_limit = 64u << 10;
+
+    if(svc->cfg.bulk_chunk == 0)
+        svc->cfg.bulk_chunk = 256u << 10;
+
+    svc->slots = calloc(svc->cfg.workers, sizeof(*svc->slots));
+
+    if(!svc->slots) {
+        free(svc);
+        return NULL;
+    }
+
+    for(unsigned i = 0; i < svc->cfg.workers; i++) {
+        svc->slots[i].svc   = svc;
+        svc->slots[i].index = i;
+    }
+
+    pthread_mutex_init(&svc->lock, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&svc->work, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_cond_init(&svc->idle, NULL);
+
+    return svc;
+}
+
+int qrh_service_submit(struct qrh_service *svc, const uint8_t *data, size_t len,
+                       const qrh_hmac_key *key, qrh_service_done_fn done, void *user) {
+    struct service_request *req = calloc(1, sizeof(*req));
+    enum qrh_service_class cls  = len <= svc->cfg.small_limit ? QRH_SERVICE_LATENCY : QRH_SERVICE_BULK;
+
+    if(!req)
+        return -1;
+
+    req->data = data;
+    req->len  = len;
+    req->done = done;
+    req->user = user;
+
+    if(key) {
+        req->keyed = 1;
+        req->key   = *key;
+    }
+
+    if(cls == QRH_SERVICE_BULK) {
+        /* inner HMAC hash runs over ipad || data */
+        if(key) {
+            qrh_init(&req->ctx, SERVICE_BLOCK_SIZE + len);
+            qrh_update(&req->ctx, key->in_padding, SERVICE_BLOCK_SIZE);
+        } else {
+            qrh_init(&req->ctx, len);
+        }
+    }
+
+    pthread_mutex_lock(&svc->lock);
+
+    if(svc->stopping) {
+        pthread_mutex_unlock(&svc->lock);
+        service_free_request(req);
+        errno = ESHUTDOWN;
+        return -1;
+    }
+
+    req->submitted_ns = service_now_ns();
+    service_push(&svc->classes[cls].queue, req);
+    svc->classes[cls].queued++;
+
+    /* with every slot taken, the running tasks pick it up between pieces of work */
+    struct service_slot *slot = service_claim_slot(svc, cls);
+
+    if(!slot)
+        pthread_cond_signal(&svc->work);
+
+    pthread_mutex_unlock(&svc->lock);
+
+    if(slot && qrh_pool_submit(svc->pool, service_drain, slot) < 0)
+        service_drain(slot);
+
+    return 0;
+}
+
+void qrh_service_stats(struct qrh_service *svc, struct qrh_service_stats *out) {
+    pthread_mutex_lock(&svc->lock);
+
+    for(int i = 0; i < QRH_SERVICE_CLASSES; i++) {
+        const struct service_class *c = &svc->classes[i];
+
+        out->classes[i].queued    = c->queued;
+        out->classes[i].completed = c->completed;
+        out->classes[i].p50_ns    = service_percentile(c, 0.50);
+        out->classes[i].p99_ns    = service_percentile(c, 0.99);
+        out->classes[i].max_ns    = c->max_ns;
+    }
+
+    pthread_mutex_unlock(&svc->lock);
+}
+
+void qrh_service_destroy(struct qrh_service *svc) {
+    if(!svc)
+        return;
+
+    pthread_mutex_lock(&svc->lock);
+    svc->stopping = 1;
+    pthread_cond_broadcast(&svc->work);
+
+    while(svc->running)
+        pthread_cond_wait(&svc->idle, &svc->lock);
+
+    pthread_mutex_unlock(&svc->lock);
+
+    pthread_mutex_destroy(&svc->lock);
+    pthread_cond_destroy(&svc->work);
+    pthread_cond_destroy(&svc->idle);
+    free(svc->slots);
+    free(svc);
+}
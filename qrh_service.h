@@ -0,0 +1,68 @@
+#ifndef QRH_SERVICE_H
+#define QRH_SERVICE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+
+/*
+ * In-process hashing service with two classes of work:
+ *   - latency: requests up to `small_limit` bytes, batched into multi-buffer
+ *     lanes and dispatched when the batch is full or `deadline_us` expires
+ *   - bulk: larger requests, streamed in `bulk_chunk` pieces; a worker checks
+ *     for latency work between pieces
+ * Workers are tasks on a qrh_pool, started when work arrives.
+ */
+
+enum qrh_service_class {
+    QRH_SERVICE_LATENCY,
+    QRH_SERVICE_BULK,
+    QRH_SERVICE_CLASSES
+};
+
+struct qrh_service_config {
+    struct qrh_pool *pool;     /* NULL: qrh_pool_default() */
+    unsigned workers;          /* most tasks on the pool at once, 0: pool threads */
+    unsigned latency_workers;  /* workers that never take bulk work, default 1 when workers > 1 */
+    unsigned deadline_us;      /* batching deadline for latency work, default 50 */
+    size_t batch_max;          /* latency requests per batch, default 64, at most 256 */
+    size_t small_limit;        /* largest latency-class request, default 64 KiB */
+    size_t bulk_chunk;         /* bulk bytes hashed between yields, default 256 KiB */
+};
+
+struct qrh_service_class_stats {
+    size_t queued;             /* submitted, not yet completed */
+    uint64_t completed;
+    uint64_t p50_ns;           /* submit to completion, histogram bucket upper bounds */
+    uint64_t p99_ns;
+    uint64_t max_ns;
+};
+
+struct qrh_service_stats {
+    struct qrh_service_class_stats classes[QRH_SERVICE_CLASSES];
+};
+
+/* runs on a worker thread once `data` is no longer needed */
+typedef void (*qrh_service_done_fn)(void *user, const uint8_t digest[32]);
+
+struct qrh_service;
+
+/* `cfg` may be NULL for defaults; NULL with errno set on failure */
+struct qrh_service *qrh_service_create(const struct qrh_service_config *cfg);
+
+/*
+ * Queues a digest of `data`, or HMAC-QRH-256 under `key` when it is not NULL.
+ * `data` must stay valid until `done` runs; the key is copied. 0 or -1 with
+ * errno set (ENOMEM, or ESHUTDOWN once destroy has begun).
+ */
+int qrh_service_submit(struct qrh_service *svc, const uint8_t *data, size_t len,
+                       const qrh_hmac_key *key, qrh_service_done_fn done, void *user);
+
+void qrh_service_stats(struct qrh_service *svc, struct qrh_service_stats *out);
+
+/* completes everything already submitted, then stops the workers */
+void qrh_service_destroy(struct qrh_service *svc);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * qrh_sketch.c
+ *
+ * Features:
+ *   - One qrh_64() per shingle, batched through qrh_64_multi()
+ *   - MinHash slot values derived from that hash 8 slots at a time over GCC
+ *     vector types, with the running minimum kept in registers across a batch
+ *   - LSH band keys and the banding S-curve
+ *   - SimHash with 64 weighted bit counters updated 8 at a time
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "qrh_256.h"
+#include "qrh_multi.h"
+#include "qrh_sketch.h"
+
+#define SKETCH_LANES 8
+#define SKETCH_BATCH 256                 /* shingles hashed per multi call */
+
+typedef uint32_t sketch_vec __attribute__((vector_size(SKETCH_LANES * sizeof(uint32_t))));
+typedef int64_t sketch_wide __attribute__((vector_size(SKETCH_LANES * sizeof(int64_t))));
+
+/* slot value: salted, then a multiply-xorshift finalizer (murmur3 fmix32) */
+#define SKETCH_DERIVE(x, lo, hi, salt) \
+    do { \
+        (x) = ((lo) ^ (salt)) * 0x9E3779B1u; \
+        (x) ^= (hi); \
+        (x) ^= (x) >> 16; \
+        (x) *= 0x85EBCA6Bu; \
+        (x) ^= (x) >> 13; \
+        (x) *= 0xC2B2AE35u; \
+        (x) ^= (x) >> 16; \
+    } while(0)
+
+static void sketch_min_hashes(qrh_minhash *mh, const uint64_t *hashes, size_t count) {
+    unsigned g = 0;
+
+    for(; g + SKETCH_LANES <= mh->k; g += SKETCH_LANES) {
+        sketch_vec m, salt;
+
+        memcpy(&m, mh->mins + g, sizeof(m));
+        memcpy(&salt, mh->salt + g, sizeof(salt));
+
+        for(size_t i = 0; i < count; i++) {
+            sketch_vec lo = (sketch_vec){ 0 } + (uint32_t)hashes[i];
+            sketch_vec hi = (sketch_vec){ 0 } + (uint32_t)(hashes[i] >> 32);
+            sketch_vec x, less;
+
+            SKETCH_DERIVE(x, lo, hi, salt);
+            less = (sketch_vec)(x < m);
+            m    = (x & less) | (m & ~less);
+        }
+
+        memcpy(mh->mins + g, &m, sizeof(m));
+    }
+
+    /* k not a multiple of the lane count */
+    for(; g < mh->k; g++) {
+        for(size_t i = 0; i < count; i++) {
+            uint32_t x;
+
+            SKETCH_DERIVE(x, (uint32_t)hashes[i], (uint32_t)(hashes[i] >> 32), mh->salt[g]);
+
+            if(x < mh->mins[g])
+                mh->mins[g] = x;
+        }
+    }
+}
+
+int qrh_minhash_init(qrh_minhash *mh, unsigned k, uint64_t seed) {
+    if(k == 0 || k > QRH_MINHASH_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    memset(mh, 0, sizeof(*mh));
+    mh->k    = k;
+    mh->seed = seed;
+
+    for(unsigned i = 0; i < k; i++) {
+        mh->salt[i] = (uint32_t)qrh_64_u64(i, seed);
+        mh->mins[i] = UINT32_MAX;
+    }
+
+    return 0;
+}
+
+void qrh_minhash_add(qrh_minhash *mh, const uint8_t *shingle, size_t len) {
+    uint64_t hash = qrh_64(shingle, len, mh->seed);
+
+    sketch_min_hashes(mh, &hash, 1);
+}
+
+void qrh_minhash_add_batch(qrh_minhash *mh, const uint8_t *const shingles[], const size_t lens[], size_t count) {
+    uint64_t hashes[SKETCH_BATCH];
+
+    for(size_t first = 0; first < count; first += SKETCH_BATCH) {
+        size_t n = count - first < SKETCH_BATCH ? count - first : SKETCH_BATCH;
+
+        qrh_64_multi(shingles + first, lens + first, n, mh->seed, hashes);
+        sketch_min_hashes(mh, hashes, n);
+    }
+}
+
+void qrh_minhash_add_hashes(qrh_minhash *mh, const uint64_t *hashes, size_t count) {
+    sketch_min_hashes(mh, hashes, count);
+}
+
+void qrh_minhash_add_text(qrh_minhash *mh, const uint8_t *text, size_t len, size_t width) {
+    const uint8_t *shingles[SKETCH_BATCH];
+    size_t lens[SKETCH_BATCH];
+    size_t windows;
+
+    if(width == 0 || len == 0)
+        return;
+
+    /* text shorter than a window is a single shingle */
+    if(len < width)
+        width = len;
+
+    windows = len - width + 1;
+
+    for(size_t first = 0; first < windows; first += SKETCH_BATCH) {
+        size_t n = windows - first < SKETCH_BATCH ? windows - first : SKETCH_BATCH;
+
+        for(size_t i = 0; i < n; i++) {
+            shingles[i] = text + first + i;
+            lens[i]     = width;
+        }
+
+        qrh_minhash_add_batch(mh, shingles, lens, n);
+    }
+}
+
+int qrh_minhash_merge(qrh_minhash *mh, const qrh_minhash *other) {
+    if(mh->k != other->k || mh->seed != other->seed) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for(unsigned i = 0; i < mh->k; i++)
+        if(other->mins[i] < mh->mins[i])
+            mh->mins[i] = other->mins[i];
+
+    return 0;
+}
+
+double qrh_minhash_similarity(const qrh_minhash *a, const qrh_minhash *b) {
+    unsigned equal = 0;
+
+    if(a->k != b->k || a->seed != b->seed) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    for(unsigned i = 0; i < a->k; i++)
+        equal += a->mins[i] == b->mins[i];
+
+    return (double)equal / a->k;
+}
+
+size_t qrh_minhash_bands(const qrh_minhash *mh, unsigned rows, uint64_t *out) {
+    uint8_t bytes[QRH_MINHASH_MAX * 4];
+    size_t bands;
+
+    if(rows == 0 || rows > mh->k) {
+        errno = EINVAL;
+        return 0;
+    }
+
+    bands = mh->k / rows;
+
+    for(size_t b = 0; b < bands; b++) {
+        for(unsigned r = 0; r < rows; r++) {
+            uint32_t v = mh->mins[b * rows + r];
+
+            bytes[r * 4]     = (uint8_t)v;
+            bytes[r * 4 + 1] = (uint8_t)(v >> 8);
+            bytes[r * 4 + 2] = (uint8_t)(v >> 16);
+            bytes[r * 4 + 3] = (uint8_t)(v >> 24);
+        }
+
+        /* the band number in the seed keeps equal slot runs in different bands apart */
+        out[b] = qrh_64(bytes, (size_t)rows * 4, mh->seed + b);
+    }
+
+    return bands;
+}
+
+double qrh_lsh_probability(double similarity, unsigned bands, unsigned rows) {
+    return 1 - pow(1 - pow(similarity, rows), bands);
+}
+
+uint64_t qrh_simhash(const uint8_t *const features[], const size_t lens[], const int32_t *weights, size_t count,
+                     uint64_t seed) {
+    const sketch_wide lane = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    sketch_wide counters[64 / SKETCH_LANES];
+    int64_t sums[64];
+    uint64_t hashes[SKETCH_BATCH];
+    uint64_t fingerprint = 0;
+
+    memset(counters, 0, sizeof(counters));
+
+    for(size_t first = 0; first < count; first += SKETCH_BATCH) {
+        size_t n = count - first < SKETCH_BATCH ? count - first : SKETCH_BATCH;
+
+        qrh_64_multi(features + first, lens + first, n, seed, hashes);
+
+        for(size_t i = 0; i < n; i++) {
+            int64_t w = weights ? weights[first + i] : 1;
+
+            /* counter j * 8 + l gets +w when hash bit j * 8 + l is set, -w otherwise */
+            for(int j = 0; j < 64 / SKETCH_LANES; j++) {
+                sketch_wide bits = (((sketch_wide){ 0 } + (int64_t)((hashes[i] >> (j * SKETCH_LANES)) & 0xFF)) >> lane) & 1;
+
+                counters[j] += (bits * 2 - 1) * w;
+            }
+        }
+    }
+
+    memcpy(sums, counters, sizeof(sums));
+
+    for(int b = 0; b < 64; b++)
+        if(sums[b] > 0)
+            fingerprint |= (uint64_t)1 << b;
+
+    return fingerprint;
+}
+
+unsigned qrh_simhash_distance(uint64_t a, uint64_t b) {
+    return (unsigned)__builtin_popcountll(a ^ b);
+}
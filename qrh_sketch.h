@@ -0,0 +1,69 @@
+#ifndef QRH_SKETCH_H
+#define QRH_SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Similarity sketches for near-duplicate detection.
+ *
+ * MinHash: each shingle is hashed once with qrh_64(). The k slot values are
+ * derived from that hash with a per-slot salt and a multiply-xorshift
+ * finalizer, 8 slots per SIMD vector, and each slot keeps its minimum.
+ * The share of equal slots between two signatures estimates the Jaccard
+ * similarity of the shingle sets.
+ *
+ * SimHash: 64-bit fingerprint whose bit i is the sign of the weighted sum
+ * over features of +1 or -1 from bit i of the feature hash. The Hamming
+ * distance between fingerprints tracks the cosine distance of the inputs.
+ */
+
+#define QRH_MINHASH_MAX 256
+
+/* plain data: copy, store or send it to merge elsewhere */
+typedef struct qrh_minhash {
+    unsigned k;
+    uint64_t seed;
+    uint32_t salt[QRH_MINHASH_MAX];
+    uint32_t mins[QRH_MINHASH_MAX];
+} qrh_minhash;
+
+/* k in 1..QRH_MINHASH_MAX; -1 with errno EINVAL otherwise */
+int qrh_minhash_init(qrh_minhash *mh, unsigned k, uint64_t seed);
+
+void qrh_minhash_add(qrh_minhash *mh, const uint8_t *shingle, size_t len);
+
+/* the same for many shingles, hashed through qrh_64_multi() */
+void qrh_minhash_add_batch(qrh_minhash *mh, const uint8_t *const shingles[], const size_t lens[], size_t count);
+
+/* shingles already hashed with qrh_64() under the signature's seed */
+void qrh_minhash_add_hashes(qrh_minhash *mh, const uint64_t *hashes, size_t count);
+
+/* every `width`-byte window of `text` as a shingle, without copying */
+void qrh_minhash_add_text(qrh_minhash *mh, const uint8_t *text, size_t len, size_t width);
+
+/* mh = signature of the union; -1 with errno EINVAL when k or seed differ */
+int qrh_minhash_merge(qrh_minhash *mh, const qrh_minhash *other);
+
+/* estimated Jaccard similarity, or -1 with errno EINVAL when k or seed differ */
+double qrh_minhash_similarity(const qrh_minhash *a, const qrh_minhash *b);
+
+/*
+ * LSH banding: k / rows band keys, key b = qrh_64() of slots
+ * b * rows .. b * rows + rows - 1. Signatures that share any band key are
+ * candidate pairs. Returns the number of keys, or 0 with errno EINVAL when
+ * rows is 0 or above k.
+ */
+size_t qrh_minhash_bands(const qrh_minhash *mh, unsigned rows, uint64_t *out);
+
+/* chance that a pair of this similarity shares a band key: 1 - (1 - s^rows)^bands */
+double qrh_lsh_probability(double similarity, unsigned bands, unsigned rows);
+
+/* `weights` may be NULL for weight 1 on every feature */
+uint64_t qrh_simhash(const uint8_t *const features[], const size_t lens[], const int32_t *weights, size_t count,
+                     uint64_t seed);
+
+/* number of differing fingerprint bits */
+unsigned qrh_simhash_distance(uint64_t a, uint64_t b);
+
+#endif
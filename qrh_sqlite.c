@@ -0,0 +1,217 @@
+/**
+ * qrh_sqlite.c
+ *
+ * Features:
+ *   - SQLite loadable extension: qrh256(x), qrh256_hmac(key, x) and the
+ *     aggregate qrh256_agg(x, ...)
+ *   - The HMAC pads are derived once per statement for a constant key and
+ *     kept as the key argument's auxdata
+ *   - qrh256_agg() appends each row to a qrh_log held in the aggregate
+ *     context, so a whole-table digest is one scan in constant memory
+ *
+ * QRH-256 mixes the total length into every block, and an aggregate only
+ * learns the length after its last row, so qrh256_agg() returns the digest
+ * of a qrh_log (qrh_log.h) over the framed rows, not qrh_256() of anything.
+ */
+
+#include <sqlite3ext.h>
+SQLITE_EXTENSION_INIT1
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "qrh_256.h"
+#include "qrh_log.h"
+
+#define SQLITE_QRH_DIGEST_SIZE 32
+#define SQLITE_QRH_FLAGS       (SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS)
+
+/* row framing in qrh256_agg(): a row marker, then per value a type tag and le64 length */
+#define SQLITE_QRH_ROW 0x00
+
+struct sqlite_qrh_agg {
+    int started;
+    qrh_log log;
+};
+
+static void sqlite_qrh_le64(uint8_t *p, uint64_t v) {
+    for(int i = 0; i < 8; i++)
+        p[i] = (uint8_t)(v >> (8 * i));
+}
+
+/*
+ * Bytes of an argument: blobs as stored, anything else as its UTF-8 text.
+ * sqlite3_value_blob() would return text in the database's own encoding, so
+ * a UTF-16 database would hash different bytes; sqlite3_value_bytes() after
+ * sqlite3_value_text() is the UTF-8 length.
+ */
+static const uint8_t *sqlite_qrh_bytes(sqlite3_value *value, size_t *len) {
+    const uint8_t *bytes;
+
+    if(sqlite3_value_type(value) == SQLITE_BLOB)
+        bytes = sqlite3_value_blob(value);
+    else
+        bytes = sqlite3_value_text(value);
+
+    *len = (size_t)sqlite3_value_bytes(value);
+    return bytes ? bytes : (const uint8_t *)"";
+}
+
+static void sqlite_qrh_256(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    uint8_t digest[SQLITE_QRH_DIGEST_SIZE];
+    const uint8_t *bytes;
+    size_t len;
+
+    (void)argc;
+
+    if(sqlite3_value_type(argv[0]) == SQLITE_NULL)
+        return;
+
+    bytes = sqlite_qrh_bytes(argv[0], &len);
+    qrh_256(bytes, len, digest);
+    sqlite3_result_blob(ctx, digest, sizeof(digest), SQLITE_TRANSIENT);
+}
+
+static void sqlite_qrh_free_key(void *key) {
+    qrh_wipe(key, sizeof(qrh_hmac_key));
+    sqlite3_free(key);
+}
+
+static void sqlite_qrh_256_hmac(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    uint8_t digest[SQLITE_QRH_DIGEST_SIZE];
+    qrh_hmac_key local, *key;
+    const uint8_t *bytes;
+    size_t len;
+
+    (void)argc;
+
+    if(sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL)
+        return;
+
+    /* SQLite keeps auxdata only while the key argument is a constant */
+    key = sqlite3_get_auxdata(ctx, 0);
+
+    if(!key) {
+        qrh_hmac_key *saved = sqlite3_malloc(sizeof(*saved));
+
+        bytes = sqlite_qrh_bytes(argv[0], &len);
+        qrh_hmac_key_init(&local, bytes, len);
+        key = &local;
+
+        /* a failed save only costs deriving the pads again next row */
+        if(saved) {
+            *saved = local;
+            sqlite3_set_auxdata(ctx, 0, saved, sqlite_qrh_free_key);
+        }
+    }
+
+    bytes = sqlite_qrh_bytes(argv[1], &len);
+    qrh_256_hmac_with_key(key, bytes, len, digest);
+
+    if(key == &local)
+        qrh_wipe(&local, sizeof(local));
+
+    sqlite3_result_blob(ctx, digest, sizeof(digest), SQLITE_TRANSIENT);
+}
+
+/*
+ * Each row appends SQLITE_QRH_ROW, then for every argument its SQLite type
+ * (1 integer, 2 real, 3 text, 4 blob, 5 null), le64 length and contents:
+ * integers as le64 two's complement, reals as their le64 IEEE-754 bits,
+ * text and blobs as stored, null empty. The framing makes the digest
+ * sensitive to row order and boundaries and to value types: 1, 1.0 and
+ * '1' hash differently.
+ */
+static void sqlite_qrh_agg_step(sqlite3_context *ctx, int argc, sqlite3_value **argv) {
+    struct sqlite_qrh_agg *agg = sqlite3_aggregate_context(ctx, sizeof(*agg));
+    uint8_t row = SQLITE_QRH_ROW;
+
+    if(!agg) {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+
+    if(!agg->started) {
+        qrh_log_init(&agg->log);
+        agg->started = 1;
+    }
+
+    qrh_log_append(&agg->log, &row, 1);
+
+    for(int i = 0; i < argc; i++) {
+        int type = sqlite3_value_type(argv[i]);
+        uint8_t header[1 + 8 + 8];
+        size_t header_len = 1 + 8;
+        const uint8_t *bytes = NULL;
+        size_t len = 0;
+        double real;
+        uint64_t bits;
+
+        switch(type) {
+        case SQLITE_INTEGER:
+            len = 8;
+            sqlite_qrh_le64(header + 9, (uint64_t)sqlite3_value_int64(argv[i]));
+            header_len += 8;
+            break;
+        case SQLITE_FLOAT:
+            real = sqlite3_value_double(argv[i]);
+            memcpy(&bits, &real, sizeof(bits));
+            len = 8;
+            sqlite_qrh_le64(header + 9, bits);
+            header_len += 8;
+            break;
+        case SQLITE_TEXT:
+        case SQLITE_BLOB:
+            bytes = sqlite_qrh_bytes(argv[i], &len);
+            break;
+        default:
+            break;
+        }
+
+        header[0] = (uint8_t)type;
+        sqlite_qrh_le64(header + 1, len);
+        qrh_log_append(&agg->log, header, header_len);
+
+        if(bytes)
+            qrh_log_append(&agg->log, bytes, len);
+    }
+}
+
+static void sqlite_qrh_agg_final(sqlite3_context *ctx) {
+    struct sqlite_qrh_agg *agg = sqlite3_aggregate_context(ctx, 0);
+    uint8_t digest[SQLITE_QRH_DIGEST_SIZE];
+
+    /* no rows: the digest of an empty log */
+    if(!agg || !agg->started) {
+        qrh_log empty;
+
+        qrh_log_init(&empty);
+        qrh_log_digest(&empty, digest);
+    } else {
+        qrh_log_digest(&agg->log, digest);
+    }
+
+    sqlite3_result_blob(ctx, digest, sizeof(digest), SQLITE_TRANSIENT);
+}
+
+/* entry point SQLite derives from the file name qrh_sqlite.so */
+#ifdef _WIN32
+__declspec(dllexport)
+#endif
+int sqlite3_qrhsqlite_init(sqlite3 *db, char **err, const sqlite3_api_routines *api) {
+    int rc;
+
+    (void)err;
+    SQLITE_EXTENSION_INIT2(api);
+
+    rc = sqlite3_create_function(db, "qrh256", 1, SQLITE_QRH_FLAGS, NULL, sqlite_qrh_256, NULL, NULL);
+
+    if(rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "qrh256_hmac", 2, SQLITE_QRH_FLAGS, NULL, sqlite_qrh_256_hmac, NULL, NULL);
+
+    if(rc == SQLITE_OK)
+        rc = sqlite3_create_function(db, "qrh256_agg", -1, SQLITE_QRH_FLAGS, NULL, NULL,
+                                     sqlite_qrh_agg_step, sqlite_qrh_agg_final);
+
+    return rc;
+}
@@ -0,0 +1,161 @@
+/**
+ * qrh_tar_test.c
+ *
+ * Features:
+ *   - Feeds `qrhsum --tar` archives whose pax extended headers are
+ *     malformed: zero, short, overlong and unterminated record lengths,
+ *     records without '=' and length fields that overflow
+ *   - Each run is capped at QRH_TAR_TEST_CPU seconds of CPU time, so a
+ *     parser that stops advancing fails instead of hanging
+ *   - A well-formed pax archive must still list the member under its pax path
+ *
+ * Usage: qrh_tar_test [QRHSUM]    (default ./qrhsum); exit status 1 on a failure
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#define TAR_BLOCK        512
+#define QRH_TAR_TEST_CPU 5
+
+struct tar_case {
+    const char *name;
+    const char *pax;           /* contents of the 'x' header */
+    int valid;
+};
+
+static const struct tar_case tar_cases[] = {
+    { "zero-length record",      "12 path=a/b\n0 =\n",          0 },
+    { "record shorter than key", "3 path=a/b\n",                0 },
+    { "length inside prefix",    "2 x\n",                       0 },
+    { "length past the data",    "99 path=a/b\n",               0 },
+    { "no newline at length",    "11 path=a/bX",                0 },
+    { "no '='",                  "9 pathab\n",                  0 },
+    { "no space after length",   "12path=a/b\n",                0 },
+    { "overflowing length",      "99999999999999999999999 k=v\n", 0 },
+    { "empty length",            " path=a/b\n",                 0 },
+    { "non-digit size",          "11 size=1x\n",                0 },
+    { "well-formed",             "17 path=pax/name\n",          1 },
+};
+
+static void tar_octal(uint8_t *field, size_t len, unsigned value) {
+    snprintf((char *)field, len, "%0*o", (int)len - 1, value);
+}
+
+static void tar_header(uint8_t *h, const char *name, char type, unsigned size) {
+    unsigned sum = 0;
+
+    memset(h, 0, TAR_BLOCK);
+    strncpy((char *)h, name, 100);
+    tar_octal(h + 100, 8, 0644);
+    tar_octal(h + 108, 8, 0);
+    tar_octal(h + 116, 8, 0);
+    tar_octal(h + 124, 12, size);
+    tar_octal(h + 136, 12, 0);
+    h[156] = (uint8_t)type;
+    memcpy(h + 257, "ustar\0" "00", 8);
+    memset(h + 148, ' ', 8);
+
+    for(int i = 0; i < TAR_BLOCK; i++)
+        sum += h[i];
+
+    snprintf((char *)h + 148, 8, "%06o", sum);
+}
+
+/* an 'x' header with `pax`, a one-byte member and the end-of-archive blocks */
+static size_t tar_build(uint8_t *out, const char *pax) {
+    size_t len = strlen(pax), off = 0;
+
+    tar_header(out, "PaxHeader", 'x', (unsigned)len);
+    off += TAR_BLOCK;
+    memset(out + off, 0, (len + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK);
+    memcpy(out + off, pax, len);
+    off += (len + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+
+    tar_header(out + off, "ustar-name", '0', 1);
+    off += TAR_BLOCK;
+    memset(out + off, 0, TAR_BLOCK * 3);
+    out[off] = 'a';
+    off += TAR_BLOCK * 3;
+
+    return off;
+}
+
+/* exit status of `qrhsum --tar path`, its stdout in `out`; -1 if it was killed */
+static int tar_run(const char *qrhsum, const char *path, char *out, size_t out_size) {
+    int fds[2], status;
+    ssize_t n;
+    size_t got = 0;
+    pid_t pid;
+
+    if(pipe(fds) < 0)
+        return -1;
+
+    if((pid = fork()) == 0) {
+        struct rlimit cpu = { QRH_TAR_TEST_CPU, QRH_TAR_TEST_CPU };
+
+        setrlimit(RLIMIT_CPU, &cpu);
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        execl(qrhsum, qrhsum, "--tar", path, (char *)NULL);
+        _exit(127);
+    }
+
+    close(fds[1]);
+
+    while(got + 1 < out_size && (n = read(fds[0], out + got, out_size - 1 - got)) > 0)
+        got += (size_t)n;
+
+    out[got] = '\0';
+    close(fds[0]);
+
+    if(pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+        return -1;
+
+    return WEXITSTATUS(status);
+}
+
+int main(int argc, char **argv) {
+    const char *qrhsum = argc > 1 ? argv[1] : "./qrhsum";
+    char path[] = "/tmp/qrh_tar_test.XXXXXX";
+    static uint8_t archive[TAR_BLOCK * 16];
+    char out[4096];
+    int failures = 0, fd;
+
+    if((fd = mkstemp(path)) < 0) {
+        perror("qrh_tar_test");
+        return 1;
+    }
+
+    close(fd);
+
+    for(size_t i = 0; i < sizeof(tar_cases) / sizeof(tar_cases[0]); i++) {
+        const struct tar_case *c = &tar_cases[i];
+        size_t len = tar_build(archive, c->pax);
+        FILE *f = fopen(path, "wb");
+        int status, ok;
+
+        if(!f || fwrite(archive, 1, len, f) != len || fclose(f) != 0) {
+            perror("qrh_tar_test");
+            unlink(path);
+            return 1;
+        }
+
+        status = tar_run(qrhsum, path, out, sizeof(out));
+        ok = c->valid ? status == 0 && strstr(out, "  pax/name\n") != NULL : status == 1;
+
+        printf("%-26s %s (exit %d)\n", c->name, ok ? "ok" : "FAILED", status);
+        failures += !ok;
+    }
+
+    unlink(path);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,305 @@
+/**
+ * qrhsum.c
+ *
+ * Features:
+ *   - sha256sum-style command line front end for QRH-256
+ *   - Files are mmap'd and hashed in one qrh_256() call
+ *   - --progress reports long hashes on stderr, SIGINT/SIGTERM cancel them
+ *   - Dispatches to the watch, binary manifest, per-line and tar modes
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+#include "qrhsum.h"
+
+#define QRHSUM_READ_CHUNK (1 << 16)
+#define QRHSUM_DEBOUNCE_MS 250
+
+static int qrhsum_slurp(int fd, struct qrhsum_input *in);
+static void qrhsum_usage(FILE *stream);
+
+static qrh_control qrhsum_control;
+
+static void qrhsum_on_signal(int sig) {
+    (void)sig;
+    qrh_cancel(&qrhsum_control);
+}
+
+static void qrhsum_progress(void *user, uint64_t done, uint64_t total, double mb_per_s) {
+    fprintf(stderr, "qrhsum: %s: %llu of %llu MiB, %.1f MB/s\n", (const char *)user,
+            (unsigned long long)(done >> 20), (unsigned long long)(total >> 20), mb_per_s);
+}
+
+/* qrh_256() needs the total length up front, so pipes are slurped into memory */
+static int qrhsum_slurp(int fd, struct qrhsum_input *in) {
+    size_t capacity = QRHSUM_READ_CHUNK;
+    size_t length   = 0;
+    uint8_t *buffer = malloc(capacity);
+
+    if(!buffer)
+        return -1;
+
+    for(;;) {
+        if(length == capacity) {
+            uint8_t *grown = realloc(buffer, capacity * 2);
+
+            if(!grown) {
+                free(buffer);
+                return -1;
+            }
+
+            buffer    = grown;
+            capacity *= 2;
+        }
+
+        ssize_t n = read(fd, buffer + length, capacity - length);
+
+        if(n < 0 && errno == EINTR && qrh_cancelled(&qrhsum_control))
+            errno = ECANCELED;
+        else if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n < 0) {
+            free(buffer);
+            return -1;
+        }
+
+        if(n == 0)
+            break;
+
+        length += (size_t)n;
+    }
+
+    in->data   = buffer;
+    in->len    = length;
+    in->mapped = 0;
+
+    return 0;
+}
+
+int qrhsum_open_input(const char *path, struct qrhsum_input *in) {
+    struct stat st;
+    int fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_CLOEXEC);
+    int ret = -1;
+
+    memset(in, 0, sizeof(*in));
+
+    if(fd < 0)
+        return -1;
+
+    if(fstat(fd, &st) < 0) {
+        ret = -1;
+    } else if(S_ISDIR(st.st_mode)) {
+        errno = EISDIR;
+    } else if(!S_ISREG(st.st_mode) || st.st_size == 0) {
+        ret = qrhsum_slurp(fd, in);
+    } else {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if(map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+            in->data   = map;
+            in->len    = (size_t)st.st_size;
+            in->mapped = 1;
+            ret        = 0;
+        }
+    }
+
+    if(fd != STDIN_FILENO) {
+        int saved = errno;
+
+        close(fd);
+        errno = saved;
+    }
+
+    return ret;
+}
+
+void qrhsum_close_input(struct qrhsum_input *in) {
+    if(in->mapped)
+        munmap((void *)in->data, in->len);
+    else
+        free((void *)in->data);
+
+    memset(in, 0, sizeof(*in));
+}
+
+int qrhsum_hash_file(const char *path, uint8_t out[QRHSUM_DIGEST_SIZE], const qrh_control *control) {
+    struct qrhsum_input in;
+
+    if(qrhsum_open_input(path, &in) < 0)
+        return -1;
+
+    int ret   = qrh_256_control(in.data, in.len, out, control);
+    int saved = errno;
+
+    qrhsum_close_input(&in);
+    errno = saved;
+
+    return ret;
+}
+
+static void qrhsum_usage(FILE *stream) {
+    fprintf(stream,
+            "Usage: qrhsum [FILE]...\n"
+            "       qrhsum --manifest OUT [FILE]...\n"
+            "       qrhsum --diff A B\n"
+            "       qrhsum --check MANIFEST [-j THREADS] [--progress]\n"
+            "       qrhsum --lines [--binary] [FILE]\n"
+            "       qrhsum --tar ARCHIVE [--manifest OUT] [-j THREADS]\n"
+            "       qrhsum --watch DIR --socket PATH [--debounce MS]\n"
+            "\n"
+            "Print QRH-256 digests. With no FILE, or when FILE is -, read standard input.\n"
+            "\n"
+            "  --manifest OUT   write a binary manifest of FILEs (paths from stdin if none)\n"
+            "  --diff A B       list paths added, removed or changed between two manifests\n"
+            "  --check M        verify the files listed in binary manifest M in disk order\n"
+            "  -j THREADS       hashing threads for --check and --tar (default: online CPUs)\n"
+            "  --progress       report bytes hashed and MB/s on stderr while hashing\n"
+            "  --lines          print one digest per line of FILE, in order\n"
+            "  --binary         with --lines, write raw 32-byte digests instead of hex\n"
+            "  --tar ARCHIVE    digest every regular member of a tar archive without extracting it,\n"
+            "                   then the archive itself (with --manifest, members go to OUT)\n"
+            "  --watch DIR      keep digests of every file under DIR up to date\n"
+            "  --socket PATH    unix socket answering GET/LIST queries (with --watch)\n"
+            "  --debounce MS    quiet period before a modified file is rehashed (default %d)\n"
+            "  -h, --help       show this help\n",
+            QRHSUM_DEBOUNCE_MS);
+}
+
+int main(int argc, char **argv) {
+    const char *manifest_out = NULL;
+    const char *diff_a       = NULL;
+    const char *diff_b       = NULL;
+    const char *check_path   = NULL;
+    const char *tar_path     = NULL;
+    const char *watch_dir    = NULL;
+    const char *socket_path  = NULL;
+    int lines_mode           = 0;
+    int binary               = 0;
+    int progress             = 0;
+    unsigned debounce_ms     = QRHSUM_DEBOUNCE_MS;
+    unsigned nthreads        = (unsigned)sysconf(_SC_NPROCESSORS_ONLN);
+    int first_file           = argc;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--manifest") == 0 && i + 1 < argc) {
+            manifest_out = argv[++i];
+        } else if(strcmp(argv[i], "--diff") == 0 && i + 2 < argc) {
+            diff_a = argv[++i];
+            diff_b = argv[++i];
+        } else if(strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            check_path = argv[++i];
+        } else if(strcmp(argv[i], "--tar") == 0 && i + 1 < argc) {
+            tar_path = argv[++i];
+        } else if(strcmp(argv[i], "--lines") == 0) {
+            lines_mode = 1;
+        } else if(strcmp(argv[i], "--binary") == 0) {
+            binary = 1;
+        } else if(strcmp(argv[i], "--progress") == 0) {
+            progress = 1;
+        } else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthreads = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_dir = argv[++i];
+        } else if(strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if(strcmp(argv[i], "--debounce") == 0 && i + 1 < argc) {
+            debounce_ms = (unsigned)strtoul(argv[++i], NULL, 10);
+        } else if(strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+            qrhsum_usage(stdout);
+            return 0;
+        } else if(strcmp(argv[i], "--") == 0) {
+            first_file = i + 1;
+            break;
+        } else if(argv[i][0] == '-' && argv[i][1] != '\0') {
+            qrhsum_usage(stderr);
+            return 2;
+        } else {
+            first_file = i;
+            break;
+        }
+    }
+
+    if(diff_a)
+        return qrhsum_manifest_diff(diff_a, diff_b);
+
+    /* only the hashing modes below can be cancelled, the others keep the default signal handling */
+    struct sigaction sa = { .sa_handler = qrhsum_on_signal };
+
+    if(progress)
+        qrhsum_control.progress = qrhsum_progress;
+
+    if(check_path || tar_path) {
+        struct qrh_pool_config pool_cfg = { .threads = nthreads };
+
+        /* -j sizes the pool; if it cannot start, the default pool is used */
+        qrh_pool_set_default(qrh_pool_create(&pool_cfg));
+
+        qrhsum_control.user = (void *)(check_path ? check_path : tar_path);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        if(tar_path)
+            return qrhsum_tar(tar_path, manifest_out, &qrhsum_control);
+
+        return qrhsum_check(check_path, nthreads, &qrhsum_control);
+    }
+
+    if(lines_mode)
+        return qrhsum_lines(first_file < argc ? argv[first_file] : "-", binary);
+
+    if(manifest_out)
+        return qrhsum_manifest_create(manifest_out, argv + first_file, argc - first_file);
+
+    if(watch_dir) {
+        if(!socket_path) {
+            fprintf(stderr, "qrhsum: --watch requires --socket\n");
+            return 2;
+        }
+
+        return qrhsum_watch(watch_dir, socket_path, debounce_ms) == 0 ? 0 : 1;
+    }
+
+    static char *stdin_only[] = { "-" };
+    char **files = first_file < argc ? argv + first_file : stdin_only;
+    int nfiles   = first_file < argc ? argc - first_file : 1;
+    int status   = 0;
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    for(int i = 0; i < nfiles; i++) {
+        uint8_t digest[QRHSUM_DIGEST_SIZE];
+        char hex[QRHSUM_HEX_SIZE];
+
+        qrhsum_control.user = files[i];
+
+        if(qrhsum_hash_file(files[i], digest, &qrhsum_control) < 0) {
+            if(errno == ECANCELED) {
+                fprintf(stderr, "qrhsum: %s: interrupted\n", files[i]);
+                return 130;
+            }
+
+            fprintf(stderr, "qrhsum: %s: %s\n", files[i], strerror(errno ? errno : EIO));
+            status = 1;
+            continue;
+        }
+
+        qrh_digest_to_hex(digest, hex);
+        printf("%s  %s\n", hex, files[i]);
+    }
+
+    return status;
+}
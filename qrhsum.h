@@ -0,0 +1,47 @@
+#ifndef QRHSUM_H
+#define QRHSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "qrh_256.h"
+#include "qrh_encode.h"
+
+#define QRHSUM_DIGEST_SIZE QRH_DIGEST_SIZE
+#define QRHSUM_HEX_SIZE    (QRH_HEX_LEN + 1)
+
+struct qrhsum_verify_item {
+    const char *path;
+    const uint8_t *digest;
+};
+
+/* whole input in memory: mmap'd regular file or slurped pipe */
+struct qrhsum_input {
+    const uint8_t *data;
+    size_t len;
+    int mapped;
+};
+
+/* shared helpers (qrhsum.c) */
+int qrhsum_open_input(const char *path, struct qrhsum_input *in);
+void qrhsum_close_input(struct qrhsum_input *in);
+int qrhsum_hash_file(const char *path, uint8_t out[QRHSUM_DIGEST_SIZE], const qrh_control *control);
+
+/* modes, the manifest ones return the process exit status */
+int qrhsum_watch(const char *root, const char *socket_path, unsigned debounce_ms);
+int qrhsum_manifest_create(const char *out_path, char **files, int nfiles);
+int qrhsum_manifest_diff(const char *a_path, const char *b_path);
+int qrhsum_check(const char *manifest_path, unsigned nthreads, const qrh_control *control);
+int qrhsum_lines(const char *path, int binary);
+
+/* member digests of tar archive `path` on stdout, or in manifest `manifest_out`, then the archive's */
+int qrhsum_tar(const char *path, const char *manifest_out, const qrh_control *control);
+
+/*
+ * verifies in disk order on the default qrh_pool, at most `nthreads` files hashing at once; prints
+ * one verdict per file. `control` reports bytes of the whole set and stops it (-1, errno ECANCELED).
+ */
+int qrhsum_verify(const struct qrhsum_verify_item *items, size_t count, unsigned nthreads,
+                  const qrh_control *control, size_t *failed);
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * qrhsum_manifest.c
+ *
+ * Features:
+ *   - `qrhsum --manifest OUT` writes a binary manifest (qrh_manifest.h)
+ *   - `qrhsum --diff A B` merge-joins two mmap'd manifests
+ *   - `qrhsum --check M` hands the entries to the disk-ordered verifier
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "qrh_manifest.h"
+#include "qrhsum.h"
+
+static int manifest_add_file(struct qrh_manifest_builder *builder, const char *path) {
+    uint8_t digest[QRHSUM_DIGEST_SIZE];
+    struct stat st;
+
+    if(stat(path, &st) < 0 || qrhsum_hash_file(path, digest, NULL) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    if(qrh_manifest_builder_add(builder, path, digest, (uint64_t)st.st_size, (uint64_t)st.st_ino) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", path, strerror(errno));
+        return 2;
+    }
+
+    return 0;
+}
+
+int qrhsum_manifest_create(const char *out_path, char **files, int nfiles) {
+    struct qrh_manifest_builder builder;
+    int status = 0;
+
+    qrh_manifest_builder_init(&builder);
+
+    if(nfiles > 0) {
+        for(int i = 0; i < nfiles && status < 2; i++)
+            status |= manifest_add_file(&builder, files[i]);
+    } else {
+        /* no FILE arguments: one path per line on stdin, e.g. from find(1) */
+        char *line  = NULL;
+        size_t size = 0;
+        ssize_t len;
+
+        while(status < 2 && (len = getline(&line, &size, stdin)) > 0) {
+            if(line[len - 1] == '\n')
+                line[--len] = '\0';
+
+            if(len > 0)
+                status |= manifest_add_file(&builder, line);
+        }
+
+        free(line);
+    }
+
+    if(status < 2 && qrh_manifest_builder_write(&builder, out_path) < 0) {
+        if(errno == EEXIST && builder.duplicate)
+            fprintf(stderr, "qrhsum: %s: %s listed more than once\n", out_path, builder.duplicate);
+        else
+            fprintf(stderr, "qrhsum: %s: %s\n", out_path, strerror(errno));
+
+        status = 2;
+    }
+
+    qrh_manifest_builder_free(&builder);
+    return status;
+}
+
+static void manifest_print_change(enum qrh_manifest_change change,
+                                  const struct qrh_manifest *a, const struct qrh_manifest_entry *ea,
+                                  const struct qrh_manifest *b, const struct qrh_manifest_entry *eb,
+                                  void *user) {
+    static const char marks[] = { '+', '-', 'M' };
+    const struct qrh_manifest *m = eb ? b : a;
+    const struct qrh_manifest_entry *e = eb ? eb : ea;
+    char hex[QRHSUM_HEX_SIZE];
+
+    (void)user;
+
+    qrh_digest_to_hex(e->digest, hex);
+    printf("%c %s  %s\n", marks[change], hex, qrh_manifest_path(m, e));
+}
+
+int qrhsum_manifest_diff(const char *a_path, const char *b_path) {
+    struct qrh_manifest a;
+    struct qrh_manifest b;
+
+    if(qrh_manifest_open(&a, a_path) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", a_path, strerror(errno));
+        return 2;
+    }
+
+    if(qrh_manifest_open(&b, b_path) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", b_path, strerror(errno));
+        qrh_manifest_close(&a);
+        return 2;
+    }
+
+    size_t changes = qrh_manifest_diff(&a, &b, manifest_print_change, NULL);
+
+    qrh_manifest_close(&a);
+    qrh_manifest_close(&b);
+
+    return changes ? 1 : 0;
+}
+
+int qrhsum_check(const char *manifest_path, unsigned nthreads, const qrh_control *control) {
+    struct qrh_manifest m;
+
+    if(qrh_manifest_open(&m, manifest_path) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", manifest_path, strerror(errno));
+        return 2;
+    }
+
+    struct qrhsum_verify_item *items = malloc((m.count ? m.count : 1) * sizeof(*items));
+    size_t failed = 0;
+
+    if(!items) {
+        qrh_manifest_close(&m);
+        return 2;
+    }
+
+    for(size_t i = 0; i < m.count; i++) {
+        items[i].path   = qrh_manifest_path(&m, &m.entries[i]);
+        items[i].digest = m.entries[i].digest;
+    }
+
+    /* manifest order is digest order, the verifier reorders by physical location */
+    if(qrhsum_verify(items, m.count, nthreads, control, &failed) < 0) {
+        int cancelled = errno == ECANCELED;
+
+        fprintf(stderr, "qrhsum: %s: %s\n", manifest_path, cancelled ? "interrupted" : strerror(errno));
+        free(items);
+        qrh_manifest_close(&m);
+        return cancelled ? 130 : 2;
+    }
+
+    if(failed)
+        fprintf(stderr, "qrhsum: WARNING: %zu of %zu computed checksums did NOT match\n", failed, m.count);
+
+    free(items);
+    qrh_manifest_close(&m);
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+/**
+ * qrhsum_tar.c
+ *
+ * Features:
+ *   - `qrhsum --tar ARCHIVE` digests every regular member of a tar archive
+ *     without extracting it, plus the archive as a whole
+ *   - ustar, pax (path/size records) and GNU (long names, base-256 sizes)
+ *     headers, checksums verified
+ *   - The archive is mmap'd, or slurped from a pipe; each member's byte
+ *     range is hashed in place by qrh_256() on the default qrh_pool
+ *   - With --manifest OUT the member digests go to a binary manifest
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "qrh_256.h"
+#include "qrh_manifest.h"
+#include "qrh_pool.h"
+#include "qrhsum.h"
+
+#define TAR_BLOCK 512
+
+struct tar_member {
+    char *path;
+    size_t offset;             /* first data byte in the archive */
+    uint64_t size;
+    uint8_t digest[QRHSUM_DIGEST_SIZE];
+};
+
+struct tar_job {
+    const uint8_t *data;
+    size_t len;
+    struct tar_member *members;
+    size_t count;
+    const qrh_control *control;
+    uint8_t archive[QRHSUM_DIGEST_SIZE];
+    int failed;                /* errno of the whole-archive hash, 0 on success */
+};
+
+/* octal, NUL or space terminated, or GNU base-256 when the top bit is set */
+static int tar_number(const uint8_t *field, size_t len, uint64_t *out) {
+    uint64_t v = 0;
+    size_t i = 0;
+
+    if(field[0] & 0x80) {
+        for(i = 1; i < len; i++) {
+            if(v >> 56)
+                return -1;
+
+            v = v << 8 | field[i];
+        }
+
+        /* the first byte keeps 7 value bits; anything there overflows 64 bits here */
+        if(field[0] != 0x80)
+            return -1;
+
+        *out = v;
+        return 0;
+    }
+
+    while(i < len && field[i] == ' ')
+        i++;
+
+    for(; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        if(v >> 61)
+            return -1;
+
+        v = v << 3 | (uint64_t)(field[i] - '0');
+    }
+
+    if(i < len && field[i] != '\0' && field[i] != ' ')
+        return -1;
+
+    *out = v;
+    return 0;
+}
+
+static int tar_checksum_ok(const uint8_t *h) {
+    uint64_t stored;
+    unsigned sum = 0;
+
+    if(tar_number(h + 148, 8, &stored) < 0)
+        return 0;
+
+    for(int i = 0; i < TAR_BLOCK; i++)
+        sum += i >= 148 && i < 156 ? ' ' : h[i];
+
+    return stored == sum;
+}
+
+static char *tar_field(const uint8_t *field, size_t len) {
+    return strndup((const char *)field, len);
+}
+
+/*
+ * "LEN key=value\n" records; picks up path and size for the next member.
+ * LEN counts the whole record, its own digits included, so it must reach
+ * past "LEN " to a newline within the data, with the '=' before that.
+ */
+static int tar_pax(const uint8_t *p, uint64_t len, char **path, uint64_t *size, int *has_size) {
+    const uint8_t *end = p + len;
+
+    while(p < end) {
+        uint64_t rec = 0;
+        const uint8_t *q = p;
+
+        while(q < end && *q >= '0' && *q <= '9' && rec <= (uint64_t)(end - p))
+            rec = rec * 10 + (uint64_t)(*q++ - '0');
+
+        if(q == p || q >= end || *q != ' ' || rec > (uint64_t)(end - p) ||
+           rec <= (uint64_t)(q - p) + 1 || p[rec - 1] != '\n')
+            return -1;
+
+        const uint8_t *key   = q + 1;
+        const uint8_t *eq    = memchr(key, '=', (size_t)(p + rec - 1 - key));
+        const uint8_t *value = eq ? eq + 1 : NULL;
+        size_t vlen          = eq ? (size_t)(p + rec - 1 - value) : 0;
+
+        if(!eq)
+            return -1;
+
+        if((size_t)(eq - key) == 4 && memcmp(key, "path", 4) == 0) {
+            free(*path);
+            *path = strndup((const char *)value, vlen);
+        } else if((size_t)(eq - key) == 4 && memcmp(key, "size", 4) == 0) {
+            uint64_t v = 0;
+
+            for(size_t i = 0; i < vlen; i++) {
+                if(value[i] < '0' || value[i] > '9' || v > UINT64_MAX / 10)
+                    return -1;
+
+                v = v * 10 + (uint64_t)(value[i] - '0');
+            }
+
+            *size     = v;
+            *has_size = 1;
+        }
+
+        p += rec;
+    }
+
+    return 0;
+}
+
+/* a regular member's path: from a pax or GNU long-name header, else from the ustar fields */
+static char *tar_member_path(const uint8_t *h, char *long_path) {
+    char *name, *prefix, *path;
+
+    if(long_path)
+        return long_path;
+
+    name = tar_field(h, 100);
+
+    /* POSIX ustar splits long names into prefix/name; GNU uses that area for times */
+    if(!name || memcmp(h + 257, "ustar\0", 6) != 0 || h[345] == '\0')
+        return name;
+
+    prefix = tar_field(h + 345, 155);
+
+    if(!prefix || asprintf(&path, "%s/%s", prefix, name) < 0)
+        path = NULL;
+
+    free(prefix);
+    free(name);
+
+    return path;
+}
+
+/* walks the headers; regular members are appended to `members` */
+static int tar_scan(const uint8_t *data, size_t len, struct tar_member **members, size_t *count) {
+    size_t capacity = 0, off = 0;
+    char *long_path = NULL;        /* from a pax 'x' or GNU 'L' header, for the next member */
+    uint64_t pax_size = 0;
+    int has_size = 0, ended = 0, err = 0;
+
+    *members = NULL;
+    *count   = 0;
+
+    while(!err && off + TAR_BLOCK <= len) {
+        const uint8_t *h = data + off;
+        char type = (char)h[156];
+        int meta = type == 'x' || type == 'g' || type == 'L' || type == 'K';
+        uint64_t size, padded;
+
+        /* a zero block ends the archive */
+        if(h[0] == '\0' && memcmp(h, h + 1, TAR_BLOCK - 1) == 0) {
+            ended = 1;
+            break;
+        }
+
+        if(!tar_checksum_ok(h) || tar_number(h + 124, 12, &size) < 0) {
+            err = EINVAL;
+            break;
+        }
+
+        off += TAR_BLOCK;
+
+        if(has_size && !meta)
+            size = pax_size;
+
+        if(size > len - off) {
+            err = EINVAL;
+            break;
+        }
+
+        if(type == 'x') {
+            if(tar_pax(data + off, size, &long_path, &pax_size, &has_size) < 0)
+                err = EINVAL;
+        } else if(type == 'L') {
+            free(long_path);
+
+            if(!(long_path = tar_field(data + off, (size_t)size)))
+                err = ENOMEM;
+        } else if(!meta) {
+            if(type == '0' || type == '\0' || type == '7') {
+                char *path = tar_member_path(h, long_path);
+
+                long_path = NULL;
+
+                if(path && *count == capacity) {
+                    size_t grown_capacity = capacity ? capacity * 2 : 64;
+                    struct tar_member *grown = realloc(*members, grown_capacity * sizeof(**members));
+
+                    if(grown) {
+                        *members = grown;
+                        capacity = grown_capacity;
+                    } else {
+                        free(path);
+                        path = NULL;
+                    }
+                }
+
+                if(path)
+                    (*members)[(*count)++] = (struct tar_member){ path, off, size, { 0 } };
+                else
+                    err = ENOMEM;
+            } else if(type == 'S') {
+                fprintf(stderr, "qrhsum: skipping sparse member\n");
+            }
+
+            /* pax and long-name records only apply to the member right after them */
+            free(long_path);
+            long_path = NULL;
+            has_size  = 0;
+        }
+
+        /* the last member's padding may be cut off */
+        padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        off   += padded < len - off ? (size_t)padded : len - off;
+    }
+
+    free(long_path);
+
+    /* without an end-of-archive block, the data must stop at a header boundary */
+    if(!err && !ended && off < len)
+        err = EINVAL;
+
+    if(err) {
+        errno = err;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* index 0 is the whole archive, the longest task, so it starts first */
+static void tar_hash_task(void *arg, size_t index) {
+    struct tar_job *job = arg;
+
+    if(index == 0) {
+        if(qrh_256_control(job->data, job->len, job->archive, job->control) < 0)
+            job->failed = errno;
+    } else if(!qrh_cancelled(job->control)) {
+        struct tar_member *m = &job->members[index - 1];
+
+        qrh_256(job->data + m->offset, (size_t)m->size, m->digest);
+    }
+}
+
+int qrhsum_tar(const char *path, const char *manifest_out, const qrh_control *control) {
+    struct qrhsum_input in;
+    struct tar_job job;
+    int status = 0;
+
+    memset(&job, 0, sizeof(job));
+
+    if(qrhsum_open_input(path, &in) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    job.data    = in.data;
+    job.len     = in.len;
+    job.control = control;
+
+    if(tar_scan(in.data, in.len, &job.members, &job.count) < 0) {
+        fprintf(stderr, "qrhsum: %s: %s\n", path, errno == EINVAL ? "malformed tar header" : strerror(errno));
+        status = 1;
+    } else {
+        qrh_pool_parallel(NULL, job.count + 1, tar_hash_task, &job);
+
+        if(job.failed == ECANCELED) {
+            fprintf(stderr, "qrhsum: %s: interrupted\n", path);
+            status = 130;
+        } else if(job.failed) {
+            fprintf(stderr, "qrhsum: %s: %s\n", path, strerror(job.failed));
+            status = 1;
+        }
+    }
+
+    if(status == 0 && manifest_out) {
+        struct qrh_manifest_builder builder;
+
+        qrh_manifest_builder_init(&builder);
+
+        /* the data offset doubles as the ordering hint, members are read in archive order */
+        for(size_t i = 0; i < job.count && status == 0; i++)
+            if(qrh_manifest_builder_add(&builder, job.members[i].path, job.members[i].digest,
+                                        job.members[i].size, job.members[i].offset) < 0)
+                status = 2;
+
+        if(status == 0 && qrh_manifest_builder_write(&builder, manifest_out) < 0)
+            status = 2;
+
+        if(status && errno == EEXIST && builder.duplicate)
+            fprintf(stderr, "qrhsum: %s: member %s appears more than once\n", manifest_out, builder.duplicate);
+        else if(status)
+            fprintf(stderr, "qrhsum: %s: %s\n", manifest_out, strerror(errno));
+
+        qrh_manifest_builder_free(&builder);
+    } else if(status == 0) {
+        for(size_t i = 0; i < job.count; i++) {
+            char hex[QRHSUM_HEX_SIZE];
+
+            qrh_digest_to_hex(job.members[i].digest, hex);
+            printf("%s  %s\n", hex, job.members[i].path);
+        }
+    }
+
+    if(status == 0) {
+        char hex[QRHSUM_HEX_SIZE];
+
+        qrh_digest_to_hex(job.archive, hex);
+        printf("%s  %s\n", hex, path);
+    }
+
+    for(size_t i = 0; i < job.count; i++)
+        free(job.members[i].path);
+
+    free(job.members);
+    qrhsum_close_input(&in);
+
+    return status;
+}
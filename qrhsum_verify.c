@@ -0,0 +1,439 @@
+/**
+ * qrhsum_verify.c
+ *
+ * Features:
+ *   - Parallel verifier behind `qrhsum --check`
+ *   - Files are read in physical disk order (FIEMAP), falling back to inode order
+ *   - The calling thread issues large sequential reads, qrh_pool tasks hash
+ *     them; chunks of one file are hashed in order by one task at a time
+ *   - Failures are printed the moment a file completes
+ *   - Progress over the whole set, cancellation between chunks
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#include "qrh_256.h"
+#include "qrh_pool.h"
+#include "qrhsum.h"
+
+#define VERIFY_CHUNK_SIZE   (4u << 20) /* large reads keep spinning disks streaming */
+#define VERIFY_BUFFERS_MIN  8
+#define VERIFY_MAX_THREADS  256
+
+struct verify_state;
+
+struct verify_job {
+    const struct qrhsum_verify_item *item;
+    struct verify_state *st;
+    uint64_t dev;
+    uint64_t physical; /* first extent, 0 when FIEMAP is unsupported */
+    uint64_t ino;
+    uint64_t size;
+    int error;
+    qrh_ctx ctx;
+
+    struct verify_chunk *head; /* read, not yet hashed; under st->lock */
+    struct verify_chunk *tail;
+    int scheduled;             /* a task is draining this job */
+};
+
+struct verify_chunk {
+    struct verify_job *job;
+    uint8_t *data;
+    size_t len;
+    int last;
+    struct verify_chunk *next;
+};
+
+struct verify_state {
+    const qrh_control *control;
+    uint64_t total;        /* bytes in the set */
+
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    unsigned running; /* draining tasks */
+
+    pthread_mutex_t pool_lock;
+    pthread_cond_t pool_ready;
+    struct verify_chunk *free_chunks;
+
+    pthread_mutex_t report_lock;
+    size_t failed;
+    uint64_t hashed;       /* progress, under report_lock */
+    uint64_t report_at;
+    uint64_t report_bytes;
+    uint64_t report_ns;
+};
+
+/* physical placement */
+static uint64_t verify_first_extent(int fd) {
+    union {
+        struct fiemap map;
+        uint8_t raw[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.map.fm_start        = 0;
+    req.map.fm_length       = FIEMAP_MAX_OFFSET;
+    req.map.fm_flags        = FIEMAP_FLAG_SYNC;
+    req.map.fm_extent_count = 1;
+
+    if(ioctl(fd, FS_IOC_FIEMAP, &req.map) < 0 || req.map.fm_mapped_extents == 0)
+        return 0;
+
+    return req.map.fm_extents[0].fe_physical;
+}
+
+static void verify_locate(struct verify_job *job) {
+    struct stat st;
+    int fd = open(job->item->path, O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0) {
+        job->error = errno;
+        return;
+    }
+
+    if(fstat(fd, &st) == 0) {
+        job->dev  = (uint64_t)st.st_dev;
+        job->ino  = (uint64_t)st.st_ino;
+        job->size = (uint64_t)st.st_size;
+
+        if(S_ISREG(st.st_mode) && st.st_size > 0)
+            job->physical = verify_first_extent(fd);
+    } else {
+        job->error = errno;
+    }
+
+    close(fd);
+}
+
+static int verify_compare_jobs(const void *pa, const void *pb) {
+    const struct verify_job *a = *(struct verify_job *const *)pa;
+    const struct verify_job *b = *(struct verify_job *const *)pb;
+
+    if(a->dev != b->dev)
+        return (a->dev > b->dev) - (a->dev < b->dev);
+
+    if(a->physical != b->physical)
+        return (a->physical > b->physical) - (a->physical < b->physical);
+
+    return (a->ino > b->ino) - (a->ino < b->ino);
+}
+
+static void verify_locate_task(void *arg, size_t index) {
+    verify_locate((struct verify_job *)arg + index);
+}
+
+/* buffer pool, bounds the memory between reader and workers */
+static struct verify_chunk *verify_get_chunk(struct verify_state *st) {
+    pthread_mutex_lock(&st->pool_lock);
+
+    while(!st->free_chunks)
+        pthread_cond_wait(&st->pool_ready, &st->pool_lock);
+
+    struct verify_chunk *chunk = st->free_chunks;
+    st->free_chunks = chunk->next;
+
+    pthread_mutex_unlock(&st->pool_lock);
+
+    chunk->next = NULL;
+    return chunk;
+}
+
+static void verify_put_chunk(struct verify_state *st, struct verify_chunk *chunk) {
+    pthread_mutex_lock(&st->pool_lock);
+
+    chunk->next     = st->free_chunks;
+    st->free_chunks = chunk;
+
+    pthread_cond_signal(&st->pool_ready);
+    pthread_mutex_unlock(&st->pool_lock);
+}
+
+
+static void verify_report(struct verify_state *st, struct verify_job *job) {
+    uint8_t digest[QRHSUM_DIGEST_SIZE];
+    const char *verdict = "OK";
+
+    /* a cancelled set gets no verdicts for the files it did not finish */
+    if(job->error == ECANCELED)
+        return;
+
+    if(job->error || qrh_final(&job->ctx, digest) < 0) {
+        verdict = "FAILED open or read";
+    } else if(memcmp(digest, job->item->digest, sizeof(digest)) != 0) {
+        verdict = "FAILED";
+    }
+
+    pthread_mutex_lock(&st->report_lock);
+
+    if(verdict[0] == 'F')
+        st->failed++;
+
+    printf("%s: %s\n", job->item->path, verdict);
+    fflush(stdout);
+
+    pthread_mutex_unlock(&st->report_lock);
+}
+
+static void verify_progress(struct verify_state *st, size_t len) {
+    const qrh_control *control = st->control;
+    uint64_t every = control->progress_bytes ? control->progress_bytes : 16u << 20;
+
+    pthread_mutex_lock(&st->report_lock);
+
+    st->hashed += len;
+
+    if(st->hashed >= st->report_at) {
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+
+        uint64_t now   = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+        double seconds = (double)(now - st->report_ns) / 1e9;
+
+        control->progress(control->user, st->hashed, st->total,
+                          seconds > 0 ? (double)(st->hashed - st->report_bytes) / seconds / 1e6 : 0.0);
+
+        st->report_at    = st->hashed + every;
+        st->report_bytes = st->hashed;
+        st->report_ns    = now;
+    }
+
+    pthread_mutex_unlock(&st->report_lock);
+}
+
+/* pool task: hashes the job's chunks in order until none are waiting */
+static void verify_drain(void *arg) {
+    struct verify_job *job  = arg;
+    struct verify_state *st = job->st;
+
+    for(;;) {
+        pthread_mutex_lock(&st->lock);
+
+        struct verify_chunk *chunk = job->head;
+
+        if(!chunk) {
+            job->scheduled = 0;
+
+            if(--st->running == 0)
+                pthread_cond_signal(&st->idle);
+
+            pthread_mutex_unlock(&st->lock);
+            return;
+        }
+
+        job->head = chunk->next;
+
+        if(!job->head)
+            job->tail = NULL;
+
+        pthread_mutex_unlock(&st->lock);
+
+        if(!job->error && qrh_cancelled(st->control))
+            job->error = ECANCELED;
+
+        if(!job->error && chunk->len && qrh_update(&job->ctx, chunk->data, chunk->len) < 0)
+            job->error = EIO;
+
+        if(!job->error && st->control && st->control->progress)
+            verify_progress(st, chunk->len);
+
+        if(chunk->last)
+            verify_report(st, job);
+
+        verify_put_chunk(st, chunk);
+    }
+}
+
+static void verify_push(struct verify_state *st, struct verify_job *job, struct verify_chunk *chunk) {
+    int start;
+
+    pthread_mutex_lock(&st->lock);
+
+    if(job->tail)
+        job->tail->next = chunk;
+    else
+        job->head = chunk;
+
+    job->tail = chunk;
+    start     = !job->scheduled;
+
+    if(start) {
+        job->scheduled = 1;
+        st->running++;
+    }
+
+    pthread_mutex_unlock(&st->lock);
+
+    if(start && qrh_pool_submit(NULL, verify_drain, job) < 0)
+        verify_drain(job);
+}
+
+/* runs on the calling thread: reads each file front to back and queues its chunks */
+static void verify_read_job(struct verify_state *st, struct verify_job *job) {
+    int fd = job->error ? -1 : open(job->item->path, O_RDONLY | O_CLOEXEC);
+    uint64_t remaining = job->size;
+
+    if(fd < 0 && !job->error)
+        job->error = errno;
+
+    if(!job->error) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        qrh_init(&job->ctx, (size_t)job->size);
+    }
+
+    do {
+        struct verify_chunk *chunk = verify_get_chunk(st);
+
+        if(!job->error && qrh_cancelled(st->control))
+            job->error = ECANCELED;
+
+        size_t want = remaining < VERIFY_CHUNK_SIZE ? (size_t)remaining : VERIFY_CHUNK_SIZE;
+
+        chunk->job = job;
+        chunk->len = 0;
+
+        while(!job->error && chunk->len < want) {
+            ssize_t n = read(fd, chunk->data + chunk->len, want - chunk->len);
+
+            if(n < 0 && errno == EINTR)
+                continue;
+
+            if(n <= 0) {
+                job->error = n < 0 ? errno : EIO; /* file shrank since it was located */
+                break;
+            }
+
+            chunk->len += (size_t)n;
+        }
+
+        remaining  -= chunk->len;
+        chunk->last = job->error || remaining == 0;
+
+        verify_push(st, job, chunk);
+
+        if(chunk->last)
+            break;
+    } while(1);
+
+    if(fd >= 0)
+        close(fd);
+}
+
+int qrhsum_verify(const struct qrhsum_verify_item *items, size_t count, unsigned nthreads,
+                  const qrh_control *control, size_t *failed) {
+    struct verify_job *jobs   = calloc(count ? count : 1, sizeof(*jobs));
+    struct verify_job **order = malloc((count ? count : 1) * sizeof(*order));
+    struct verify_state st    = {0};
+
+    if(nthreads == 0)
+        nthreads = 1;
+
+    if(nthreads > VERIFY_MAX_THREADS)
+        nthreads = VERIFY_MAX_THREADS;
+
+    if(!jobs || !order) {
+        free(jobs);
+        free(order);
+        return -1;
+    }
+
+    st.control = control;
+
+    for(size_t i = 0; i < count; i++) {
+        jobs[i].item = &items[i];
+        jobs[i].st   = &st;
+        order[i]     = &jobs[i];
+    }
+
+    /* open/fstat/FIEMAP per file is latency bound, so spread it over the pool too */
+    qrh_pool_parallel(NULL, count, verify_locate_task, jobs);
+    qsort(order, count, sizeof(*order), verify_compare_jobs);
+
+    if(control && control->progress) {
+        struct timespec ts;
+
+        for(size_t i = 0; i < count; i++)
+            st.total += jobs[i].size;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        st.report_ns = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+        st.report_at = control->progress_bytes ? control->progress_bytes : 16u << 20;
+    }
+
+    /* the buffers bound how many chunks, and so how many hashing tasks, are in flight */
+    unsigned nbuffers = nthreads * 2 > VERIFY_BUFFERS_MIN ? nthreads * 2 : VERIFY_BUFFERS_MIN;
+    struct verify_chunk *chunks = calloc(nbuffers, sizeof(*chunks));
+    int ret = -1;
+
+    pthread_mutex_init(&st.lock, NULL);
+    pthread_cond_init(&st.idle, NULL);
+    pthread_mutex_init(&st.pool_lock, NULL);
+    pthread_cond_init(&st.pool_ready, NULL);
+    pthread_mutex_init(&st.report_lock, NULL);
+
+    if(!chunks)
+        goto out;
+
+    for(unsigned i = 0; i < nbuffers; i++) {
+        chunks[i].data = malloc(VERIFY_CHUNK_SIZE);
+
+        if(!chunks[i].data)
+            goto out;
+
+        chunks[i].next = st.free_chunks;
+        st.free_chunks = &chunks[i];
+    }
+
+    for(size_t i = 0; i < count && !qrh_cancelled(control); i++)
+        verify_read_job(&st, order[i]);
+
+    ret = 0;
+
+out:
+    pthread_mutex_lock(&st.lock);
+
+    while(st.running)
+        pthread_cond_wait(&st.idle, &st.lock);
+
+    pthread_mutex_unlock(&st.lock);
+
+    if(chunks) {
+        for(unsigned i = 0; i < nbuffers; i++)
+            free(chunks[i].data);
+    }
+
+    if(failed)
+        *failed = st.failed;
+
+    if(ret == 0 && qrh_cancelled(control)) {
+        errno = ECANCELED;
+        ret   = -1;
+    }
+
+    pthread_mutex_destroy(&st.lock);
+    pthread_cond_destroy(&st.idle);
+    pthread_mutex_destroy(&st.pool_lock);
+    pthread_cond_destroy(&st.pool_ready);
+    pthread_mutex_destroy(&st.report_lock);
+
+    free(chunks);
+    free(jobs);
+    free(order);
+
+    return ret;
+}
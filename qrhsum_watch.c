@@ -0,0 +1,942 @@
+/**
+ * qrhsum_watch.c
+ *
+ * Features:
+ *   - `qrhsum --watch` daemon keeping digests of a directory tree current
+ *   - inotify watches on every directory, bursts of writes are debounced
+ *   - Only files touched since the last pass are rehashed, on the default
+ *     qrh_pool so a large file never stalls events or queries
+ *   - Files are read with read() into a qrh_ctx rather than mmap'd: a file
+ *     truncated mid-hash is retried instead of raising SIGBUS
+ *   - Manifest served over a unix socket (GET <path> / LIST / STATS); client
+ *     sockets are non-blocking and replies are queued, so a client that stops
+ *     reading never stalls the event loop
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "qrh_pool.h"
+#include "qrhsum.h"
+
+#define WATCH_MASK         (IN_CREATE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                            IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR)
+#define WATCH_MAX_CLIENTS  64
+#define WATCH_LINE_MAX     4096
+#define WATCH_EVENT_BUFFER (64 * 1024)
+#define WATCH_MIN_BUCKETS  1024
+#define WATCH_READ_BUFFER  (64 * 1024)
+#define WATCH_OUTPUT_KEEP  (256 * 1024) /* larger reply buffers are freed once sent */
+
+struct watch_entry {
+    char *path; /* relative to the watched root */
+    uint8_t digest[QRHSUM_DIGEST_SIZE];
+    int have_digest;
+    int error;                      /* errno of the last failed rehash */
+    int dirty;
+    uint64_t deadline_ms;
+    uint64_t generation;            /* bumped by every touch */
+    uint64_t hashing;               /* generation of the rehash in flight, 0 if none */
+
+    struct watch_entry *next;       /* hash chain */
+    struct watch_entry *dirty_prev; /* pending rehash list */
+    struct watch_entry *dirty_next;
+};
+
+/* one rehash on the pool; owns copies of the paths, so the entry may go meanwhile */
+struct watch_job {
+    char *path;
+    char *full;
+    uint64_t generation;
+    uint8_t digest[QRHSUM_DIGEST_SIZE];
+    int error;
+    int *wake_fd;
+    pthread_mutex_t *lock;
+    struct watch_job **done;
+    struct watch_job *next;
+};
+
+struct watch_client {
+    int fd;
+    int failed;         /* a reply could not be queued */
+    size_t len;
+    char line[WATCH_LINE_MAX];
+    char *out;          /* queued reply, sent as the socket accepts it */
+    size_t out_len;
+    size_t out_sent;
+    size_t out_size;
+};
+
+struct watch_state {
+    const char *root;
+    unsigned debounce_ms;
+    int inotify_fd;
+    int listen_fd;
+    int wake_fd;                    /* eventfd signalled by finished rehashes */
+
+    struct watch_entry **buckets;
+    size_t nbuckets;
+    size_t count;
+    size_t ndirty;
+    size_t npending;                /* dirty or hashing: digest not current */
+    struct watch_entry *dirty_head;
+
+    uint64_t generation;
+    size_t inflight;
+
+    pthread_mutex_t lock;           /* guards done */
+    struct watch_job *done;
+
+    char **wd_paths; /* indexed by watch descriptor */
+    size_t nwds;
+
+    struct watch_client clients[WATCH_MAX_CLIENTS];
+    size_t nclients;
+};
+
+static volatile sig_atomic_t watch_stop = 0;
+
+static void watch_on_signal(int sig) {
+    (void)sig;
+    __atomic_store_n(&watch_stop, 1, __ATOMIC_RELAXED);
+}
+
+static uint64_t watch_now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static char *watch_join(const char *dir, const char *name) {
+    size_t dir_len  = strlen(dir);
+    size_t name_len = strlen(name);
+    char *path      = malloc(dir_len + name_len + 2);
+
+    if(!path)
+        return NULL;
+
+    if(dir_len == 0) {
+        memcpy(path, name, name_len + 1);
+    } else {
+        memcpy(path, dir, dir_len);
+        path[dir_len] = '/';
+        memcpy(path + dir_len + 1, name, name_len + 1);
+    }
+
+    return path;
+}
+
+static int watch_has_prefix(const char *path, const char *dir) {
+    size_t dir_len = strlen(dir);
+
+    return strncmp(path, dir, dir_len) == 0 && (path[dir_len] == '/' || path[dir_len] == '\0');
+}
+
+/* FNV-1a, only used to bucket paths */
+static size_t watch_path_hash(const char *path) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for(; *path; path++) {
+        h ^= (uint8_t)*path;
+        h *= 0x100000001b3ULL;
+    }
+
+    return (size_t)h;
+}
+
+/* manifest table */
+static struct watch_entry **watch_slot(struct watch_state *st, const char *path) {
+    struct watch_entry **slot = &st->buckets[watch_path_hash(path) & (st->nbuckets - 1)];
+
+    while(*slot && strcmp((*slot)->path, path) != 0)
+        slot = &(*slot)->next;
+
+    return slot;
+}
+
+static int watch_grow(struct watch_state *st) {
+    size_t nbuckets = st->nbuckets * 2;
+    struct watch_entry **buckets = calloc(nbuckets, sizeof(*buckets));
+
+    if(!buckets)
+        return -1;
+
+    for(size_t i = 0; i < st->nbuckets; i++) {
+        struct watch_entry *e = st->buckets[i];
+
+        while(e) {
+            struct watch_entry *next = e->next;
+            size_t b = watch_path_hash(e->path) & (nbuckets - 1);
+
+            e->next    = buckets[b];
+            buckets[b] = e;
+            e          = next;
+        }
+    }
+
+    free(st->buckets);
+    st->buckets  = buckets;
+    st->nbuckets = nbuckets;
+
+    return 0;
+}
+
+static void watch_clear_dirty(struct watch_state *st, struct watch_entry *e) {
+    if(!e->dirty)
+        return;
+
+    if(e->dirty_prev)
+        e->dirty_prev->dirty_next = e->dirty_next;
+    else
+        st->dirty_head = e->dirty_next;
+
+    if(e->dirty_next)
+        e->dirty_next->dirty_prev = e->dirty_prev;
+
+    e->dirty      = 0;
+    e->dirty_prev = NULL;
+    e->dirty_next = NULL;
+    st->ndirty--;
+}
+
+/* (re)arm the debounce timer of a file, creating its entry if needed */
+static void watch_touch(struct watch_state *st, const char *path, uint64_t deadline_ms) {
+    struct watch_entry **slot = watch_slot(st, path);
+    struct watch_entry *e     = *slot;
+
+    if(!e) {
+        if(st->count >= st->nbuckets && watch_grow(st) == 0)
+            slot = watch_slot(st, path);
+
+        e = calloc(1, sizeof(*e));
+
+        if(!e || !(e->path = strdup(path))) {
+            free(e);
+            return;
+        }
+
+        *slot = e;
+        st->count++;
+    }
+
+    e->deadline_ms = deadline_ms;
+    e->generation  = ++st->generation;
+
+    if(!e->dirty && !e->hashing)
+        st->npending++;
+
+    if(!e->dirty) {
+        e->dirty      = 1;
+        e->dirty_next = st->dirty_head;
+
+        if(st->dirty_head)
+            st->dirty_head->dirty_prev = e;
+
+        st->dirty_head = e;
+        st->ndirty++;
+    }
+}
+
+static void watch_forget(struct watch_state *st, const char *path) {
+    struct watch_entry **slot = watch_slot(st, path);
+    struct watch_entry *e     = *slot;
+
+    if(!e)
+        return;
+
+    st->npending -= e->dirty || e->hashing;
+    watch_clear_dirty(st, e);
+    *slot = e->next;
+    st->count--;
+
+    free(e->path);
+    free(e);
+}
+
+static void watch_forget_tree(struct watch_state *st, const char *dir) {
+    for(size_t i = 0; i < st->nbuckets; i++) {
+        struct watch_entry **slot = &st->buckets[i];
+
+        while(*slot) {
+            struct watch_entry *e = *slot;
+
+            if(!watch_has_prefix(e->path, dir)) {
+                slot = &e->next;
+                continue;
+            }
+
+            st->npending -= e->dirty || e->hashing;
+            watch_clear_dirty(st, e);
+            *slot = e->next;
+            st->count--;
+
+            free(e->path);
+            free(e);
+        }
+    }
+
+    for(size_t wd = 0; wd < st->nwds; wd++) {
+        if(st->wd_paths[wd] && watch_has_prefix(st->wd_paths[wd], dir)) {
+            inotify_rm_watch(st->inotify_fd, (int)wd);
+            free(st->wd_paths[wd]);
+            st->wd_paths[wd] = NULL;
+        }
+    }
+}
+
+/* directory watches */
+static int watch_remember_wd(struct watch_state *st, int wd, const char *rel) {
+    if((size_t)wd >= st->nwds) {
+        size_t nwds  = st->nwds ? st->nwds : 64;
+
+        while(nwds <= (size_t)wd)
+            nwds *= 2;
+
+        char **grown = realloc(st->wd_paths, nwds * sizeof(*grown));
+
+        if(!grown)
+            return -1;
+
+        memset(grown + st->nwds, 0, (nwds - st->nwds) * sizeof(*grown));
+        st->wd_paths = grown;
+        st->nwds     = nwds;
+    }
+
+    free(st->wd_paths[wd]);
+    st->wd_paths[wd] = strdup(rel);
+
+    return st->wd_paths[wd] ? 0 : -1;
+}
+
+/* watch `rel` and everything below it; files found are queued with `deadline_ms` */
+static void watch_add_tree(struct watch_state *st, const char *rel, uint64_t deadline_ms) {
+    char *full = rel[0] ? watch_join(st->root, rel) : strdup(st->root);
+
+    if(!full)
+        return;
+
+    int wd = inotify_add_watch(st->inotify_fd, full, WATCH_MASK);
+
+    if(wd < 0 || watch_remember_wd(st, wd, rel) < 0) {
+        fprintf(stderr, "qrhsum: watch %s: %s\n", full, strerror(errno));
+        free(full);
+        return;
+    }
+
+    DIR *dir = opendir(full);
+
+    if(!dir) {
+        free(full);
+        return;
+    }
+
+    struct dirent *de;
+
+    while((de = readdir(dir)) != NULL) {
+        if(strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+
+        char *child = watch_join(rel, de->d_name);
+        char *child_full = watch_join(full, de->d_name);
+        struct stat sb;
+
+        if(child && child_full && lstat(child_full, &sb) == 0) {
+            if(S_ISDIR(sb.st_mode))
+                watch_add_tree(st, child, deadline_ms);
+            else if(S_ISREG(sb.st_mode))
+                watch_touch(st, child, deadline_ms);
+        }
+
+        free(child);
+        free(child_full);
+    }
+
+    closedir(dir);
+    free(full);
+}
+
+static void watch_handle_event(struct watch_state *st, const struct inotify_event *ev) {
+    uint64_t now = watch_now_ms();
+
+    if(ev->mask & IN_Q_OVERFLOW) {
+        /* events were lost, fall back to a full rescan of the tree */
+        watch_add_tree(st, "", now);
+        return;
+    }
+
+    if(ev->wd < 0 || (size_t)ev->wd >= st->nwds || !st->wd_paths[ev->wd])
+        return;
+
+    if(ev->mask & IN_IGNORED) {
+        free(st->wd_paths[ev->wd]);
+        st->wd_paths[ev->wd] = NULL;
+        return;
+    }
+
+    if(ev->len == 0)
+        return;
+
+    char *rel = watch_join(st->wd_paths[ev->wd], ev->name);
+
+    if(!rel)
+        return;
+
+    if(ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if(ev->mask & IN_ISDIR)
+            watch_forget_tree(st, rel);
+        else
+            watch_forget(st, rel);
+    } else if(ev->mask & IN_ISDIR) {
+        if(ev->mask & (IN_CREATE | IN_MOVED_TO))
+            watch_add_tree(st, rel, now + st->debounce_ms);
+    } else {
+        watch_touch(st, rel, now + st->debounce_ms);
+    }
+
+    free(rel);
+}
+
+static void watch_drain_events(struct watch_state *st) {
+    char buffer[WATCH_EVENT_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for(;;) {
+        ssize_t n = read(st->inotify_fd, buffer, sizeof(buffer));
+
+        if(n <= 0)
+            return;
+
+        for(char *p = buffer; p < buffer + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+
+            watch_handle_event(st, ev);
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+}
+
+/*
+ * QRH-256 of a regular file through read(). The size is fixed up front, so
+ * a file that shrinks, grows or is rewritten while it is read fails with
+ * EAGAIN and is queued again. ECANCELED once the daemon is stopping.
+ */
+static int watch_hash_file(const char *path, uint8_t out[QRHSUM_DIGEST_SIZE]) {
+    uint8_t buf[WATCH_READ_BUFFER];
+    struct stat before, after;
+    qrh_ctx ctx;
+    size_t left;
+    int fd, err = 0;
+
+    if((fd = open(path, O_RDONLY | O_CLOEXEC | O_NOFOLLOW)) < 0)
+        return -1;
+
+    if(fstat(fd, &before) < 0 || !S_ISREG(before.st_mode)) {
+        err = errno ? errno : EINVAL;
+        goto out;
+    }
+
+    qrh_init(&ctx, (size_t)before.st_size);
+
+    for(left = (size_t)before.st_size; left && !err; ) {
+        ssize_t n = read(fd, buf, left < sizeof(buf) ? left : sizeof(buf));
+
+        if(__atomic_load_n(&watch_stop, __ATOMIC_RELAXED))
+            err = ECANCELED;
+        else if(n < 0 && errno != EINTR)
+            err = errno;
+        else if(n == 0)
+            err = EAGAIN;
+        else if(n > 0) {
+            qrh_update(&ctx, buf, (size_t)n);
+            left -= (size_t)n;
+        }
+    }
+
+    if(!err && (fstat(fd, &after) < 0 || after.st_size != before.st_size ||
+                after.st_mtim.tv_sec != before.st_mtim.tv_sec || after.st_mtim.tv_nsec != before.st_mtim.tv_nsec))
+        err = EAGAIN;
+
+    if(!err && qrh_final(&ctx, out) < 0)
+        err = errno;
+
+out:
+    close(fd);
+
+    if(err) {
+        errno = err;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void watch_hash_task(void *arg) {
+    struct watch_job *job = arg;
+    uint64_t one = 1;
+
+    job->error = watch_hash_file(job->full, job->digest) < 0 ? errno : 0;
+
+    pthread_mutex_lock(job->lock);
+    job->next  = *job->done;
+    *job->done = job;
+    pthread_mutex_unlock(job->lock);
+
+    if(write(*job->wake_fd, &one, sizeof(one)) < 0) {
+        /* the counter is only a wakeup, a saturated one still wakes the loop */
+    }
+}
+
+static void watch_free_job(struct watch_job *job) {
+    free(job->path);
+    free(job->full);
+    free(job);
+}
+
+/* hands one due file to the pool; 0 when it is off the dirty list */
+static int watch_submit(struct watch_state *st, struct watch_entry *e) {
+    struct watch_job *job = calloc(1, sizeof(*job));
+
+    if(!job || !(job->path = strdup(e->path)) || !(job->full = watch_join(st->root, e->path))) {
+        if(job)
+            watch_free_job(job);
+
+        return -1;
+    }
+
+    job->generation = e->generation;
+    job->wake_fd    = &st->wake_fd;
+    job->lock       = &st->lock;
+    job->done       = &st->done;
+
+    if(qrh_pool_submit(NULL, watch_hash_task, job) < 0) {
+        watch_free_job(job);
+        return -1;
+    }
+
+    e->hashing = e->generation;
+    st->inflight++;
+    watch_clear_dirty(st, e);
+
+    return 0;
+}
+
+/* applies finished rehashes whose file was not touched again meanwhile */
+static void watch_collect(struct watch_state *st) {
+    struct watch_job *job;
+    uint64_t count;
+
+    if(read(st->wake_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        return;
+
+    pthread_mutex_lock(&st->lock);
+    job = st->done;
+    st->done = NULL;
+    pthread_mutex_unlock(&st->lock);
+
+    while(job) {
+        struct watch_job *next = job->next;
+        struct watch_entry *e  = *watch_slot(st, job->path);
+
+        st->inflight--;
+
+        if(e && e->hashing == job->generation) {
+            e->hashing     = 0;
+            st->npending -= !e->dirty;
+        }
+
+        if(e && e->generation == job->generation) {
+            e->have_digest = job->error == 0;
+            e->error       = job->error;
+
+            if(job->error == 0) {
+                memcpy(e->digest, job->digest, sizeof(e->digest));
+            } else if(job->error == EAGAIN) {
+                /* changed while it was read: try again once it is quiet */
+                e->error = 0;
+                watch_touch(st, job->path, watch_now_ms() + st->debounce_ms);
+            } else if(job->error == ENOENT) {
+                watch_forget(st, job->path);
+            } else if(job->error != ECANCELED) {
+                fprintf(stderr, "qrhsum: %s: %s\n", job->full, strerror(job->error));
+            }
+        }
+
+        watch_free_job(job);
+        job = next;
+    }
+}
+
+/* queues every dirty file whose quiet period is over, returns ms until the next one */
+static int watch_rehash_due(struct watch_state *st) {
+    uint64_t now  = watch_now_ms();
+    uint64_t next = UINT64_MAX;
+    struct watch_entry *e = st->dirty_head;
+
+    while(e) {
+        struct watch_entry *following = e->dirty_next;
+
+        /* a file still being hashed is queued again when that rehash reports back */
+        if(e->hashing) {
+            e = following;
+            continue;
+        }
+
+        if(e->deadline_ms <= now && watch_submit(st, e) < 0)
+            e->deadline_ms = now + st->debounce_ms;
+
+        if(e->dirty && e->deadline_ms < next)
+            next = e->deadline_ms;
+
+        e = following;
+    }
+
+    if(next == UINT64_MAX)
+        return -1;
+
+    return next > now ? (int)(next - now) : 0;
+}
+
+/*
+ * Query socket. A client's next request is only answered once its previous
+ * reply has been sent, so a client holds at most one queued reply, however
+ * many requests it pipelines.
+ */
+static void watch_queue(struct watch_client *c, const char *buf, size_t len) {
+    if(c->failed)
+        return;
+
+    if(len > c->out_size - c->out_len) {
+        size_t size = c->out_size ? c->out_size : WATCH_LINE_MAX;
+
+        while(size - c->out_len < len)
+            size *= 2;
+
+        char *grown = realloc(c->out, size);
+
+        if(!grown) {
+            c->failed = 1;
+            return;
+        }
+
+        c->out      = grown;
+        c->out_size = size;
+    }
+
+    memcpy(c->out + c->out_len, buf, len);
+    c->out_len += len;
+}
+
+/* sends what the socket takes without blocking; returns 0 when the client is gone */
+static int watch_flush(struct watch_client *c) {
+    while(c->out_sent < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent, MSG_NOSIGNAL);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return 1;
+
+        if(n <= 0)
+            return 0;
+
+        c->out_sent += (size_t)n;
+    }
+
+    c->out_len  = 0;
+    c->out_sent = 0;
+
+    /* a LIST reply is as large as the manifest, do not keep that around */
+    if(c->out_size > WATCH_OUTPUT_KEEP) {
+        free(c->out);
+        c->out      = NULL;
+        c->out_size = 0;
+    }
+
+    return 1;
+}
+
+static void watch_send_entry(struct watch_client *c, const char *status, const struct watch_entry *e) {
+    char hex[QRHSUM_HEX_SIZE];
+    char line[WATCH_LINE_MAX + QRHSUM_HEX_SIZE + 16];
+
+    qrh_digest_to_hex(e->digest, hex);
+
+    int n = snprintf(line, sizeof(line), "%s%s  %s\n", status, hex, e->path);
+
+    if(n > 0)
+        watch_queue(c, line, (size_t)n < sizeof(line) ? (size_t)n : sizeof(line) - 1);
+}
+
+static void watch_answer(struct watch_state *st, struct watch_client *c, char *request) {
+    char reply[WATCH_LINE_MAX + 32];
+
+    if(strncmp(request, "GET ", 4) == 0) {
+        const char *path = request + 4;
+        struct watch_entry *e = *watch_slot(st, path);
+
+        if(e && e->have_digest && !e->dirty && !e->hashing) {
+            watch_send_entry(c, "OK ", e);
+            return;
+        }
+
+        if(e && e->error && !e->dirty && !e->hashing)
+            snprintf(reply, sizeof(reply), "FAILED %s: %s\n", path, strerror(e->error));
+        else
+            snprintf(reply, sizeof(reply), "%s %s\n", e ? "PENDING" : "MISSING", path);
+    } else if(strcmp(request, "LIST") == 0) {
+        for(size_t i = 0; i < st->nbuckets; i++) {
+            for(struct watch_entry *e = st->buckets[i]; e; e = e->next) {
+                if(e->have_digest && !e->dirty && !e->hashing)
+                    watch_send_entry(c, "", e);
+            }
+        }
+
+        snprintf(reply, sizeof(reply), ".\n");
+    } else if(strcmp(request, "STATS") == 0) {
+        snprintf(reply, sizeof(reply), "files %zu pending %zu\n", st->count, st->npending);
+    } else {
+        snprintf(reply, sizeof(reply), "ERR unknown request\n");
+    }
+
+    watch_queue(c, reply, strlen(reply));
+}
+
+static void watch_drop_client(struct watch_state *st, size_t i) {
+    close(st->clients[i].fd);
+    free(st->clients[i].out);
+    st->clients[i] = st->clients[--st->nclients];
+}
+
+/* answers buffered requests until one leaves its reply queued; 0 drops the client */
+static int watch_answer_buffered(struct watch_state *st, struct watch_client *c) {
+    char *start = c->line;
+    char *nl;
+
+    while(c->out_len == 0 && (nl = memchr(start, '\n', c->len - (size_t)(start - c->line))) != NULL) {
+        *nl = '\0';
+
+        if(nl > start && nl[-1] == '\r')
+            nl[-1] = '\0';
+
+        watch_answer(st, c, start);
+        start = nl + 1;
+
+        if(c->failed || !watch_flush(c))
+            return 0;
+    }
+
+    c->len -= (size_t)(start - c->line);
+    memmove(c->line, start, c->len);
+
+    /* a request longer than the line buffer can never complete */
+    return c->len < sizeof(c->line) || memchr(c->line, '\n', c->len) != NULL;
+}
+
+/* returns 0 when the client hung up or misbehaved */
+static int watch_serve_client(struct watch_state *st, struct watch_client *c) {
+    if(c->out_len) {
+        if(!watch_flush(c))
+            return 0;
+
+        return c->out_len || watch_answer_buffered(st, c);
+    }
+
+    ssize_t n = read(c->fd, c->line + c->len, sizeof(c->line) - c->len);
+
+    if(n <= 0)
+        return n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK);
+
+    c->len += (size_t)n;
+    return watch_answer_buffered(st, c);
+}
+
+static int watch_listen(const char *socket_path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+    if(strlen(socket_path) >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    strcpy(addr.sun_path, socket_path);
+
+    /* replace a stale socket from an earlier run, never anything else */
+    struct stat sb;
+
+    if(lstat(socket_path, &sb) == 0) {
+        if(!S_ISSOCK(sb.st_mode)) {
+            errno = EEXIST;
+            return -1;
+        }
+
+        if(unlink(socket_path) < 0)
+            return -1;
+    } else if(errno != ENOENT) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if(fd < 0)
+        return -1;
+
+    if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 16) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void watch_free(struct watch_state *st) {
+    for(size_t i = 0; i < st->nbuckets; i++) {
+        struct watch_entry *e = st->buckets[i];
+
+        while(e) {
+            struct watch_entry *next = e->next;
+
+            free(e->path);
+            free(e);
+            e = next;
+        }
+    }
+
+    for(size_t i = 0; i < st->nwds; i++)
+        free(st->wd_paths[i]);
+
+    for(size_t i = 0; i < st->nclients; i++) {
+        close(st->clients[i].fd);
+        free(st->clients[i].out);
+    }
+
+    free(st->buckets);
+    free(st->wd_paths);
+}
+
+int qrhsum_watch(const char *root, const char *socket_path, unsigned debounce_ms) {
+    struct watch_state st = {
+        .root        = root,
+        .debounce_ms = debounce_ms,
+        .nbuckets    = WATCH_MIN_BUCKETS,
+    };
+
+    struct sigaction sa = { .sa_handler = watch_on_signal };
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    pthread_mutex_init(&st.lock, NULL);
+
+    st.buckets    = calloc(st.nbuckets, sizeof(*st.buckets));
+    st.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    st.wake_fd    = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    st.listen_fd  = watch_listen(socket_path);
+
+    if(!st.buckets || st.inotify_fd < 0 || st.wake_fd < 0 || st.listen_fd < 0) {
+        if(st.listen_fd < 0)
+            fprintf(stderr, "qrhsum: --socket %s: %s\n", socket_path, strerror(errno));
+        else
+            fprintf(stderr, "qrhsum: --watch %s: %s\n", root, strerror(errno));
+
+        if(st.inotify_fd >= 0)
+            close(st.inotify_fd);
+
+        if(st.wake_fd >= 0)
+            close(st.wake_fd);
+
+        if(st.listen_fd >= 0)
+            close(st.listen_fd);
+
+        free(st.buckets);
+        pthread_mutex_destroy(&st.lock);
+        return -1;
+    }
+
+    /* initial scan is due immediately, later changes wait for the debounce window */
+    watch_add_tree(&st, "", watch_now_ms());
+
+    while(!__atomic_load_n(&watch_stop, __ATOMIC_RELAXED)) {
+        struct pollfd fds[3 + WATCH_MAX_CLIENTS];
+        int timeout = watch_rehash_due(&st);
+
+        fds[0].fd     = st.inotify_fd;
+        fds[0].events = POLLIN;
+        fds[1].fd     = st.listen_fd;
+        fds[1].events = POLLIN;
+        fds[2].fd     = st.wake_fd;
+        fds[2].events = POLLIN;
+
+        for(size_t i = 0; i < st.nclients; i++) {
+            /* a client with a reply queued is not read until it takes the reply */
+            fds[3 + i].fd     = st.clients[i].fd;
+            fds[3 + i].events = st.clients[i].out_len ? POLLOUT : POLLIN;
+        }
+
+        size_t nclients = st.nclients;
+
+        if(poll(fds, 3 + nclients, timeout) < 0) {
+            if(errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        if(fds[0].revents & POLLIN)
+            watch_drain_events(&st);
+
+        if(fds[2].revents & POLLIN)
+            watch_collect(&st);
+
+        /* walk backwards so dropping a client does not skip its replacement */
+        for(size_t i = nclients; i-- > 0;) {
+            if(fds[3 + i].revents && !watch_serve_client(&st, &st.clients[i]))
+                watch_drop_client(&st, i);
+        }
+
+        if(fds[1].revents & POLLIN) {
+            int fd = accept4(st.listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+            if(fd >= 0 && st.nclients < WATCH_MAX_CLIENTS) {
+                memset(&st.clients[st.nclients], 0, sizeof(st.clients[st.nclients]));
+                st.clients[st.nclients].fd = fd;
+                st.nclients++;
+            } else if(fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    /* rehashes in flight see watch_stop between reads and finish promptly */
+    while(st.inflight) {
+        struct pollfd wake = { .fd = st.wake_fd, .events = POLLIN };
+
+        if(poll(&wake, 1, -1) > 0)
+            watch_collect(&st);
+    }
+
+    close(st.listen_fd);
+    close(st.inotify_fd);
+    close(st.wake_fd);
+    unlink(socket_path);
+    watch_free(&st);
+    pthread_mutex_destroy(&st.lock);
+
+    return 0;
+}